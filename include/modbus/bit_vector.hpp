@@ -0,0 +1,279 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+namespace modbus {
+
+/// Pack an array of booleans into bytes, least significant bit first.
+/**
+ * Writes (count + 7) / 8 bytes. Unused bits of the last byte are cleared.
+ */
+void pack_bits(
+	bool const * values,  ///< The booleans to pack.
+	std::size_t count,    ///< The number of booleans to pack.
+	std::uint8_t * out    ///< The output buffer.
+);
+
+/// Unpack bytes into an array of booleans, least significant bit first.
+void unpack_bits(
+	std::uint8_t const * data, ///< The packed bits.
+	std::size_t count,         ///< The number of bits to unpack.
+	bool * out                 ///< The output array.
+);
+
+/// Packed list of bits, used for coils and discrete inputs.
+/**
+ * The bits are stored packed in bytes, least significant bit first.
+ * This is exactly the Modbus wire format, so the bits can be (de)serialized with a single copy.
+ * Unused bits in the last byte are always zero.
+ *
+ * The interface is similar to std::vector<bool>, and a bit_vector converts to and from a std::vector<bool>.
+ */
+class bit_vector {
+public:
+	/// Reference to a single bit.
+	class reference {
+	public:
+		reference(std::uint8_t & byte, std::uint8_t mask) : byte(byte), mask(mask) {}
+
+		operator bool() const { return byte & mask; }
+
+		reference & operator= (bool value) {
+			if (value) byte |= mask;
+			else byte &= ~mask;
+			return *this;
+		}
+
+		reference & operator= (reference const & other) {
+			return *this = bool(other);
+		}
+
+	private:
+		std::uint8_t & byte;
+		std::uint8_t mask;
+	};
+
+	/// Random access iterator over the bits.
+	class const_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type        = bool;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = void;
+		using reference         = bool;
+
+		const_iterator() = default;
+		const_iterator(std::uint8_t const * data, std::size_t index) : data(data), index(index) {}
+
+		bool operator* () const { return data[index / 8] >> (index % 8) & 1; }
+		bool operator[] (difference_type n) const { return *(*this + n); }
+
+		const_iterator & operator++ () { ++index; return *this; }
+		const_iterator & operator-- () { --index; return *this; }
+		const_iterator operator++ (int) { const_iterator result = *this; ++index; return result; }
+		const_iterator operator-- (int) { const_iterator result = *this; --index; return result; }
+		const_iterator & operator+= (difference_type n) { index += n; return *this; }
+		const_iterator & operator-= (difference_type n) { index -= n; return *this; }
+
+		friend const_iterator operator+ (const_iterator a, difference_type n) { return a += n; }
+		friend const_iterator operator+ (difference_type n, const_iterator a) { return a += n; }
+		friend const_iterator operator- (const_iterator a, difference_type n) { return a -= n; }
+		friend difference_type operator- (const_iterator a, const_iterator b) { return difference_type(a.index) - difference_type(b.index); }
+
+		friend bool operator== (const_iterator a, const_iterator b) { return a.index == b.index; }
+		friend bool operator!= (const_iterator a, const_iterator b) { return a.index != b.index; }
+		friend bool operator<  (const_iterator a, const_iterator b) { return a.index <  b.index; }
+		friend bool operator>  (const_iterator a, const_iterator b) { return a.index >  b.index; }
+		friend bool operator<= (const_iterator a, const_iterator b) { return a.index <= b.index; }
+		friend bool operator>= (const_iterator a, const_iterator b) { return a.index >= b.index; }
+
+	private:
+		std::uint8_t const * data = nullptr;
+		std::size_t index = 0;
+	};
+
+	using iterator = const_iterator;
+
+	/// Construct an empty bit vector.
+	bit_vector() = default;
+
+	/// Construct a bit vector with a number of bits set to the same value.
+	explicit bit_vector(std::size_t count, bool value = false) {
+		resize(count, value);
+	}
+
+	/// Construct a bit vector from a list of booleans.
+	bit_vector(std::initializer_list<bool> values) {
+		assign(values.begin(), values.size());
+	}
+
+	/// Construct a bit vector from a std::vector<bool>.
+	bit_vector(std::vector<bool> const & values) {
+		resize(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i) if (values[i]) _bytes[i / 8] |= 1 << (i % 8);
+	}
+
+	/// Construct a bit vector from an array of booleans.
+	bit_vector(bool const * values, std::size_t count) {
+		assign(values, count);
+	}
+
+	/// Convert the bit vector to a std::vector<bool>.
+	operator std::vector<bool>() const {
+		return std::vector<bool>(begin(), end());
+	}
+
+	/// Replace the contents with an array of booleans.
+	void assign(bool const * values, std::size_t count) {
+		_bytes.resize((count + 7) / 8);
+		_size = count;
+		pack_bits(values, count, _bytes.data());
+	}
+
+	/// Replace the contents with packed bits, least significant bit first.
+	/**
+	 * Unused bits of the last byte are cleared.
+	 */
+	void assign_packed(std::uint8_t const * data, std::size_t count) {
+		_bytes.assign(data, data + (count + 7) / 8);
+		_size = count;
+		clear_padding();
+	}
+
+	/// Unpack the bits into an array of booleans.
+	void unpack(bool * out) const {
+		unpack_bits(_bytes.data(), _size, out);
+	}
+
+	/// Get the number of bits.
+	std::size_t size() const {
+		return _size;
+	}
+
+	/// Check if the bit vector is empty.
+	bool empty() const {
+		return _size == 0;
+	}
+
+	/// Get the packed bits.
+	std::uint8_t const * data() const {
+		return _bytes.data();
+	}
+
+	/// Get the packed bits.
+	std::uint8_t * data() {
+		return _bytes.data();
+	}
+
+	/// Get the number of bytes used by the packed bits.
+	std::size_t byte_size() const {
+		return _bytes.size();
+	}
+
+	/// Get a bit.
+	bool operator[] (std::size_t index) const {
+		return _bytes[index / 8] >> (index % 8) & 1;
+	}
+
+	/// Get a reference to a bit.
+	reference operator[] (std::size_t index) {
+		return reference(_bytes[index / 8], 1 << (index % 8));
+	}
+
+	/// Get an iterator to the first bit.
+	const_iterator begin() const {
+		return const_iterator(_bytes.data(), 0);
+	}
+
+	/// Get an iterator past the last bit.
+	const_iterator end() const {
+		return const_iterator(_bytes.data(), _size);
+	}
+
+	/// Reserve space for a number of bits.
+	void reserve(std::size_t count) {
+		_bytes.reserve((count + 7) / 8);
+	}
+
+	/// Resize the bit vector, setting new bits to the given value.
+	void resize(std::size_t count, bool value = false) {
+		std::size_t old_size = _size;
+		_bytes.resize((count + 7) / 8, value ? 0xff : 0x00);
+
+		// Set the bits that were padding in the old last byte.
+		if (count > old_size && old_size % 8) {
+			std::uint8_t mask = std::uint8_t(0xff << (old_size % 8));
+			if (value) _bytes[old_size / 8] |= mask;
+			else _bytes[old_size / 8] &= ~mask;
+		}
+
+		_size = count;
+		clear_padding();
+	}
+
+	/// Append a bit.
+	void push_back(bool value) {
+		if (_size % 8 == 0) _bytes.push_back(0);
+		if (value) _bytes[_size / 8] |= 1 << (_size % 8);
+		++_size;
+	}
+
+	/// Remove all bits.
+	void clear() {
+		_bytes.clear();
+		_size = 0;
+	}
+
+	/// Compare two bit vectors.
+	friend bool operator== (bit_vector const & a, bit_vector const & b) {
+		return a._size == b._size && a._bytes == b._bytes;
+	}
+
+	/// Compare two bit vectors.
+	friend bool operator!= (bit_vector const & a, bit_vector const & b) {
+		return !(a == b);
+	}
+
+private:
+	/// Clear the unused bits of the last byte.
+	void clear_padding() {
+		if (_size % 8) _bytes.back() &= std::uint8_t(0xff >> (8 - _size % 8));
+	}
+
+	/// The packed bits.
+	std::vector<std::uint8_t> _bytes;
+
+	/// The number of bits.
+	std::size_t _size = 0;
+};
+
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <asio/ip/tcp.hpp>
+
+namespace modbus {
+
+/// Capture of Modbus/TCP frames to a pcap file.
+/**
+ * Every recorded frame is written as one IPv4/TCP packet with a nanosecond timestamp,
+ * with synthesized IP and TCP headers, so the file can be opened with Wireshark or tcpdump
+ * and read back by modbus_replay.
+ * IPv6 endpoints are recorded with the unspecified IPv4 address.
+ *
+ * Recording a frame only copies it to a buffer under a mutex.
+ * A background thread writes the buffer to the file.
+ * If the writer falls behind by more than max_pending bytes, new frames are dropped and counted.
+ *
+ * One capture file may be shared by any number of clients and servers,
+ * and record() may be called from any thread.
+ */
+class capture_file {
+public:
+	using tcp = asio::ip::tcp;
+
+	/// Direction of a frame relative to the local endpoint.
+	enum class direction : std::uint8_t {
+		outgoing, ///< Sent from the local endpoint to the remote endpoint.
+		incoming, ///< Received by the local endpoint from the remote endpoint.
+	};
+
+	/// The maximum number of bytes waiting to be written before frames are dropped.
+	std::size_t max_pending = 16 * 1024 * 1024;
+
+	capture_file() = default;
+	capture_file(capture_file const &) = delete;
+	capture_file & operator= (capture_file const &) = delete;
+
+	/// Flush and close the file.
+	~capture_file();
+
+	/// Open a file and start the writer thread.
+	/**
+	 * An existing file is overwritten.
+	 *
+	 * \return The error that occured while opening the file, if any.
+	 */
+	std::error_code open(
+		std::string const & path ///< The path of the file to write.
+	);
+
+	/// Write all recorded frames, stop the writer thread and close the file.
+	void close();
+
+	/// Check if the file is open.
+	bool is_open() const;
+
+	/// Record a frame.
+	/**
+	 * Does nothing if the file is not open.
+	 */
+	void record(
+		tcp::endpoint const & local,  ///< The local endpoint of the connection.
+		tcp::endpoint const & remote, ///< The remote endpoint of the connection.
+		direction direction,          ///< The direction of the frame.
+		std::uint8_t const * data,    ///< The frame.
+		std::size_t size              ///< The size of the frame in bytes.
+	);
+
+	/// Get the number of frames dropped because the writer fell behind.
+	std::uint64_t dropped() const;
+
+	/// Get the error that stopped the writer thread, if any.
+	std::error_code error() const;
+
+protected:
+	/// Write recorded frames until the file is closed.
+	void run();
+
+	/// The file.
+	std::FILE * file = nullptr;
+
+	/// The writer thread.
+	std::thread writer;
+
+	/// Mutex to protect the members below.
+	mutable std::mutex mutex;
+
+	/// Signaled when frames are recorded or the file is closed.
+	std::condition_variable wake;
+
+	/// Recorded frames that are not written yet.
+	std::vector<std::uint8_t> pending;
+
+	/// True while the file is open.
+	bool open_ = false;
+
+	/// True if the writer thread should stop after writing the pending frames.
+	bool stopping = false;
+
+	/// Number of dropped frames.
+	std::uint64_t dropped_ = 0;
+
+	/// The error that stopped the writer thread.
+	std::error_code error_;
+};
+
+}
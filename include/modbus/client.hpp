@@ -24,26 +24,65 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
-#include <string>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <asio/async_result.hpp>
+#include <asio/buffer.hpp>
 #include <asio/io_context.hpp>
 #include <asio/strand.hpp>
 #include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
 #include <asio/streambuf.hpp>
 
+#include "capture.hpp"
+#include "completion.hpp"
 #include "functions.hpp"
+#include "handler_memory.hpp"
+#include "latency_histogram.hpp"
 #include "tcp.hpp"
+#include "reply_handler.hpp"
 #include "request.hpp"
 #include "response.hpp"
+#include "timer_wheel.hpp"
+#include "trace.hpp"
 
 namespace modbus {
 
 
 /// A connection to a Modbus server.
+/**
+ * Threading model:
+ *
+ * All state of a client is owned by its strand. Every public function may be called from any thread:
+ * the work is dispatched to the strand, so it runs immediately when called from the strand itself
+ * (for example from a callback) and is queued otherwise.
+ * Callbacks are always invoked from the strand, so callbacks of one client never run concurrently,
+ * but callbacks of different clients do when the IO context is run by more than one thread.
+ * Many clients can share one IO context run by any number of threads.
+ *
+ * is_open() and is_connected() read atomic flags and may also be called from any thread.
+ * Their result can be outdated by the time it is used.
+ * The same holds for statistics_snapshot() and reset_statistics(), which lock a mutex.
+ *
+ * Public settings such as default_timeout and coalesce_reads are not synchronized.
+ * They should be set before the client is used, or from the strand.
+ *
+ * The client must outlive all callbacks and queued work, so it should only be destroyed
+ * after close() has run and the IO context has no more work for it.
+ */
 class client  {
 public:
 	typedef asio::ip::tcp tcp;
@@ -52,24 +91,241 @@ public:
 	template<typename T>
 	using Callback = std::function<void (tcp_mbap const & header, T const & response, std::error_code const &)>;
 
+	/// Statistics of a client, see collect_statistics.
+	struct statistics {
+		/// Round trip latency of replies per unit and function code, keyed by unit << 8 | function.
+		/**
+		 * Measured from the moment a request is passed to the client until its reply handler is invoked,
+		 * so it includes the time spent in the transmit queue, on the network and in the server.
+		 * Exception responses are included, timeouts and other local errors are not.
+		 */
+		std::map<std::uint16_t, latency_histogram> latencies;
+
+		/// Time spent in reply handlers, including the user callbacks.
+		latency_histogram handler_time;
+
+		/// Number of bytes written to the socket.
+		std::uint64_t bytes_out = 0;
+
+		/// Number of bytes read from the socket.
+		std::uint64_t bytes_in = 0;
+
+		/// Number of request frames written to the socket.
+		std::uint64_t frames_out = 0;
+
+		/// Number of reply frames read from the socket, including orphaned replies.
+		std::uint64_t frames_in = 0;
+
+		/// Number of exception responses, indexed by exception code (the matching errc value).
+		std::array<std::uint64_t, 256> exceptions{};
+
+		/// Number of transactions that timed out.
+		std::uint64_t timeouts = 0;
+
+		/// Number of replies that did not match an open transaction, such as late replies to a timed out request.
+		std::uint64_t orphaned_replies = 0;
+
+		/// Number of reads that were attached to an identical read in flight instead of being sent, see deduplicate_reads.
+		std::uint64_t deduplicated_reads = 0;
+
+		/// Number of transactions in flight when the statistics were last updated.
+		std::size_t in_flight = 0;
+
+		/// Largest number of transactions in flight seen.
+		std::size_t peak_in_flight = 0;
+
+		/// Get the latency histogram for a unit and function code, or null if no reply was recorded.
+		latency_histogram const * latency(std::uint8_t unit, std::uint8_t function) const {
+			auto entry = latencies.find(unit << 8 | function);
+			return entry == latencies.end() ? nullptr : &entry->second;
+		}
+	};
+
 	/// Callback to invoke for IO errors that cants be linked to a specific transaction.
 	/**
 	 * Additionally the connection will be closed and every transaction callback will be called with an EOF error.
 	 */
 	std::function<void (std::error_code const &)> on_io_error;
 
+	/// Callback to invoke when the client reconnected automatically, see auto_reconnect.
+	std::function<void ()> on_reconnect;
+
+	/// Value for the timeout of a request to use the default timeout of the client.
+	static std::chrono::milliseconds const use_default_timeout;
+
+	/// The default timeout for requests.
+	/**
+	 * If a reply does not arrive before the timeout expires,
+	 * the callback is invoked with a transaction_timeout error.
+	 * A reply that arrives later is discarded.
+	 *
+	 * A timeout of zero means requests never time out.
+	 */
+	std::chrono::milliseconds default_timeout{0};
+
+	/// If true, reads of holding registers and input registers are coalesced.
+	/**
+	 * Register reads for the same unit and function that are queued in the same strand turn
+	 * are merged into a single request if they are close enough together (see coalesce_gap),
+	 * as long as the merged request does not exceed the protocol limit of 125 registers.
+	 * The values of the reply are split out again to the callback of every original read.
+	 *
+	 * A merged read also reads the registers in the gaps between the original reads.
+	 * If the server replies to a merged read with an exception, the original reads are retried separately.
+	 *
+	 * The timeout of a merged read is the shortest timeout of the original reads.
+	 *
+	 * Only reads with a copyable callback are coalesced. Reads with a completion token are always sent separately.
+	 */
+	bool coalesce_reads = false;
+
+	/// The maximum number of unrequested registers between two reads that may be coalesced.
+	std::uint16_t coalesce_gap = 0;
+
+	/// If true, a read that is identical to a read in flight is attached to that transaction instead of being sent.
+	/**
+	 * Reads are identical if they have the same unit, function code, address and count.
+	 * The callback of the attached read is invoked with the reply to the transaction in flight,
+	 * or with its error, so the timeout of the attached read is ignored.
+	 *
+	 * Any other request to a unit, such as a write, ends deduplication with the reads to that unit sent before it.
+	 * A read started after a write is never answered with a reply that may predate the write.
+	 *
+	 * Reads that are coalesced (see coalesce_reads) are only compared after merging.
+	 */
+	bool deduplicate_reads = false;
+
+	/// The maximum number of transactions sent to the server at the same time, or zero for no limit.
+	/**
+	 * Requests beyond the limit are held by the client and sent in order as earlier transactions complete,
+	 * for devices that can only handle a few concurrent transactions.
+	 *
+	 * The timeout of a held request includes the time it was held.
+	 */
+	std::size_t max_in_flight = 0;
+
+	/// If true, the client reconnects automatically when an established connection is lost.
+	/**
+	 * Requests that were sent on the lost connection fail with a connection_lost error,
+	 * since their replies can no longer arrive.
+	 * Requests that were not written yet are kept and sent when the connection is restored.
+	 * Timeouts keep running while the client is reconnecting.
+	 *
+	 * Reconnect attempts are spaced with exponential backoff: the delay starts at reconnect_delay
+	 * and doubles after every failed attempt up to max_reconnect_delay.
+	 * Every delay is randomly shortened by up to half, so that many clients losing their connection
+	 * at the same time do not reconnect in lockstep.
+	 *
+	 * Reconnecting stops when close() is called.
+	 * A failed initial connect() is not retried.
+	 */
+	bool auto_reconnect = false;
+
+	/// The delay before the first reconnect attempt.
+	std::chrono::milliseconds reconnect_delay{100};
+
+	/// The maximum delay between reconnect attempts.
+	std::chrono::milliseconds max_reconnect_delay{30000};
+
+	/// If true, the client collects statistics, see statistics_snapshot().
+	/**
+	 * Collecting statistics costs two clock reads and an uncontended mutex lock per transaction.
+	 */
+	bool collect_statistics = false;
+
+	/// If set, the client pushes a transaction_trace to this ring for every transaction that receives a reply.
+	/**
+	 * The application drains the ring from one thread at a time.
+	 * The ring must not be shared with other clients.
+	 */
+	std::shared_ptr<trace_ring> trace;
+
+	/// If set, the client records every frame it sends and receives in this capture file.
+	/**
+	 * The capture file may be shared with other clients and servers.
+	 */
+	std::shared_ptr<capture_file> capture;
+
 protected:
+	/// The RTU client shares the reply handlers and decoding of this client.
+	friend class rtu_client;
+
+	/// Transmit state of a transaction.
+	enum class transmit_state : std::uint8_t {
+		held,   ///< Waiting for room in the in-flight window.
+		queued, ///< Waiting in the transmit queue for the next write.
+		sent,   ///< Written or being written to the socket.
+	};
+
 	/// Low level message handler.
-	using Handler = std::function<std::uint8_t const * (std::uint8_t const * start, std::size_t size, tcp_mbap const & header, std::error_code error)>;
+	/**
+	 * Stored inside the transaction table, so small handlers do not need a heap allocation.
+	 */
+	using Handler = reply_handler;
 
 	/// Struct to hold transaction details.
 	struct transaction_t {
-		std::uint8_t function;
+		/// The function code of the request.
+		std::uint8_t function = 0;
+
+		/// Generation of the slot, incremented every time the slot is released.
+		/**
+		 * The generation is encoded in the high bits of the transaction ID,
+		 * so that a late reply for a released slot is not mistaken for a reply to a newer transaction.
+		 */
+		std::uint8_t generation = 0;
+
+		/// True if the slot holds an open transaction.
+		bool active = false;
+
+		/// The unit identifier of the request.
+		std::uint8_t unit = 0;
+
+		/// The transmit state of the request.
+		transmit_state state = transmit_state::held;
+
+		/// True while the frame is part of an unfinished write operation.
+		/**
+		 * The slot is not reused before the write finishes, even if the transaction is released.
+		 */
+		bool in_write = false;
+
+		/// The handler for the reply.
 		Handler handler;
+
+		/// The size of the serialized request in the frame buffer of the slot.
+		std::uint16_t frame_size = 0;
+
+		/// The time the request was passed to the client, only set if statistics are collected or tracing is enabled.
+		std::chrono::steady_clock::time_point enqueued;
+
+		/// The time the request was serialized, only set if tracing is enabled.
+		std::chrono::steady_clock::time_point serialized;
+
+		/// The time the request was written completely, only set if tracing is enabled.
+		std::chrono::steady_clock::time_point written;
+
+		/// True if the transaction is a read registered in in_flight_reads, see deduplicate_reads.
+		bool shared = false;
+
+		/// The key of the read in in_flight_reads.
+		std::uint64_t read_key = 0;
+
+		/// Handlers of identical reads attached to this transaction.
+		std::vector<Handler> followers;
 	};
 
-	/// Strand to use to prevent concurrent handler execution.
-	asio::io_context::strand strand;
+	/// Number of low bits of a transaction ID that hold the slot index.
+	static constexpr int transaction_slot_bits = 10;
+
+	/// Number of slots in the transaction table, which is the maximum number of open transactions.
+	static constexpr std::size_t transaction_slots = std::size_t(1) << transaction_slot_bits;
+
+	/// Maximum size of a Modbus TCP frame: the MBAP header and a PDU of at most 253 bytes.
+	static constexpr std::size_t max_frame_size = 260;
+
+	/// Strand that owns all state of the client.
+	asio::strand<asio::io_context::executor_type> strand;
 
 	/// The socket to use.
 	tcp::socket socket;
@@ -80,27 +336,175 @@ protected:
 	/// Buffer for read operations.
 	asio::streambuf read_buffer;
 
-	/// Buffer for write operations.
-	asio::streambuf write_buffer;
+	/// Memory for the read operation, so that the read loop does not allocate.
+	handler_memory read_memory;
+
+	/// Memory for the write operation.
+	handler_memory write_memory;
 
-	/// Output iterator for write buffer.
-	std::ostreambuf_iterator<char> output_iterator{&write_buffer};
+	/// Memory for the wait operation of the timeout timer.
+	handler_memory timer_memory;
+
+	/// Memory for the posted flush of the transmit queue.
+	handler_memory flush_memory;
 
 	/// Transaction table to keep track of open transactions.
-	std::map<int, transaction_t> transactions;
+	/**
+	 * Indexed by the low bits of the transaction ID, see transaction_slot_bits.
+	 */
+	std::vector<transaction_t> transactions;
 
-	/// Next transaction ID.
-	std::uint16_t next_id = 0;
+	/// Ring buffer of free slots in the transaction table.
+	/**
+	 * Slots are reused in FIFO order, so that a released slot stays unused for as long as possible.
+	 */
+	std::vector<std::uint16_t> free_slots;
 
-	/// Indicates if a message is currently being written.
+	/// Index in free_slots of the next free slot to use.
+	std::size_t free_head = 0;
+
+	/// Number of free slots in free_slots.
+	std::size_t free_count = 0;
+
+	/// Frame buffers for the serialized requests, max_frame_size bytes per transaction slot.
 	/**
-	 * During this time, new messages will be buffered instead.
-	 * Only the latest message gets buffered, all older messages are discarded.
+	 * Allocated once and left uninitialized, so pages of unused slots are never touched.
 	 */
-	std::atomic_flag writing{false};
+	std::unique_ptr<std::uint8_t[]> frames;
+
+	/// Ring buffer of transaction IDs held back by max_in_flight, oldest first.
+	std::vector<std::uint16_t> held;
+
+	/// Index in held of the oldest held transaction.
+	std::size_t held_head = 0;
 
-	/// Track connected state of client.
-	bool _connected;
+	/// Number of transactions in held.
+	std::size_t held_count = 0;
+
+	/// Number of open transactions that are not held.
+	std::size_t in_flight = 0;
+
+	/// Transaction IDs of the frames to write with the next write operation.
+	std::vector<std::uint16_t> transmit_queue;
+
+	/// Slots of the frames in the current write operation.
+	std::vector<std::uint16_t> write_batch;
+
+	/// Buffers of the current write operation, one per frame.
+	std::vector<asio::const_buffer> write_buffers;
+
+	/// Index in write_buffers of the first buffer that is not completely written yet.
+	std::size_t write_offset = 0;
+
+	/// True if a flush of the transmit queue has been posted to the strand.
+	bool flush_posted = false;
+
+	/// Timer wheel for transaction timeouts, indexed by transaction slot.
+	/**
+	 * One tick of the wheel is one millisecond since timeout_epoch.
+	 */
+	timer_wheel timeouts{transaction_slots};
+
+	/// The single timer used to advance the timer wheel.
+	asio::steady_timer timeout_timer;
+
+	/// The time point of tick zero of the timer wheel.
+	std::chrono::steady_clock::time_point timeout_epoch;
+
+	/// The collected statistics, protected by statistics_mutex.
+	statistics stats;
+
+	/// Mutex to protect the collected statistics.
+	mutable std::mutex statistics_mutex;
+
+	/// The completion time of the read that carried the first byte of the message at the front of read_buffer.
+	/**
+	 * The read times are only kept if tracing is enabled.
+	 */
+	std::chrono::steady_clock::time_point front_received;
+
+	/// The completion time of the current read operation.
+	std::chrono::steady_clock::time_point read_time;
+
+	/// The completion time of the previous read operation.
+	std::chrono::steady_clock::time_point previous_read_time;
+
+	/// The number of bytes in read_buffer that were received before the current read operation.
+	std::size_t read_carried = 0;
+
+	/// Transaction IDs of the reads in flight by read key, see deduplicate_reads.
+	std::unordered_map<std::uint64_t, std::uint16_t> in_flight_reads;
+
+	/// The local endpoint of the connection, recorded in the capture file.
+	tcp::endpoint capture_local;
+
+	/// The remote endpoint of the connection, recorded in the capture file.
+	tcp::endpoint capture_remote;
+
+	/// The tick at which the timeout timer expires, or zero if it is not armed.
+	std::uint64_t timeout_timer_tick = 0;
+
+	/// The host name of the server, to reconnect to.
+	std::string hostname;
+
+	/// The port of the server, to reconnect to.
+	std::string port;
+
+	/// True while the client is reconnecting after a lost connection.
+	/**
+	 * Queued frames are not written while reconnecting.
+	 */
+	bool reconnecting = false;
+
+	/// The current reconnect delay, before jitter.
+	std::chrono::milliseconds reconnect_backoff{0};
+
+	/// Timer for the delay between reconnect attempts.
+	asio::steady_timer reconnect_timer;
+
+	/// Random generator for the reconnect jitter.
+	std::minstd_rand random;
+
+	/// A register read waiting to be coalesced with other reads.
+	template<typename T>
+	struct pending_read_t {
+		/// The unit identifier of the target device.
+		std::uint8_t unit;
+
+		/// The original request.
+		T request;
+
+		/// The callback of the original request.
+		Callback<typename T::response> callback;
+
+		/// The timeout of the original request.
+		std::chrono::milliseconds timeout;
+	};
+
+	/// Holding register reads waiting to be coalesced.
+	std::vector<pending_read_t<request::read_holding_registers>> pending_holding_reads;
+
+	/// Input register reads waiting to be coalesced.
+	std::vector<pending_read_t<request::read_input_registers>> pending_input_reads;
+
+	/// True if a flush of the pending reads has been posted to the strand.
+	bool pending_reads_posted = false;
+
+	/// Indicates if a write operation is busy.
+	/**
+	 * During this time, new frames wait in the transmit queue,
+	 * which is flushed when the write operation finishes.
+	 */
+	bool writing = false;
+
+	/// True if the socket is open, readable from any thread.
+	std::atomic<bool> _open{false};
+
+	/// True if the client is connected, readable from any thread.
+	/**
+	 * Cleared when the read loop fails, even if the socket is still open.
+	 */
+	std::atomic<bool> _connected{false};
 
 public:
 	/// Construct a client.
@@ -128,13 +532,18 @@ public:
 
 	/// Disconnect from the server.
 	/**
-	 * Any remaining transaction callbacks will be invoked with an EOF error.
+	 * Any remaining transaction callbacks will be invoked with an operation_aborted error.
+	 *
+	 * When called from outside the strand, the connection is closed asynchronously.
 	 */
 	void close();
 
 	/// Reset the client.
 	/**
 	 * Should be called before re-opening a connection after a previous connection was closed.
+	 *
+	 * When called from outside the strand, the client is reset asynchronously,
+	 * but always after a close() that was called earlier from the same thread.
 	 */
 	void reset();
 
@@ -142,21 +551,28 @@ public:
 	/**
 	 * \return True if the connection to the server is open.
 	 */
-	bool is_open() {
-		return socket.is_open();
+	bool is_open() const {
+		return _open;
 	}
 
 	/// Check if the client is connected.
-	bool is_connected() {
-		return is_open() && _connected;
+	bool is_connected() const {
+		return _open && _connected;
 	}
 
+	/// Get a copy of the collected statistics.
+	statistics statistics_snapshot() const;
+
+	/// Reset the collected statistics.
+	void reset_statistics();
+
 	/// Read a number of coils from the connected server.
 	void read_coils(
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first coil to read.
 		std::uint16_t count,                                            ///< The number of coils to read.
-		Callback<response::read_coils> const & callback                 ///< The callback to invoke when the reply or error arrives.
+		Callback<response::read_coils> const & callback,                ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Read a number of discrete inputs from the connected server.
@@ -164,7 +580,8 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first coil to read.
 		std::uint16_t count,                                            ///< The number of inputs to read.
-		Callback<response::read_discrete_inputs> const & callback       ///< The callback to invoke when the reply or error arrives.
+		Callback<response::read_discrete_inputs> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Read a number of holding registers from the connected server.
@@ -172,7 +589,8 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first coil to read.
 		std::uint16_t count,                                            ///< The number of registers to read.
-		Callback<response::read_holding_registers> const & callback     ///< The callback to invoke when the reply or error arrives.
+		Callback<response::read_holding_registers> const & callback,    ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Read a number of input registers from the connected server.
@@ -180,7 +598,36 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first coil to read.
 		std::uint16_t count,                                            ///< The number of registers to read.
-		Callback<response::read_input_registers> const & callback       ///< The callback to invoke when the reply or error arrives.
+		Callback<response::read_input_registers> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of holding registers from the connected server without copying the values.
+	/**
+	 * The callback receives a view of the values in the receive buffer.
+	 * The view is only valid for the duration of the callback.
+	 * These reads are never coalesced.
+	 */
+	void read_holding_registers_view(
+		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                          ///< The address of the first register to read.
+		std::uint16_t count,                                            ///< The number of registers to read.
+		Callback<response::read_holding_registers_view> const & callback, ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of input registers from the connected server without copying the values.
+	/**
+	 * The callback receives a view of the values in the receive buffer.
+	 * The view is only valid for the duration of the callback.
+	 * These reads are never coalesced.
+	 */
+	void read_input_registers_view(
+		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                          ///< The address of the first register to read.
+		std::uint16_t count,                                            ///< The number of registers to read.
+		Callback<response::read_input_registers_view> const & callback, ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Write to a single coil on the connected server.
@@ -188,7 +635,8 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the coil.
 		bool value,                                                     ///< The value to write.
-		Callback<response::write_single_coil> const & callback          ///< The callback to invoke when the reply or error arrives.
+		Callback<response::write_single_coil> const & callback,         ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Write to a single register on the connected server.
@@ -196,15 +644,17 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the register.
 		std::uint16_t value,                                            ///< The value to write.
-		Callback<response::write_single_register> const & callback      ///< The callback to invoke when the reply or error arrives.
+		Callback<response::write_single_register> const & callback,     ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Write to a number of coils on the connected server.
 	void write_multiple_coils(
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first coil to write.
-		std::vector<bool> values,                                       ///< The values to write.
-		Callback<response::write_multiple_coils> const & callback       ///< The callback to invoke when the reply or error arrives.
+		bit_vector values,                                              ///< The values to write.
+		Callback<response::write_multiple_coils> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Write to a number of registers on the connected server.
@@ -212,7 +662,8 @@ public:
 		std::uint8_t unit,                                              ///< The Modbus TCP unit to send the command to.
 		std::uint16_t address,                                          ///< The address of the first register to write.
 		std::vector<std::uint16_t> values,                              ///< The values to write.
-		Callback<response::write_multiple_registers> const & callback   ///< The callback to invoke when the reply or error arrives.
+		Callback<response::write_multiple_registers> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
 	);
 
 	/// Perform a masked write to a register on the connected server.
@@ -225,10 +676,281 @@ public:
 		std::uint16_t address,                                     ///< The address of the first register to write.
 		std::uint16_t and_mask,                                    ///< The AND mask to apply.
 		std::uint16_t or_mask,                                     ///< The OR mask to apply.
-		Callback<response::mask_write_register> const & callback   ///< The callback to invoke when the reply or error arrives.
+		Callback<response::mask_write_register> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout    ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to and then read from a number of registers on the connected server in one transaction.
+	/**
+	 * The server performs the write before the read,
+	 * so reading the written registers returns the new values.
+	 * At most 121 registers can be written and 125 registers read.
+	 */
+	void read_write_multiple_registers(
+		std::uint8_t unit,                                                   ///< The Modbus TCP unit to send the command to.
+		std::uint16_t read_address,                                          ///< The address of the first register to read.
+		std::uint16_t read_count,                                            ///< The number of registers to read.
+		std::uint16_t write_address,                                         ///< The address of the first register to write.
+		std::vector<std::uint16_t> values,                                   ///< The values to write.
+		Callback<response::read_write_multiple_registers> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout              ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of file records from the connected server.
+	/**
+	 * The values of all records must fit in one response, which holds at most 124 registers for a single record.
+	 * See file_transfer to read larger ranges.
+	 */
+	void read_file_record(
+		std::uint8_t unit,                                        ///< The Modbus TCP unit to send the command to.
+		std::vector<file_record_reference> records,               ///< The records to read.
+		Callback<response::read_file_record> const & callback,    ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write a number of file records on the connected server.
+	/**
+	 * The values of all records must fit in one request, which holds at most 122 registers for a single record.
+	 * See file_transfer to write larger ranges.
+	 */
+	void write_file_record(
+		std::uint8_t unit,                                        ///< The Modbus TCP unit to send the command to.
+		std::vector<file_record> records,                         ///< The records to write.
+		Callback<response::write_file_record> const & callback,   ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read the contents of a FIFO queue from the connected server.
+	/**
+	 * A response holds at most 31 values.
+	 */
+	void read_fifo_queue(
+		std::uint8_t unit,                                        ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                    ///< The address of the FIFO pointer register.
+		Callback<response::read_fifo_queue> const & callback,     ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
 	);
 
 protected:
+	/// Initiation function object for requests with a completion token.
+	template<typename R, typename T>
+	struct initiate_request;
+
+	/// Result type of a request function for a completion token.
+	template<typename Token, typename R, typename T>
+	using async_request_result = decltype(asio::async_initiate<Token, void (std::error_code, R)>(std::declval<initiate_request<R, T>>(), std::declval<Token &>()));
+
+public:
+	/// Read a number of coils from the connected server.
+	/**
+	 * The callback can be any callable with the signature of Callback<response::read_coils>.
+	 * It is stored in the transaction table without being converted to a std::function,
+	 * so callables of up to reply_handler::inline_size bytes do not cause a heap allocation.
+	 * The same holds for the other templated request functions.
+	 */
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_coils>::value>::type read_coils(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_coils{address, count}, make_handler<response::read_coils>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Read a number of coils from the connected server, completing an asio completion token.
+	/**
+	 * Any asio completion token can be used instead of a callback, such as asio::use_future or asio::use_awaitable.
+	 * The completion signature is void(std::error_code, R) where R is the response type,
+	 * so `co_await client.read_coils(unit, address, count, asio::use_awaitable)` returns the response or throws a std::system_error.
+	 *
+	 * The completion handler is invoked through its associated executor, and its associated allocator is used to dispatch it.
+	 * The handler is stored in the transaction table like any other callback,
+	 * so small handlers such as coroutine handlers do not cause a heap allocation.
+	 * The same holds for the other request functions that take a completion token.
+	 */
+	template<typename Token>
+	auto read_coils(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_coils>::value, async_request_result<Token, response::read_coils, request::read_coils>>::type {
+		return async_request<response::read_coils>(unit, request::read_coils{address, count}, token, timeout);
+	}
+
+	/// Read a number of discrete inputs from the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_discrete_inputs>::value>::type read_discrete_inputs(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_discrete_inputs{address, count}, make_handler<response::read_discrete_inputs>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Read a number of discrete inputs from the connected server, completing an asio completion token.
+	template<typename Token>
+	auto read_discrete_inputs(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_discrete_inputs>::value, async_request_result<Token, response::read_discrete_inputs, request::read_discrete_inputs>>::type {
+		return async_request<response::read_discrete_inputs>(unit, request::read_discrete_inputs{address, count}, token, timeout);
+	}
+
+	/// Read a number of holding registers from the connected server.
+	/**
+	 * Only copyable callbacks can be coalesced, move-only callbacks are always sent as a separate request.
+	 */
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_holding_registers>::value>::type read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_read(unit, request::read_holding_registers{address, count}, std::forward<F>(callback), timeout, std::is_copy_constructible<typename std::decay<F>::type>());
+	}
+
+	/// Read a number of holding registers from the connected server, completing an asio completion token.
+	template<typename Token>
+	auto read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_holding_registers>::value, async_request_result<Token, response::read_holding_registers, request::read_holding_registers>>::type {
+		return async_request<response::read_holding_registers>(unit, request::read_holding_registers{address, count}, token, timeout);
+	}
+
+	/// Read a number of input registers from the connected server.
+	/**
+	 * Only copyable callbacks can be coalesced, move-only callbacks are always sent as a separate request.
+	 */
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_input_registers>::value>::type read_input_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_read(unit, request::read_input_registers{address, count}, std::forward<F>(callback), timeout, std::is_copy_constructible<typename std::decay<F>::type>());
+	}
+
+	/// Read a number of input registers from the connected server, completing an asio completion token.
+	template<typename Token>
+	auto read_input_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_input_registers>::value, async_request_result<Token, response::read_input_registers, request::read_input_registers>>::type {
+		return async_request<response::read_input_registers>(unit, request::read_input_registers{address, count}, token, timeout);
+	}
+
+	/// Read a number of holding registers from the connected server without copying the values.
+	template<typename F>
+	void read_holding_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_holding_registers{address, count}, make_handler<response::read_holding_registers_view>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Read a number of input registers from the connected server without copying the values.
+	template<typename F>
+	void read_input_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_input_registers{address, count}, make_handler<response::read_input_registers_view>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to a single coil on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::write_single_coil>::value>::type write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::write_single_coil{address, value}, make_handler<response::write_single_coil>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to a single coil on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::write_single_coil>::value, async_request_result<Token, response::write_single_coil, request::write_single_coil>>::type {
+		return async_request<response::write_single_coil>(unit, request::write_single_coil{address, value}, token, timeout);
+	}
+
+	/// Write to a single register on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::write_single_register>::value>::type write_single_register(std::uint8_t unit, std::uint16_t address, std::uint16_t value, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::write_single_register{address, value}, make_handler<response::write_single_register>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to a single register on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto write_single_register(std::uint8_t unit, std::uint16_t address, std::uint16_t value, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::write_single_register>::value, async_request_result<Token, response::write_single_register, request::write_single_register>>::type {
+		return async_request<response::write_single_register>(unit, request::write_single_register{address, value}, token, timeout);
+	}
+
+	/// Write to a number of coils on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::write_multiple_coils>::value>::type write_multiple_coils(std::uint8_t unit, std::uint16_t address, bit_vector values, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::write_multiple_coils{address, std::move(values)}, make_handler<response::write_multiple_coils>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to a number of coils on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto write_multiple_coils(std::uint8_t unit, std::uint16_t address, bit_vector values, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::write_multiple_coils>::value, async_request_result<Token, response::write_multiple_coils, request::write_multiple_coils>>::type {
+		return async_request<response::write_multiple_coils>(unit, request::write_multiple_coils{address, std::move(values)}, token, timeout);
+	}
+
+	/// Write to a number of registers on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::write_multiple_registers>::value>::type write_multiple_registers(std::uint8_t unit, std::uint16_t address, std::vector<std::uint16_t> values, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::write_multiple_registers{address, std::move(values)}, make_handler<response::write_multiple_registers>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to a number of registers on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto write_multiple_registers(std::uint8_t unit, std::uint16_t address, std::vector<std::uint16_t> values, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::write_multiple_registers>::value, async_request_result<Token, response::write_multiple_registers, request::write_multiple_registers>>::type {
+		return async_request<response::write_multiple_registers>(unit, request::write_multiple_registers{address, std::move(values)}, token, timeout);
+	}
+
+	/// Perform a masked write to a register on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::mask_write_register>::value>::type mask_write_register(std::uint8_t unit, std::uint16_t address, std::uint16_t and_mask, std::uint16_t or_mask, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::mask_write_register{address, and_mask, or_mask}, make_handler<response::mask_write_register>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Perform a masked write to a register on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto mask_write_register(std::uint8_t unit, std::uint16_t address, std::uint16_t and_mask, std::uint16_t or_mask, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::mask_write_register>::value, async_request_result<Token, response::mask_write_register, request::mask_write_register>>::type {
+		return async_request<response::mask_write_register>(unit, request::mask_write_register{address, and_mask, or_mask}, token, timeout);
+	}
+
+	/// Write to and then read from a number of registers on the connected server in one transaction.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_write_multiple_registers>::value>::type read_write_multiple_registers(std::uint8_t unit, std::uint16_t read_address, std::uint16_t read_count, std::uint16_t write_address, std::vector<std::uint16_t> values, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_write_multiple_registers{read_address, read_count, write_address, std::move(values)}, make_handler<response::read_write_multiple_registers>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write to and then read from a number of registers on the connected server in one transaction, completing an asio completion token.
+	template<typename Token>
+	auto read_write_multiple_registers(std::uint8_t unit, std::uint16_t read_address, std::uint16_t read_count, std::uint16_t write_address, std::vector<std::uint16_t> values, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_write_multiple_registers>::value, async_request_result<Token, response::read_write_multiple_registers, request::read_write_multiple_registers>>::type {
+		return async_request<response::read_write_multiple_registers>(unit, request::read_write_multiple_registers{read_address, read_count, write_address, std::move(values)}, token, timeout);
+	}
+
+	/// Read a number of file records from the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_file_record>::value>::type read_file_record(std::uint8_t unit, std::vector<file_record_reference> records, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_file_record{std::move(records)}, make_handler<response::read_file_record>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Read a number of file records from the connected server, completing an asio completion token.
+	template<typename Token>
+	auto read_file_record(std::uint8_t unit, std::vector<file_record_reference> records, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_file_record>::value, async_request_result<Token, response::read_file_record, request::read_file_record>>::type {
+		return async_request<response::read_file_record>(unit, request::read_file_record{std::move(records)}, token, timeout);
+	}
+
+	/// Write a number of file records on the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::write_file_record>::value>::type write_file_record(std::uint8_t unit, std::vector<file_record> records, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::write_file_record{std::move(records)}, make_handler<response::write_file_record>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Write a number of file records on the connected server, completing an asio completion token.
+	template<typename Token>
+	auto write_file_record(std::uint8_t unit, std::vector<file_record> records, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::write_file_record>::value, async_request_result<Token, response::write_file_record, request::write_file_record>>::type {
+		return async_request<response::write_file_record>(unit, request::write_file_record{std::move(records)}, token, timeout);
+	}
+
+	/// Read the contents of a FIFO queue from the connected server.
+	template<typename F>
+	typename std::enable_if<is_request_callback<F, response::read_fifo_queue>::value>::type read_fifo_queue(std::uint8_t unit, std::uint16_t address, F && callback, std::chrono::milliseconds timeout = use_default_timeout) {
+		send_message(unit, request::read_fifo_queue{address}, make_handler<response::read_fifo_queue>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Read the contents of a FIFO queue from the connected server, completing an asio completion token.
+	template<typename Token>
+	auto read_fifo_queue(std::uint8_t unit, std::uint16_t address, Token && token, std::chrono::milliseconds timeout = use_default_timeout)
+	-> typename std::enable_if<!is_request_callback<Token, response::read_fifo_queue>::value, async_request_result<Token, response::read_fifo_queue, request::read_fifo_queue>>::type {
+		return async_request<response::read_fifo_queue>(unit, request::read_fifo_queue{address}, token, timeout);
+	}
+
+protected:
+	/// Disconnect from the server, must be called from the strand.
+	void close_();
+
+	/// Reset the client, must be called from the strand.
+	void reset_();
+
 	/// Called when the resolver finished resolving a hostname.
 	void on_resolve(
 		std::error_code const & error,                        ///<[in] The error that occured, if any.
@@ -243,6 +965,35 @@ protected:
 		std::function<void(std::error_code const &)> callback ///<[in] User callback to invoke whent the connection succeeded.
 	);
 
+	/// Start the read loop.
+	void start_read();
+
+	/// Handle the loss of an established connection when auto_reconnect is enabled.
+	/**
+	 * Fails the transactions that were sent and starts reconnecting.
+	 */
+	void on_connection_lost();
+
+	/// Schedule the next reconnect attempt with backoff and jitter.
+	void schedule_reconnect();
+
+	/// Called when the reconnect timer expires.
+	void on_reconnect_timer(
+		std::error_code const & error ///<[in] The error that occured, if any.
+	);
+
+	/// Called when the resolver finished resolving a hostname for a reconnect attempt.
+	void on_reconnect_resolve(
+		std::error_code const & error,   ///<[in] The error that occured, if any.
+		tcp::resolver::iterator iterator ///<[in] The iterator to the first endpoint found by the resolver.
+	);
+
+	/// Called when the socket finished connecting for a reconnect attempt.
+	void on_reconnect_connect(
+		std::error_code const & error,   ///<[in] The error that occured, if any.
+		tcp::resolver::iterator iterator ///<[in] The iterator to the endpoint that was connected to.
+	);
+
 	/// Called when the socket finished a read operation.
 	void on_read(
 		std::error_code const & error, ///<[in] The error that occured, if any.
@@ -256,7 +1007,69 @@ protected:
 	);
 
 	/// Allocate a transaction in the transaction table.
-	std::uint16_t allocate_transaction(std::uint8_t function, Handler handler);
+	/**
+	 * \return True if the transaction was allocated, false if the transaction table is full.
+	 */
+	bool allocate_transaction(
+		std::uint8_t function,   ///<[in] The function code of the request.
+		Handler & handler,       ///<[in] The handler for the reply, moved into the transaction if it was allocated.
+		std::uint16_t & id       ///<[out] The transaction ID of the allocated transaction.
+	);
+
+	/// Find an open transaction by transaction ID.
+	/**
+	 * \return The transaction, or null if there is no open transaction with the given ID.
+	 */
+	transaction_t * find_transaction(std::uint16_t id);
+
+	/// Release a transaction slot so that it can be reused.
+	void release_transaction(transaction_t & transaction);
+
+	/// Stop attaching new reads to the reads in flight to a unit, see deduplicate_reads.
+	void forget_reads(std::uint8_t unit);
+
+	/// Release an open transaction and invoke its handler with an error.
+	void abort_transaction(transaction_t & transaction, std::error_code const & error);
+
+	/// Get the current tick of the timeout timer wheel.
+	std::uint64_t timeout_tick() const;
+
+	/// Start the timeout for an open transaction.
+	void start_timeout(std::uint16_t id, std::chrono::milliseconds timeout);
+
+	/// Arm the timeout timer for the next tick the timer wheel needs to be advanced.
+	void arm_timeout_timer();
+
+	/// Called when the timeout timer expires.
+	void on_timeout_timer(
+		std::error_code const & error ///<[in] The error that occured, if any.
+	);
+
+	/// Get the queue of pending reads for a request type.
+	std::vector<pending_read_t<request::read_holding_registers>> & pending_reads(request::read_holding_registers const &) { return pending_holding_reads; }
+
+	/// Get the queue of pending reads for a request type.
+	std::vector<pending_read_t<request::read_input_registers>> & pending_reads(request::read_input_registers const &) { return pending_input_reads; }
+
+	/// Queue a register read to be coalesced with other reads queued in the same strand turn.
+	template<typename T>
+	void queue_read(
+		std::uint8_t unit,                         ///< The unit identifier of the target device.
+		T const & request,                         ///< The application data unit of the request.
+		Callback<typename T::response> callback,   ///< The callback to invoke when the reply arrives.
+		std::chrono::milliseconds timeout          ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Coalesce and send all pending reads.
+	void flush_pending_reads();
+
+	/// Coalesce and send a list of pending reads.
+	template<typename T>
+	void send_coalesced(std::vector<pending_read_t<T>> reads);
+
+	/// Send a merged read for a group of pending reads and split the reply.
+	template<typename T>
+	void send_merged(std::vector<pending_read_t<T>> reads, std::uint16_t address, std::uint16_t count);
 
 	/// Parse and process a message from the read buffer.
 	/**
@@ -264,22 +1077,133 @@ protected:
 	 */
 	bool process_message();
 
-	/// Flush the write buffer.
-	void flush_write_buffer_();
+	/// Remember the endpoints of a new connection for the capture file.
+	void capture_endpoints();
+
+	/// Remove a processed message from the read buffer.
+	void consume_message(std::size_t size);
+
+	/// Return a slot to the ring buffer of free slots.
+	void free_slot(std::size_t slot);
+
+	/// Queue the frame of a new transaction for transmission, or hold it if the in-flight window is full.
+	void queue_frame(transaction_t & transaction);
 
-	/// Flush the write buffer.
+	/// Move held transactions to the transmit queue while the in-flight window has room.
+	void send_held();
+
+	/// Post a flush of the transmit queue to the strand, if not already posted.
+	/**
+	 * All frames queued in the same strand turn are written with a single gather write.
+	 */
+	void post_flush();
+
+	/// Write all frames in the transmit queue with a single gather write.
 	/**
 	 * Does nothing if a write operation is still busy.
-	 * The buffer will be automatically flushed when when the write operation finishes.
+	 * The queue will be automatically flushed when the write operation finishes.
 	 */
-	void flush_write_buffer();
+	void flush_transmit_queue();
+
+	/// Write the remaining buffers of the current batch.
+	void write_batch_();
+
+	/// Finish the current write operation and release slots that were kept for it.
+	void finish_write();
+
+	/// Handler that deserializes a reply and passes it to a user callback.
+	template<typename T, typename F>
+	struct decoding_handler {
+		/// The user callback.
+		F callback;
+
+		std::uint8_t const * operator() (std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error) {
+			T response;
+			std::uint8_t const * end = decode_reply(start, length, header, response, error);
+			callback(header, std::move(response), error);
+			return end;
+		}
+	};
+
+	/// Make a handler that deserializes a reply as T and passes it to a user callback.
+	template<typename T, typename F>
+	static Handler make_handler(F && callback) {
+		return Handler(decoding_handler<T, typename std::decay<F>::type>{std::forward<F>(callback)});
+	}
+
+	/// Deserialize the PDU of a reply.
+	/**
+	 * Exception responses are reported as error.
+	 * Does nothing if error already contains an error.
+	 *
+	 * \return Pointer past the deserialized data.
+	 */
+	template<typename T>
+	static std::uint8_t const * decode_reply(
+		std::uint8_t const * start,   ///<[in] The start of the PDU.
+		std::size_t length,           ///<[in] The length of the PDU.
+		tcp_mbap const & header,      ///<[in] The MBAP header of the reply.
+		T & response,                 ///<[out] The deserialized response.
+		std::error_code & error       ///<[in,out] The error that occured, if any.
+	);
+
+	/// Send a register read, coalesced if enabled.
+	template<typename T, typename F>
+	void send_read(std::uint8_t unit, T const & request, F && callback, std::chrono::milliseconds timeout, std::true_type /* copyable */) {
+		if (coalesce_reads) return queue_read(unit, request, Callback<typename T::response>(std::forward<F>(callback)), timeout);
+		send_message(unit, request, make_handler<typename T::response>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Send a register read with a move-only callback, which is never coalesced.
+	template<typename T, typename F>
+	void send_read(std::uint8_t unit, T const & request, F && callback, std::chrono::milliseconds timeout, std::false_type /* copyable */) {
+		send_message(unit, request, make_handler<typename T::response>(std::forward<F>(callback)), timeout);
+	}
+
+	/// Initiation function object for requests with a completion token.
+	/**
+	 * The completion handler is always stored directly in the transaction table.
+	 * It is never coalesced, since that would type-erase it into a std::function.
+	 */
+	template<typename R, typename T>
+	struct initiate_request {
+		client * self;
+		std::uint8_t unit;
+		T request;
+		std::chrono::milliseconds timeout;
+
+		template<typename CompletionHandler>
+		void operator() (CompletionHandler && handler) {
+			self->send_message(unit, request, make_handler<R>(adapt_completion<R>(self->io_executor(), std::forward<CompletionHandler>(handler))), timeout);
+		}
+	};
+
+	/// Start a request that completes a completion token.
+	template<typename R, typename T, typename Token>
+	async_request_result<Token, R, T> async_request(std::uint8_t unit, T request, Token & token, std::chrono::milliseconds timeout) {
+		return asio::async_initiate<Token, void (std::error_code, R)>(initiate_request<R, T>{this, unit, std::move(request), timeout}, token);
+	}
 
 	/// Send a Modbus request to the server.
 	template<typename T>
 	void send_message(
-		std::uint8_t unit,                       ///< The unit identifier of the target device.
-		T const & request,                       ///< The application data unit of the request.
-		Callback<typename T::response> callback  ///< The callback to invoke when the reply arrives.
+		std::uint8_t unit,                         ///< The unit identifier of the target device.
+		T const & request,                         ///< The application data unit of the request.
+		Handler handler,                           ///< The handler to invoke when the reply arrives.
+		std::chrono::milliseconds timeout          ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Allocate a transaction for a request and write the request to the server.
+	/**
+	 * Must be called from the strand.
+	 */
+	template<typename T>
+	void start_transaction(
+		std::uint8_t unit,                               ///< The unit identifier of the target device.
+		T const & request,                               ///< The application data unit of the request.
+		Handler & handler,                               ///< The handler to invoke when the reply arrives.
+		std::chrono::milliseconds timeout,               ///< The timeout for the request, or use_default_timeout.
+		std::chrono::steady_clock::time_point enqueued   ///< The time the request was passed to the client.
 	);
 };
 
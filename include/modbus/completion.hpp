@@ -0,0 +1,108 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <asio/associated_allocator.hpp>
+#include <asio/associated_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/executor_work_guard.hpp>
+
+#include "tcp.hpp"
+
+namespace modbus {
+
+/// Check if F can be invoked as a request callback for a response of type R.
+/**
+ * Anything that is not a request callback is treated as an asio completion token.
+ */
+template<typename F, typename R, typename = void>
+struct is_request_callback : std::false_type {};
+
+template<typename F, typename R>
+struct is_request_callback<F, R, decltype(void(std::declval<F &>()(
+	std::declval<tcp_mbap const &>(),
+	std::declval<R const &>(),
+	std::declval<std::error_code const &>()
+)))> : std::true_type {};
+
+/// Nullary function object that invokes a completion handler with a stored result.
+/**
+ * The associated allocator of the completion handler is propagated,
+ * so that dispatching the result uses the allocator of the handler.
+ */
+template<typename Handler, typename R>
+struct completion_binder {
+	using allocator_type = asio::associated_allocator_t<Handler>;
+
+	/// The completion handler.
+	Handler handler;
+
+	/// The error to pass to the handler.
+	std::error_code error;
+
+	/// The response to pass to the handler.
+	R response;
+
+	allocator_type get_allocator() const noexcept { return asio::get_associated_allocator(handler); }
+
+	void operator() () {
+		handler(error, std::move(response));
+	}
+};
+
+/// Request callback that completes an asio completion handler with signature void(std::error_code, R).
+/**
+ * The completion handler is invoked through its associated executor.
+ * The executor has outstanding work until the handler is dispatched,
+ * so its execution context does not run out of work while the request is pending.
+ */
+template<typename Executor, typename Handler, typename R>
+struct completion_adapter {
+	/// Outstanding work on the associated executor of the handler.
+	asio::executor_work_guard<Executor> work;
+
+	/// The completion handler.
+	Handler handler;
+
+	void operator() (tcp_mbap const &, R response, std::error_code const & error) {
+		asio::dispatch(work.get_executor(), completion_binder<Handler, R>{std::move(handler), error, std::move(response)});
+		work.reset();
+	}
+};
+
+/// Make a request callback for a completion handler.
+template<typename R, typename Executor, typename Handler>
+completion_adapter<asio::associated_executor_t<typename std::decay<Handler>::type, Executor>, typename std::decay<Handler>::type, R>
+adapt_completion(Executor const & fallback, Handler && handler) {
+	auto executor = asio::get_associated_executor(handler, fallback);
+	return {asio::make_work_guard(executor), std::forward<Handler>(handler)};
+}
+
+}
@@ -44,6 +44,11 @@ namespace errc {
 		message_too_large                       = 0x1002,
 		unexpected_function_code                = 0x1003,
 		invalid_value                           = 0x1004,
+		crc_mismatch                            = 0x1005,
+
+		too_many_transactions                   = 0x2001,
+		transaction_timeout                     = 0x2002,
+		connection_lost                         = 0x2003,
 	};
 }
 
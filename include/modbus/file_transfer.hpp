@@ -0,0 +1,205 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include <asio/io_context.hpp>
+#include <asio/strand.hpp>
+
+#include "client.hpp"
+
+namespace modbus {
+
+/// Streaming transfer of files and FIFO queues with a client.
+/**
+ * File transfers are split into read_file_record or write_file_record requests of the maximum size that fits in a PDU,
+ * and up to depth requests of a transfer are kept in flight at the same time.
+ * Read data is passed to a sink in order, as soon as all data before it has arrived,
+ * so the application never has to hold the whole file.
+ *
+ * A transfer stops at the first error. Requests that are already in flight still complete,
+ * but no more data is passed to the sink, and the done callback receives the error.
+ *
+ * The sink and done callbacks are invoked from the strand of the file_transfer.
+ * The file_transfer and the client must outlive all transfers.
+ */
+class file_transfer {
+public:
+	/// Callback that receives the data of a read, with the offset of the first value from the start of the transfer.
+	using Sink = std::function<void (std::size_t offset, std::vector<std::uint16_t> const & values)>;
+
+	/// Callback invoked once when a transfer is complete or failed.
+	using Done = std::function<void (std::error_code const & error)>;
+
+	/// The maximum number of records in a read_file_record response with a single sub-request.
+	static constexpr std::uint16_t max_read_count = 124;
+
+	/// The maximum number of records in a write_file_record request with a single sub-request.
+	static constexpr std::uint16_t max_write_count = 122;
+
+	/// The maximum number of values in a read_fifo_queue response.
+	static constexpr std::uint16_t max_fifo_count = 31;
+
+	/// The maximum number of requests of one file transfer in flight.
+	std::size_t depth = 4;
+
+	/// The timeout for every request, or client::use_default_timeout.
+	std::chrono::milliseconds timeout = client::use_default_timeout;
+
+protected:
+	/// The type of a transfer.
+	enum class kind {
+		read,
+		write,
+		fifo,
+	};
+
+	/// The state of a transfer.
+	struct transfer_t {
+		/// The type of the transfer.
+		kind type;
+
+		/// The unit to transfer from or to.
+		std::uint8_t unit;
+
+		/// The file number.
+		std::uint16_t file;
+
+		/// The first record number, or the address of the FIFO pointer register.
+		std::uint16_t address;
+
+		/// The number of values to transfer, or the maximum for a FIFO transfer until its last read.
+		std::size_t total;
+
+		/// The offset of the next request.
+		std::size_t next = 0;
+
+		/// The number of values passed to the sink or written.
+		std::size_t completed = 0;
+
+		/// The number of requests in flight.
+		std::size_t in_flight = 0;
+
+		/// The number of reads left for a FIFO transfer.
+		std::size_t fifo_reads = 0;
+
+		/// The values to write.
+		std::vector<std::uint16_t> values;
+
+		/// Read data that arrived before the data in front of it, by offset.
+		std::map<std::size_t, std::vector<std::uint16_t>> pending;
+
+		/// The sink for read data.
+		Sink sink;
+
+		/// The callback to invoke when the transfer is complete.
+		Done done;
+
+		/// The first error of the transfer.
+		std::error_code error;
+	};
+
+	/// The client to use.
+	client & _client;
+
+	/// Strand to use to prevent concurrent handler execution.
+	asio::strand<asio::io_context::executor_type> strand;
+
+public:
+	/// Construct a file transfer helper.
+	file_transfer(
+		asio::io_context & io_context, ///< The IO context to use.
+		modbus::client & client        ///< The client to transfer with.
+	);
+
+	/// Read a range of records from a file.
+	/**
+	 * The records must not extend past record number 65535, or the transfer fails with std::errc::invalid_argument.
+	 */
+	void read_file(
+		std::uint8_t unit,    ///< The Modbus TCP unit to read from.
+		std::uint16_t file,   ///< The file number.
+		std::uint16_t record, ///< The number of the first record to read.
+		std::size_t count,    ///< The number of records to read.
+		Sink sink,            ///< The callback that receives the read records in order.
+		Done done             ///< The callback to invoke when the transfer is complete.
+	);
+
+	/// Write a range of records to a file.
+	/**
+	 * The records must not extend past record number 65535, or the transfer fails with std::errc::invalid_argument.
+	 */
+	void write_file(
+		std::uint8_t unit,                 ///< The Modbus TCP unit to write to.
+		std::uint16_t file,                ///< The file number.
+		std::uint16_t record,              ///< The number of the first record to write.
+		std::vector<std::uint16_t> values, ///< The values of the records.
+		Done done                          ///< The callback to invoke when the transfer is complete.
+	);
+
+	/// Read a FIFO queue.
+	/**
+	 * The Modbus specification does not remove the values of a read_fifo_queue response from the queue,
+	 * so by default the queue is read once.
+	 *
+	 * Some devices do remove the values they return. For those, max_reads can be raised to drain the queue:
+	 * it is then read until a response holds less than max_fifo_count values or max_reads reads are done.
+	 * Whether this drains the queue or reads the same values again is device-specific.
+	 * The reads are sent one at a time.
+	 */
+	void read_fifo(
+		std::uint8_t unit,         ///< The Modbus TCP unit to read from.
+		std::uint16_t address,     ///< The address of the FIFO pointer register.
+		Sink sink,                 ///< The callback that receives the values in order.
+		Done done,                 ///< The callback to invoke when the transfer is complete.
+		std::size_t max_reads = 1  ///< The maximum number of reads.
+	);
+
+protected:
+	/// Start a transfer, or fail it if the range is invalid.
+	void start(std::shared_ptr<transfer_t> transfer);
+
+	/// Send requests until the transfer has depth requests in flight, and finish the transfer when it is complete.
+	void fill(std::shared_ptr<transfer_t> const & transfer);
+
+	/// Called when a read of a file transfer completes.
+	void on_read(std::shared_ptr<transfer_t> const & transfer, std::size_t offset, std::size_t count, std::vector<std::uint16_t> & values, std::error_code const & error);
+
+	/// Called when a write of a file transfer completes.
+	void on_write(std::shared_ptr<transfer_t> const & transfer, std::size_t count, std::error_code const & error);
+
+	/// Called when a read of a FIFO transfer completes.
+	void on_fifo(std::shared_ptr<transfer_t> const & transfer, std::vector<std::uint16_t> & values, std::error_code const & error);
+};
+
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include <asio/io_context.hpp>
+#include <asio/strand.hpp>
+
+#include "rtu_client.hpp"
+#include "server.hpp"
+
+namespace modbus {
+
+/// A gateway that forwards Modbus/TCP requests to Modbus RTU buses.
+/**
+ * Requests are routed by their unit ID to the RTU bus that serves the unit.
+ * Replies are sent back with the MBAP header of the original request, so TCP clients can pipeline requests as usual.
+ *
+ * Every bus has its own scheduler, which takes requests from the TCP connections round robin:
+ * a connection with many queued requests can not starve the other connections.
+ * The scheduler keeps one request queued in the RTU client behind the request on the wire,
+ * so the next request goes out as soon as the bus is free.
+ *
+ * Requests for units without a bus are answered with a gateway_path_unavailable exception,
+ * and requests that time out on the bus with gateway_target_device_failed_to_respond.
+ * Exception responses from RTU servers are forwarded to the TCP client.
+ *
+ * Buses must be added before the gateway starts listening.
+ */
+class gateway {
+public:
+	using tcp = asio::ip::tcp;
+
+	/// Construct a gateway.
+	gateway(
+		asio::io_context & io_context ///< The IO context to use.
+	);
+
+	/// Add an RTU bus that serves a set of units.
+	/**
+	 * A unit that was already routed to another bus is moved to the new bus.
+	 *
+	 * \return The RTU client of the bus, which must still be opened.
+	 */
+	rtu_client & add_bus(
+		std::vector<std::uint8_t> const & units ///< The unit IDs of the servers on the bus.
+	);
+
+	/// Start listening for Modbus/TCP connections on an endpoint.
+	/**
+	 * \return The error that occured while opening the acceptor, if any.
+	 */
+	std::error_code listen(
+		tcp::endpoint const & endpoint ///< The endpoint to listen on.
+	) {
+		return server.listen(endpoint);
+	}
+
+	/// Stop accepting connections and close all connections and buses.
+	void close();
+
+	/// Maximum number of requests a single connection can have queued on a bus.
+	/**
+	 * Requests beyond this limit are answered with a server_device_busy exception.
+	 * Should be set before the gateway starts listening.
+	 */
+	std::size_t max_queued = 32;
+
+	/// The TCP server of the gateway.
+	/**
+	 * Can be used to set on_io_error or a capture file, or to get the local endpoint.
+	 * The request handlers and on_disconnect are set by the gateway and must not be changed.
+	 */
+	modbus::server server;
+
+protected:
+	/// A queued request, which sends itself on the bus and calls the done function when the reply was forwarded.
+	using job = std::function<void (std::function<void ()> done)>;
+
+	/// An RTU bus with its scheduler.
+	struct bus {
+		/// Strand that owns the scheduler state.
+		asio::strand<asio::io_context::executor_type> strand;
+
+		/// The RTU client of the bus.
+		rtu_client client;
+
+		/// Queued requests per TCP connection, by connection ID.
+		std::map<std::uint64_t, std::deque<job>> queues;
+
+		/// Connections with queued requests, in round robin order.
+		std::deque<std::uint64_t> ready;
+
+		/// Number of requests passed to the RTU client and not finished yet.
+		std::size_t in_flight = 0;
+
+		bus(asio::io_context & io_context) : strand(io_context.get_executor()), client(io_context) {}
+	};
+
+	/// Maximum number of requests passed to the RTU client of a bus at the same time.
+	/**
+	 * One request is on the wire, the next one waits in the RTU client.
+	 */
+	enum { bus_depth = 2 };
+
+	/// The IO context.
+	asio::io_context & io_context;
+
+	/// The buses.
+	std::vector<std::unique_ptr<bus>> buses;
+
+	/// The bus of every unit ID, or null if the unit is not routed.
+	std::array<bus *, 256> routes{};
+
+	/// Forward a request to the bus of its unit.
+	template<typename T>
+	void forward(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply);
+
+	/// Queue a request on a bus, or call the busy function if the queue of the connection is full.
+	void queue(bus & bus, std::uint64_t connection, job job, std::function<void ()> busy);
+
+	/// Drop the queued requests of a closed connection from all buses.
+	void disconnect(std::uint64_t connection);
+
+	/// Pass queued requests to the RTU client of a bus while it has room.
+	void pump(bus & bus);
+};
+
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace modbus {
+
+/// Memory for the state of one outstanding asynchronous operation.
+/**
+ * Asynchronous operations that are started over and over again, like the read loop of a connection,
+ * can use this memory instead of the heap.
+ * If the memory is already in use or too small, the allocation falls back to the heap.
+ */
+class handler_memory {
+public:
+	enum : std::size_t {
+		/// Number of bytes available for an operation.
+		size = 512,
+	};
+
+	handler_memory() = default;
+	handler_memory(handler_memory const &) = delete;
+	handler_memory & operator= (handler_memory const &) = delete;
+
+	/// Allocate memory for an operation.
+	void * allocate(std::size_t bytes) {
+		if (!in_use && bytes <= size) {
+			in_use = true;
+			return &storage;
+		}
+		return ::operator new(bytes);
+	}
+
+	/// Deallocate memory for an operation.
+	void deallocate(void * pointer) {
+		if (pointer == &storage) {
+			in_use = false;
+		} else {
+			::operator delete(pointer);
+		}
+	}
+
+private:
+	/// The memory.
+	typename std::aligned_storage<size, alignof(std::max_align_t)>::type storage;
+
+	/// True if the memory is currently used by an operation.
+	bool in_use = false;
+};
+
+/// Allocator that uses a handler_memory.
+template<typename T>
+class handler_allocator {
+public:
+	using value_type = T;
+
+	explicit handler_allocator(handler_memory & memory) : memory(&memory) {}
+
+	template<typename U>
+	handler_allocator(handler_allocator<U> const & other) noexcept : memory(other.memory) {}
+
+	T * allocate(std::size_t n) const {
+		return static_cast<T *>(memory->allocate(sizeof(T) * n));
+	}
+
+	void deallocate(T * pointer, std::size_t) const {
+		memory->deallocate(pointer);
+	}
+
+	template<typename U>
+	bool operator== (handler_allocator<U> const & other) const noexcept { return memory == other.memory; }
+
+	template<typename U>
+	bool operator!= (handler_allocator<U> const & other) const noexcept { return memory != other.memory; }
+
+private:
+	template<typename> friend class handler_allocator;
+
+	/// The memory to allocate from.
+	handler_memory * memory;
+};
+
+/// Completion handler with an associated executor and an associated handler_allocator.
+template<typename Executor, typename Handler>
+class memory_bound_handler {
+public:
+	using executor_type  = Executor;
+	using allocator_type = handler_allocator<void>;
+
+	memory_bound_handler(Executor const & executor, handler_memory & memory, Handler handler) :
+		executor(executor),
+		memory(memory),
+		handler(std::move(handler)) {}
+
+	executor_type get_executor() const noexcept { return executor; }
+	allocator_type get_allocator() const noexcept { return allocator_type(memory); }
+
+	template<typename... Args>
+	void operator() (Args && ... args) {
+		handler(std::forward<Args>(args)...);
+	}
+
+private:
+	/// The executor to run the handler on.
+	Executor executor;
+
+	/// The memory to allocate operation state from.
+	handler_memory & memory;
+
+	/// The wrapped handler.
+	Handler handler;
+};
+
+/// Bind an executor and handler memory to a completion handler.
+template<typename Executor, typename Handler>
+memory_bound_handler<Executor, typename std::decay<Handler>::type> bind_memory(Executor const & executor, handler_memory & memory, Handler && handler) {
+	return {executor, memory, std::forward<Handler>(handler)};
+}
+
+}
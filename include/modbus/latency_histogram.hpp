@@ -0,0 +1,129 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace modbus {
+
+/// Histogram of latencies with logarithmic buckets split in linear sub-buckets.
+/**
+ * Latencies are recorded in nanoseconds.
+ * Latencies below 2 * sub_buckets nanoseconds are recorded exactly,
+ * larger latencies with a relative error of at most 1 / sub_buckets.
+ *
+ * Recording a latency is O(1) and does not allocate.
+ */
+class latency_histogram {
+public:
+	enum : unsigned int {
+		/// Number of bits of precision below the most significant bit of a latency.
+		sub_bucket_bits = 5,
+
+		/// Number of linear sub-buckets per power of two.
+		sub_buckets = 1 << sub_bucket_bits,
+
+		/// Number of powers of two covered by the histogram.
+		buckets = 64 - sub_bucket_bits + 1,
+	};
+
+	/// Record a latency.
+	void record(std::chrono::nanoseconds latency) {
+		std::uint64_t value = latency.count() > 0 ? latency.count() : 0;
+		++counts[index(value)];
+		++total;
+		sum      += value;
+		maximum_  = std::max(maximum_, value);
+	}
+
+	/// Add the samples of another histogram.
+	void merge(latency_histogram const & other) {
+		for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+		total    += other.total;
+		sum      += other.sum;
+		maximum_  = std::max(maximum_, other.maximum_);
+	}
+
+	/// Get the number of recorded latencies.
+	std::uint64_t count() const { return total; }
+
+	/// Get the mean of the recorded latencies.
+	std::chrono::nanoseconds mean() const { return std::chrono::nanoseconds(total ? sum / total : 0); }
+
+	/// Get the largest recorded latency.
+	std::chrono::nanoseconds maximum() const { return std::chrono::nanoseconds(maximum_); }
+
+	/// Get the latency below which the given fraction of the recorded latencies falls.
+	/**
+	 * The result is the upper bound of the bucket that contains the percentile.
+	 */
+	std::chrono::nanoseconds percentile(double fraction) const {
+		if (total == 0) return std::chrono::nanoseconds(0);
+		std::uint64_t rank  = std::max<std::uint64_t>(1, std::uint64_t(fraction * total + 0.5));
+		std::uint64_t count = 0;
+		for (std::size_t i = 0; i < counts.size(); ++i) {
+			count += counts[i];
+			if (count >= rank) return std::chrono::nanoseconds(std::min(upper_bound(i), maximum_));
+		}
+		return std::chrono::nanoseconds(maximum_);
+	}
+
+protected:
+	/// Get the bucket index for a value.
+	/**
+	 * Values below 2 * sub_buckets have their own bucket.
+	 * Larger values are shifted right until they fit in the range [sub_buckets, 2 * sub_buckets).
+	 */
+	static std::size_t index(std::uint64_t value) {
+		unsigned int shift = value < 2 * sub_buckets ? 0 : 63 - __builtin_clzll(value) - sub_bucket_bits;
+		return shift * sub_buckets + (value >> shift);
+	}
+
+	/// Get the largest value that falls in a bucket.
+	static std::uint64_t upper_bound(std::size_t index) {
+		if (index < 2 * sub_buckets) return index;
+		unsigned int shift = index / sub_buckets - 1;
+		std::uint64_t top  = index % sub_buckets + sub_buckets;
+		return ((top + 1) << shift) - 1;
+	}
+
+	/// The number of samples per bucket.
+	std::array<std::uint64_t, buckets * sub_buckets> counts{};
+
+	/// The total number of samples.
+	std::uint64_t total = 0;
+
+	/// The sum of all samples.
+	std::uint64_t sum = 0;
+
+	/// The largest sample.
+	std::uint64_t maximum_ = 0;
+};
+
+}
@@ -0,0 +1,281 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <asio/io_context.hpp>
+#include <asio/strand.hpp>
+#include <asio/steady_timer.hpp>
+
+#include "client.hpp"
+
+namespace modbus {
+
+/// Cyclic poller that reads scan groups from a client.
+/**
+ * A scan group is a set of reads that is performed every period.
+ * Cycles are scheduled on a fixed grid of start time + N * period, so the schedule does not drift
+ * when individual cycles start late. All groups share a single timer, and due groups are started
+ * in deadline order.
+ *
+ * Scan groups must be added before the poller is started, but they may be removed at any time.
+ * The statistics of a group may be retrieved from any thread.
+ */
+class poller {
+public:
+	using clock = std::chrono::steady_clock;
+
+	/// What to do when a scan group is still busy when its next cycle is due.
+	enum class overrun_policy {
+		/// Skip the missed cycles and keep the original schedule.
+		skip,
+
+		/// Start the next cycle as soon as the busy cycle finishes, and continue the schedule from there.
+		delay,
+	};
+
+	/// Statistics of a scan group.
+	/**
+	 * Averages are exponential moving averages over roughly the last 16 cycles.
+	 */
+	struct statistics {
+		/// Number of completed cycles.
+		std::uint64_t cycles = 0;
+
+		/// Number of cycles skipped because the previous cycle was still busy.
+		std::uint64_t skipped = 0;
+
+		/// Number of cycles started late because the previous cycle was still busy.
+		std::uint64_t delayed = 0;
+
+		/// Number of reads that completed with an error.
+		std::uint64_t errors = 0;
+
+		/// The achieved cycle rate in Hz.
+		double achieved_rate = 0;
+
+		/// The time between the deadline and the actual start of the last cycle.
+		clock::duration last_lateness{0};
+
+		/// The average lateness of cycles.
+		clock::duration mean_lateness{0};
+
+		/// The maximum lateness of cycles.
+		clock::duration max_lateness{0};
+
+		/// The average absolute deviation of the interval between cycle starts from the period.
+		clock::duration jitter{0};
+
+		/// The time it took to complete all reads of the last cycle.
+		clock::duration last_cycle_time{0};
+
+		/// The maximum time it took to complete all reads of a cycle.
+		clock::duration max_cycle_time{0};
+	};
+
+	/// Callback invoked when all reads of a cycle have completed.
+	std::function<void (std::size_t group, statistics const & statistics)> on_cycle;
+
+protected:
+	/// Function to start a read, which must call the given function when the read completes.
+	using Read = std::function<void (std::function<void (std::error_code const &)> done)>;
+
+	/// A scan group.
+	struct group_t {
+		/// The period of the group.
+		clock::duration period;
+
+		/// The offset of the first cycle from the start of the poller.
+		clock::duration offset;
+
+		/// The overrun policy of the group.
+		overrun_policy policy;
+
+		/// The reads of the group.
+		std::vector<Read> reads;
+
+		/// The deadline of the next cycle.
+		clock::time_point deadline;
+
+		/// The start time of the current or last cycle.
+		clock::time_point cycle_start;
+
+		/// The number of reads of the current cycle that have not completed yet.
+		std::size_t outstanding = 0;
+
+		/// True if a cycle became due while the group was busy, with the delay policy.
+		bool due = false;
+
+		/// True if the group was removed.
+		bool removed = false;
+
+		/// The average interval between cycle starts, or zero if there was no interval yet.
+		clock::duration mean_interval{0};
+
+		/// The statistics of the group, protected by statistics_mutex.
+		statistics stats;
+	};
+
+	/// An entry in the deadline queue.
+	struct entry_t {
+		/// The deadline of the group.
+		clock::time_point deadline;
+
+		/// The index of the group.
+		std::size_t group;
+
+		/// Order entries so that the earliest deadline is at the top of a max-heap.
+		bool operator< (entry_t const & other) const {
+			return deadline > other.deadline;
+		}
+	};
+
+	/// The client to read from.
+	client & _client;
+
+	/// Strand to use to prevent concurrent handler execution.
+	asio::strand<asio::io_context::executor_type> strand;
+
+	/// The timer for the earliest deadline.
+	asio::steady_timer timer;
+
+	/// The scan groups.
+	std::vector<group_t> groups;
+
+	/// Heap of scheduled groups ordered by deadline.
+	std::vector<entry_t> queue;
+
+	/// Mutex to protect the statistics of the groups.
+	mutable std::mutex statistics_mutex;
+
+	/// True if the poller is running.
+	bool running = false;
+
+public:
+	/// Construct a poller.
+	poller(
+		asio::io_context & io_context, ///< The IO context to use.
+		modbus::client & client        ///< The client to read from.
+	);
+
+	/// Add a scan group.
+	/**
+	 * The period must be positive.
+	 *
+	 * \return The index of the scan group.
+	 */
+	std::size_t add_group(
+		std::chrono::milliseconds period,                   ///< The period of the group. Must be positive.
+		overrun_policy policy = overrun_policy::skip,       ///< What to do when the group is still busy when the next cycle is due.
+		std::chrono::milliseconds offset = std::chrono::milliseconds::zero() ///< The offset of the first cycle from the start of the poller.
+	);
+
+	/// Remove a scan group.
+	/**
+	 * No new cycles of the group are started. Reads that are already in progress will still complete.
+	 * The indices of the other groups do not change.
+	 */
+	void remove_group(
+		std::size_t group ///< The index of the scan group.
+	);
+
+	/// Add a read of coils to a scan group.
+	void read_coils(
+		std::size_t group,                                         ///< The index of the scan group.
+		std::uint8_t unit,                                         ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                     ///< The address of the first coil to read.
+		std::uint16_t count,                                       ///< The number of coils to read.
+		client::Callback<response::read_coils> callback            ///< The callback to invoke for every reply or error.
+	);
+
+	/// Add a read of discrete inputs to a scan group.
+	void read_discrete_inputs(
+		std::size_t group,                                         ///< The index of the scan group.
+		std::uint8_t unit,                                         ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                     ///< The address of the first input to read.
+		std::uint16_t count,                                       ///< The number of inputs to read.
+		client::Callback<response::read_discrete_inputs> callback  ///< The callback to invoke for every reply or error.
+	);
+
+	/// Add a read of holding registers to a scan group.
+	void read_holding_registers(
+		std::size_t group,                                           ///< The index of the scan group.
+		std::uint8_t unit,                                           ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                       ///< The address of the first register to read.
+		std::uint16_t count,                                         ///< The number of registers to read.
+		client::Callback<response::read_holding_registers> callback  ///< The callback to invoke for every reply or error.
+	);
+
+	/// Add a read of input registers to a scan group.
+	void read_input_registers(
+		std::size_t group,                                           ///< The index of the scan group.
+		std::uint8_t unit,                                           ///< The Modbus TCP unit to send the command to.
+		std::uint16_t address,                                       ///< The address of the first register to read.
+		std::uint16_t count,                                         ///< The number of registers to read.
+		client::Callback<response::read_input_registers> callback    ///< The callback to invoke for every reply or error.
+	);
+
+	/// Start polling.
+	/**
+	 * The first cycle of every group is due at the start time plus the offset of the group.
+	 */
+	void start();
+
+	/// Stop polling.
+	/**
+	 * Reads that are already in progress will still complete.
+	 */
+	void stop();
+
+	/// Get the statistics of a scan group.
+	statistics group_statistics(std::size_t group) const;
+
+protected:
+	/// Add a read to a scan group.
+	void add_read(std::size_t group, Read read);
+
+	/// Arm the timer for the earliest deadline.
+	void arm_timer();
+
+	/// Called when the timer expires.
+	void on_timer(std::error_code const & error);
+
+	/// Start a cycle of a group.
+	void start_cycle(std::size_t group, clock::time_point now);
+
+	/// Called when a read of a cycle completes.
+	void on_read_done(std::size_t group, std::error_code const & error);
+
+	/// Schedule the next cycle of a group after the given time.
+	void schedule(std::size_t group, clock::time_point now);
+};
+
+}
@@ -0,0 +1,199 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <asio/io_context.hpp>
+
+#include "client.hpp"
+#include "server.hpp"
+
+namespace modbus {
+
+/// A Modbus/TCP proxy that answers reads from a cache of the downstream device.
+/**
+ * Many upstream clients connect to the server of the proxy, which forwards requests to one downstream device.
+ * Reads of coils, discrete inputs, holding registers and input registers are answered from a cache per unit
+ * when every requested value is younger than max_age. Otherwise the read is forwarded and its reply fills the cache.
+ * Downstream register reads are coalesced by the client, so misses of many upstream clients
+ * that arrive together are merged into fewer downstream reads.
+ *
+ * Writes are always forwarded. The written range is invalidated when the write is sent and again when it completes,
+ * and replies to reads that were sent before a write to the same table are not cached.
+ * Combined read/write requests are forwarded like writes, and the values they read are not cached.
+ * File record and FIFO requests are forwarded without caching.
+ *
+ * Exception responses of the device are forwarded as-is. Timeouts and other errors of the downstream connection
+ * are answered with gateway_target_device_failed_to_respond or gateway_path_unavailable.
+ */
+class proxy {
+public:
+	using tcp = asio::ip::tcp;
+
+	/// The maximum age of a cached value that may be served to an upstream client.
+	/**
+	 * The age of a value counts from the time the read that returned it was sent to the device.
+	 * A value of zero disables the cache, but still coalesces downstream reads.
+	 * May only be changed before the proxy is used.
+	 */
+	std::chrono::milliseconds max_age{100};
+
+	/// The server for upstream clients.
+	/**
+	 * Can be used to set on_io_error or a capture file, or to get the local endpoint.
+	 * The request handlers are set by the proxy and must not be changed.
+	 */
+	modbus::server server;
+
+	/// The client for the downstream device.
+	/**
+	 * Can be used to set timeouts, auto_reconnect and the coalescing settings.
+	 * Coalescing of register reads is enabled by default.
+	 */
+	modbus::client client;
+
+	/// Construct a proxy.
+	proxy(
+		asio::io_context & io_context ///< The IO context to use.
+	);
+
+	/// Connect to the downstream device.
+	void connect(
+		std::string const & hostname,                         ///< The IP address or host name of the device.
+		std::string const & port,                             ///< The port to connect to.
+		std::function<void(std::error_code const &)> callback ///< The callback to invoke when the connection is established, or when an error occurs.
+	) {
+		client.connect(hostname, port, std::move(callback));
+	}
+
+	/// Start listening for upstream clients on an endpoint.
+	/**
+	 * \return The error that occured while opening the acceptor, if any.
+	 */
+	std::error_code listen(
+		tcp::endpoint const & endpoint ///< The endpoint to listen on.
+	) {
+		return server.listen(endpoint);
+	}
+
+	/// Stop accepting upstream connections and close all connections.
+	void close();
+
+	/// Get the number of reads answered from the cache.
+	std::uint64_t cache_hits() const {
+		return hits;
+	}
+
+	/// Get the number of reads forwarded to the device.
+	std::uint64_t cache_misses() const {
+		return misses;
+	}
+
+	/// Remove all values from the cache.
+	void clear_cache();
+
+protected:
+	/// Number of addresses in a block of cached values.
+	enum { block_size = 256 };
+
+	/// The cached values of a contiguous range of addresses.
+	struct block {
+		/// The values of the registers, or 0 or 1 for bits.
+		std::array<std::uint16_t, block_size> values;
+
+		/// The time the read of each value was sent to the device, or time_point::min() if the value is not cached.
+		std::array<std::chrono::steady_clock::time_point, block_size> updated;
+
+		block() {
+			updated.fill(std::chrono::steady_clock::time_point::min());
+		}
+	};
+
+	/// The cached values of one table of one unit.
+	struct table {
+		/// The blocks of the table by address / block_size, allocated when a value in the block is first stored.
+		std::array<std::unique_ptr<block>, 0x10000 / block_size> blocks;
+
+		/// Incremented when a range is invalidated, so that replies to older reads are not cached.
+		std::uint64_t generation = 0;
+	};
+
+	/// Cached tables, keyed by unit << 8 | table ID.
+	std::map<std::uint16_t, table> tables;
+
+	/// Mutex to protect the cache.
+	mutable std::mutex mutex;
+
+	/// Number of reads answered from the cache.
+	std::atomic<std::uint64_t> hits{0};
+
+	/// Number of reads forwarded to the device.
+	std::atomic<std::uint64_t> misses{0};
+
+	/// Answer a read from the cache or forward it.
+	template<typename T>
+	void read(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply);
+
+	/// Forward a write and invalidate the written range.
+	template<typename T>
+	void write(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply);
+
+	/// Forward a request that does not touch the cached tables.
+	template<typename T>
+	void pass(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply);
+
+	/// Get the cached values of a range if they are all fresh.
+	/**
+	 * \return True if all values were found.
+	 */
+	bool lookup(std::uint16_t key, std::uint16_t address, std::uint16_t count, std::vector<std::uint16_t> & values);
+
+	/// Get the current generation of a table.
+	std::uint64_t generation(std::uint16_t key);
+
+	/// Store read values, unless the table was invalidated since the read was sent.
+	/**
+	 * The values are considered as old as the time the read was sent,
+	 * since the device may have sampled them any time after that.
+	 */
+	void store(std::uint16_t key, std::uint64_t generation, std::chrono::steady_clock::time_point sent, std::uint16_t address, std::vector<std::uint16_t> const & values);
+
+	/// Remove a range from the cache.
+	void invalidate(std::uint16_t key, std::uint16_t address, std::uint16_t count);
+};
+
+}
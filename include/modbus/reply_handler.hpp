@@ -0,0 +1,160 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "tcp.hpp"
+
+namespace modbus {
+
+/// Type erased handler for the raw reply of a transaction.
+/**
+ * Works like a move-only std::function with the signature of a reply handler,
+ * but stores callables of up to inline_size bytes inside the object itself.
+ * Larger callables, or callables that may throw when moved, are stored on the heap.
+ *
+ * A reply handler that is empty can not be invoked.
+ */
+class reply_handler {
+public:
+	enum : std::size_t {
+		/// Number of bytes available to store a callable without allocating.
+		inline_size = 96,
+	};
+
+	/// Construct an empty handler.
+	reply_handler() noexcept : vtable(nullptr) {}
+
+	/// Construct a handler from a callable.
+	template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, reply_handler>::value>::type>
+	reply_handler(F && callable) : vtable(nullptr) {
+		using stored = typename std::decay<F>::type;
+		storage_type<stored>::create(buffer, std::forward<F>(callable));
+		vtable = &vtable_for<stored>::value;
+	}
+
+	reply_handler(reply_handler const &) = delete;
+	reply_handler & operator= (reply_handler const &) = delete;
+
+	/// Move construct a handler.
+	reply_handler(reply_handler && other) noexcept : vtable(other.vtable) {
+		if (vtable) vtable->move(buffer, other.buffer);
+		other.vtable = nullptr;
+	}
+
+	/// Move assign a handler.
+	reply_handler & operator= (reply_handler && other) noexcept {
+		if (this == &other) return *this;
+		reset();
+		vtable = other.vtable;
+		if (vtable) vtable->move(buffer, other.buffer);
+		other.vtable = nullptr;
+		return *this;
+	}
+
+	~reply_handler() { reset(); }
+
+	/// Destroy the stored callable, if any.
+	void reset() noexcept {
+		if (vtable) vtable->destroy(buffer);
+		vtable = nullptr;
+	}
+
+	/// Check if the handler holds a callable.
+	explicit operator bool() const noexcept { return vtable != nullptr; }
+
+	/// Invoke the handler.
+	/**
+	 * \return Pointer past the data consumed by the handler.
+	 */
+	std::uint8_t const * operator() (std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error) {
+		return vtable->invoke(buffer, start, length, header, error);
+	}
+
+private:
+	using buffer_type = typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type;
+
+	/// Operations on the stored callable.
+	struct vtable_type {
+		std::uint8_t const * (*invoke)(buffer_type & buffer, std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error);
+		void (*move)(buffer_type & target, buffer_type & source) noexcept;
+		void (*destroy)(buffer_type & buffer) noexcept;
+	};
+
+	/// Storage of a callable inside the buffer.
+	template<typename F, bool Inline = sizeof(F) <= inline_size && alignof(F) <= alignof(buffer_type) && std::is_nothrow_move_constructible<F>::value>
+	struct storage_type {
+		template<typename G>
+		static void create(buffer_type & buffer, G && callable) { new (&buffer) F(std::forward<G>(callable)); }
+		static F & get(buffer_type & buffer) noexcept { return *reinterpret_cast<F *>(&buffer); }
+		static void move(buffer_type & target, buffer_type & source) noexcept {
+			new (&target) F(std::move(get(source)));
+			get(source).~F();
+		}
+		static void destroy(buffer_type & buffer) noexcept { get(buffer).~F(); }
+	};
+
+	/// Storage of a callable on the heap, with the pointer inside the buffer.
+	template<typename F>
+	struct storage_type<F, false> {
+		template<typename G>
+		static void create(buffer_type & buffer, G && callable) { new (&buffer) F *(new F(std::forward<G>(callable))); }
+		static F & get(buffer_type & buffer) noexcept { return **reinterpret_cast<F **>(&buffer); }
+		static void move(buffer_type & target, buffer_type & source) noexcept { new (&target) F *(&get(source)); }
+		static void destroy(buffer_type & buffer) noexcept { delete &get(buffer); }
+	};
+
+	/// The operations for a callable type.
+	template<typename F>
+	struct vtable_for {
+		static std::uint8_t const * invoke(buffer_type & buffer, std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error) {
+			return storage_type<F>::get(buffer)(start, length, header, error);
+		}
+
+		static vtable_type const value;
+	};
+
+	/// Storage for the callable.
+	buffer_type buffer;
+
+	/// The operations for the stored callable, or null if the handler is empty.
+	vtable_type const * vtable;
+};
+
+template<typename F>
+reply_handler::vtable_type const reply_handler::vtable_for<F>::value = {
+	&reply_handler::vtable_for<F>::invoke,
+	&reply_handler::storage_type<F>::move,
+	&reply_handler::storage_type<F>::destroy,
+};
+
+}
@@ -26,6 +26,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "bit_vector.hpp"
+#include "file_record.hpp"
 #include "functions.hpp"
 
 namespace modbus {
@@ -40,6 +42,10 @@ namespace response {
 	struct write_multiple_coils;
 	struct write_multiple_registers;
 	struct mask_write_register;
+	struct read_write_multiple_registers;
+	struct read_file_record;
+	struct write_file_record;
+	struct read_fifo_queue;
 }
 
 namespace request {
@@ -176,7 +182,7 @@ namespace request {
 		std::uint16_t address;
 
 		/// The values to write.
-		std::vector<bool> values;
+		bit_vector values;
 
 		/// The length of the serialized ADU in bytes.
 		std::size_t length() const {
@@ -227,4 +233,86 @@ namespace request {
 		}
 	};
 
+	/// Message representing a read_write_multiple_registers request.
+	/**
+	 * The server performs the write before the read.
+	 */
+	struct read_write_multiple_registers {
+		/// Response type.
+		using response = response::read_write_multiple_registers;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_write_multiple_registers;
+
+		/// The address of the first register to read from.
+		std::uint16_t read_address;
+
+		/// The number of registers to read.
+		std::uint16_t read_count;
+
+		/// The address of the first register to write to.
+		std::uint16_t write_address;
+
+		/// The values to write.
+		std::vector<std::uint16_t> values;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 10 + values.size() * 2;
+		}
+	};
+
+	/// Message representing a read_file_record request.
+	struct read_file_record {
+		/// Response type.
+		using response = response::read_file_record;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_file_record;
+
+		/// The records to read.
+		std::vector<file_record_reference> records;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 2 + records.size() * 7;
+		}
+	};
+
+	/// Message representing a write_file_record request.
+	struct write_file_record {
+		/// Response type.
+		using response = response::write_file_record;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::write_file_record;
+
+		/// The records to write.
+		std::vector<file_record> records;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			std::size_t result = 2;
+			for (file_record const & record : records) result += 7 + record.values.size() * 2;
+			return result;
+		}
+	};
+
+	/// Message representing a read_fifo_queue request.
+	struct read_fifo_queue {
+		/// Response type.
+		using response = response::read_fifo_queue;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_fifo_record;
+
+		/// The address of the FIFO pointer register.
+		std::uint16_t address;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 3;
+		}
+	};
+
 }}
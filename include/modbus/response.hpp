@@ -26,7 +26,10 @@
 #include <cstdint>
 #include <vector>
 
+#include "bit_vector.hpp"
+#include "file_record.hpp"
 #include "functions.hpp"
+#include "word_view.hpp"
 
 namespace modbus {
 
@@ -40,6 +43,10 @@ namespace request {
 	struct write_multiple_coils;
 	struct write_multiple_registers;
 	struct mask_write_register;
+	struct read_write_multiple_registers;
+	struct read_file_record;
+	struct write_file_record;
+	struct read_fifo_queue;
 }
 
 namespace response {
@@ -53,7 +60,7 @@ namespace response {
 		static constexpr std::uint8_t function = functions::read_coils;
 
 		/// The read values.
-		std::vector<bool> values;
+		bit_vector values;
 
 		/// The length of the serialized ADU in bytes.
 		std::size_t length() const {
@@ -70,7 +77,7 @@ namespace response {
 		static constexpr std::uint8_t function = functions::read_discrete_inputs;
 
 		/// The read values.
-		std::vector<bool> values;
+		bit_vector values;
 
 		/// The length of the serialized ADU in bytes.
 		std::size_t length() const {
@@ -112,6 +119,48 @@ namespace response {
 		}
 	};
 
+	/// View of a read_holding_registers response.
+	/**
+	 * The values refer to the data in the receive buffer of the client.
+	 * They are only valid for the duration of the callback that receives the response.
+	 */
+	struct read_holding_registers_view {
+		/// Request type.
+		using request = request::read_holding_registers;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_holding_registers;
+
+		/// The read values.
+		word_view values;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 2 + values.size() * 2;
+		}
+	};
+
+	/// View of a read_input_registers response.
+	/**
+	 * The values refer to the data in the receive buffer of the client.
+	 * They are only valid for the duration of the callback that receives the response.
+	 */
+	struct read_input_registers_view {
+		/// Request type.
+		using request = request::read_input_registers;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_input_registers;
+
+		/// The read values.
+		word_view values;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 2 + values.size() * 2;
+		}
+	};
+
 	/// Message representing a write_single_coil response.
 	struct write_single_coil {
 		/// Request type.
@@ -215,4 +264,79 @@ namespace response {
 		}
 	};
 
+	/// Message representing a read_write_multiple_registers response.
+	struct read_write_multiple_registers {
+		/// Request type.
+		using request = request::read_write_multiple_registers;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_write_multiple_registers;
+
+		/// The read values.
+		std::vector<std::uint16_t> values;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 2 + values.size() * 2;
+		}
+	};
+
+	/// Message representing a read_file_record response.
+	struct read_file_record {
+		/// Request type.
+		using request = request::read_file_record;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_file_record;
+
+		/// The values of the read records, in the order of the requested records.
+		std::vector<std::vector<std::uint16_t>> records;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			std::size_t result = 2;
+			for (std::vector<std::uint16_t> const & values : records) result += 2 + values.size() * 2;
+			return result;
+		}
+	};
+
+	/// Message representing a write_file_record response.
+	/**
+	 * The response is an echo of the request.
+	 */
+	struct write_file_record {
+		/// Request type.
+		using request = request::write_file_record;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::write_file_record;
+
+		/// The written records.
+		std::vector<file_record> records;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			std::size_t result = 2;
+			for (file_record const & record : records) result += 7 + record.values.size() * 2;
+			return result;
+		}
+	};
+
+	/// Message representing a read_fifo_queue response.
+	struct read_fifo_queue {
+		/// Request type.
+		using request = request::read_fifo_queue;
+
+		/// The function code.
+		static constexpr std::uint8_t function = functions::read_fifo_record;
+
+		/// The values in the queue, starting with the oldest value.
+		std::vector<std::uint16_t> values;
+
+		/// The length of the serialized ADU in bytes.
+		std::size_t length() const {
+			return 5 + values.size() * 2;
+		}
+	};
+
 }}
@@ -0,0 +1,408 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <asio/io_context.hpp>
+#include <asio/serial_port.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+
+#include "client.hpp"
+
+namespace modbus {
+
+/// A Modbus RTU client on a serial line.
+/**
+ * The client is the single master on the bus: requests are queued and sent one at a time,
+ * and the next request is sent when the reply to the previous one arrived or timed out.
+ *
+ * Frames are separated by the 3.5 character silence (t3.5) required by the specification,
+ * computed from the baud rate, or fixed at 1750 us above 19200 baud.
+ * The silence is measured from the last byte on the bus: the end of the request is estimated
+ * from the time it was written and its transmission time, and the end of a reply is the time it was read.
+ * If the reply was handled slower than t3.5, the next request is sent right away without waiting.
+ *
+ * Requests and replies use the same codecs as the TCP client, and callbacks have the same signature.
+ * The MBAP header passed to a callback is synthesized from the RTU frame: it holds the unit ID and length,
+ * and the transaction ID is always zero.
+ * Replies are framed by function code and byte count, and checked with the CRC.
+ *
+ * Requests to unit 0 are broadcasts. Servers do not reply to them,
+ * so the callback of a broadcast write is invoked once the request is written,
+ * with the response a server would have sent. Broadcast reads fail with an invalid_value error.
+ *
+ * The threading model is the same as for the TCP client: all state is owned by a strand,
+ * public functions may be called from any thread and callbacks are invoked from the strand.
+ */
+class rtu_client {
+public:
+	/// Callback type.
+	template<typename T>
+	using Callback = client::Callback<T>;
+
+	/// Settings of the serial line.
+	struct serial_settings {
+		/// The baud rate.
+		unsigned int baud_rate = 19200;
+
+		/// The parity, even by default as required by the Modbus specification.
+		asio::serial_port_base::parity::type parity = asio::serial_port_base::parity::even;
+
+		/// The number of stop bits.
+		/**
+		 * The specification requires two stop bits when parity is disabled.
+		 */
+		asio::serial_port_base::stop_bits::type stop_bits = asio::serial_port_base::stop_bits::one;
+	};
+
+	/// Callback to invoke for IO errors on the serial port.
+	/**
+	 * The port is closed and every transaction callback is invoked with the error.
+	 */
+	std::function<void (std::error_code const &)> on_io_error;
+
+	/// Value for the timeout of a request to use the default timeout of the client.
+	static std::chrono::milliseconds const use_default_timeout;
+
+	/// The default timeout for requests.
+	/**
+	 * A reply that does not arrive before the timeout fails with a transaction_timeout error.
+	 * The timeout starts when the request is sent, not when it is queued.
+	 *
+	 * A timeout of zero means requests never time out, which blocks the bus if a server does not reply.
+	 */
+	std::chrono::milliseconds default_timeout{1000};
+
+	/// The delay after a broadcast before the next request is sent.
+	/**
+	 * Servers do not reply to broadcasts, so they need time to process them before the next request.
+	 * The delay starts when the broadcast has been transmitted, and is at least t3.5.
+	 */
+	std::chrono::milliseconds broadcast_delay{100};
+
+	/// If true, a reply with a silence of more than 1.5 characters (t1.5) between two bytes is discarded.
+	/**
+	 * The reply fails with a message_size_mismatch error.
+	 * Disabled by default, since many USB serial adapters deliver received bytes in bursts,
+	 * which looks like gaps within a frame to the client.
+	 */
+	bool check_inter_character_timeout = false;
+
+protected:
+	/// Low level message handler.
+	using Handler = reply_handler;
+
+	/// A queued request.
+	struct transaction_t {
+		/// The unit identifier of the request.
+		std::uint8_t unit;
+
+		/// The function code of the request.
+		std::uint8_t function;
+
+		/// The size of the serialized request in frame, or 0 if the request is too large for a frame.
+		std::size_t size;
+
+		/// The serialized request, including unit ID and CRC.
+		std::array<std::uint8_t, 256> frame;
+
+		/// The handler for the reply.
+		Handler handler;
+
+		/// The timeout for the request.
+		std::chrono::milliseconds timeout;
+	};
+
+	/// Strand that owns all state of the client.
+	asio::strand<asio::io_context::executor_type> strand;
+
+	/// The serial port.
+	asio::serial_port port;
+
+	/// Timer for the reply timeout of the current transaction.
+	asio::steady_timer timeout_timer;
+
+	/// Timer to wait for the silence between frames.
+	asio::steady_timer gap_timer;
+
+	/// True while gap_timer is waiting.
+	bool waiting_gap = false;
+
+	/// Time to transmit one character.
+	std::chrono::nanoseconds character_time{0};
+
+	/// Maximum silence between two characters of a frame (t1.5).
+	std::chrono::nanoseconds inter_character_time{0};
+
+	/// Minimum silence between two frames (t3.5).
+	std::chrono::nanoseconds frame_gap{0};
+
+	/// The earliest time the next request may be sent.
+	std::chrono::steady_clock::time_point bus_idle;
+
+	/// The time the current request was passed to the serial port.
+	std::chrono::steady_clock::time_point write_start;
+
+	/// The time the last bytes were received.
+	std::chrono::steady_clock::time_point last_read;
+
+	/// Queued transactions, the front one is current while busy is set.
+	std::deque<transaction_t> queue;
+
+	/// True while the front transaction of the queue has been sent and waits for its reply.
+	bool busy = false;
+
+	/// Incremented for every finished transaction, to recognize stale timer and write handlers.
+	std::uint64_t transaction_id = 0;
+
+	/// Buffer for the reply to the current transaction.
+	std::array<std::uint8_t, 256> read_buffer;
+
+	/// Number of bytes in read_buffer.
+	std::size_t read_size = 0;
+
+	/// True if the port is open, readable from any thread.
+	std::atomic<bool> _open{false};
+
+public:
+	/// Construct a client.
+	rtu_client(
+		asio::io_context & io_context ///< The IO context to use.
+	);
+
+	/// Get the IO executor used by the client.
+	asio::serial_port::executor_type io_executor() { return port.get_executor(); };
+
+	/// Open a serial port.
+	/**
+	 * \return The error that occured while opening or configuring the port, if any.
+	 */
+	std::error_code open(
+		std::string const & device,      ///< The serial device, such as /dev/ttyUSB0.
+		serial_settings const & settings ///< The settings of the serial line.
+	);
+
+	/// Open a serial port at 19200 baud with even parity.
+	/**
+	 * \return The error that occured while opening or configuring the port, if any.
+	 */
+	std::error_code open(
+		std::string const & device ///< The serial device, such as /dev/ttyUSB0.
+	) {
+		return open(device, serial_settings());
+	}
+
+	/// Close the serial port.
+	/**
+	 * Any remaining transaction callbacks will be invoked with an operation_aborted error.
+	 *
+	 * When called from outside the strand, the port is closed asynchronously.
+	 */
+	void close();
+
+	/// Check if the serial port is open.
+	bool is_open() const {
+		return _open;
+	}
+
+	/// Read a number of coils from a server.
+	void read_coils(
+		std::uint8_t unit,                                              ///< The unit ID of the server.
+		std::uint16_t address,                                          ///< The address of the first coil to read.
+		std::uint16_t count,                                            ///< The number of coils to read.
+		Callback<response::read_coils> const & callback,                ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of discrete inputs from a server.
+	void read_discrete_inputs(
+		std::uint8_t unit,                                              ///< The unit ID of the server.
+		std::uint16_t address,                                          ///< The address of the first input to read.
+		std::uint16_t count,                                            ///< The number of inputs to read.
+		Callback<response::read_discrete_inputs> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of holding registers from a server.
+	void read_holding_registers(
+		std::uint8_t unit,                                              ///< The unit ID of the server.
+		std::uint16_t address,                                          ///< The address of the first register to read.
+		std::uint16_t count,                                            ///< The number of registers to read.
+		Callback<response::read_holding_registers> const & callback,    ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of input registers from a server.
+	void read_input_registers(
+		std::uint8_t unit,                                              ///< The unit ID of the server.
+		std::uint16_t address,                                          ///< The address of the first register to read.
+		std::uint16_t count,                                            ///< The number of registers to read.
+		Callback<response::read_input_registers> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to a single coil on a server.
+	void write_single_coil(
+		std::uint8_t unit,                                              ///< The unit ID of the server, or 0 to broadcast.
+		std::uint16_t address,                                          ///< The address of the coil.
+		bool value,                                                     ///< The value to write.
+		Callback<response::write_single_coil> const & callback,         ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to a single register on a server.
+	void write_single_register(
+		std::uint8_t unit,                                              ///< The unit ID of the server, or 0 to broadcast.
+		std::uint16_t address,                                          ///< The address of the register.
+		std::uint16_t value,                                            ///< The value to write.
+		Callback<response::write_single_register> const & callback,     ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to a number of coils on a server.
+	void write_multiple_coils(
+		std::uint8_t unit,                                              ///< The unit ID of the server, or 0 to broadcast.
+		std::uint16_t address,                                          ///< The address of the first coil to write.
+		bit_vector values,                                              ///< The values to write.
+		Callback<response::write_multiple_coils> const & callback,      ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to a number of registers on a server.
+	void write_multiple_registers(
+		std::uint8_t unit,                                              ///< The unit ID of the server, or 0 to broadcast.
+		std::uint16_t address,                                          ///< The address of the first register to write.
+		std::vector<std::uint16_t> values,                              ///< The values to write.
+		Callback<response::write_multiple_registers> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout         ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Perform a masked write to a register on a server.
+	void mask_write_register(
+		std::uint8_t unit,                                         ///< The unit ID of the server, or 0 to broadcast.
+		std::uint16_t address,                                     ///< The address of the register.
+		std::uint16_t and_mask,                                    ///< The AND mask to apply.
+		std::uint16_t or_mask,                                     ///< The OR mask to apply.
+		Callback<response::mask_write_register> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout    ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write to and then read from a number of registers on a server in one transaction.
+	/**
+	 * The request can not be broadcast.
+	 */
+	void read_write_multiple_registers(
+		std::uint8_t unit,                                                   ///< The unit ID of the server.
+		std::uint16_t read_address,                                          ///< The address of the first register to read.
+		std::uint16_t read_count,                                            ///< The number of registers to read.
+		std::uint16_t write_address,                                         ///< The address of the first register to write.
+		std::vector<std::uint16_t> values,                                   ///< The values to write.
+		Callback<response::read_write_multiple_registers> const & callback,  ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout              ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read a number of file records from a server.
+	/**
+	 * The request can not be broadcast.
+	 */
+	void read_file_record(
+		std::uint8_t unit,                                        ///< The unit ID of the server.
+		std::vector<file_record_reference> records,               ///< The records to read.
+		Callback<response::read_file_record> const & callback,    ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Write a number of file records on a server.
+	void write_file_record(
+		std::uint8_t unit,                                        ///< The unit ID of the server, or 0 to broadcast.
+		std::vector<file_record> records,                         ///< The records to write.
+		Callback<response::write_file_record> const & callback,   ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Read the contents of a FIFO queue from a server.
+	/**
+	 * The request can not be broadcast.
+	 */
+	void read_fifo_queue(
+		std::uint8_t unit,                                        ///< The unit ID of the server.
+		std::uint16_t address,                                    ///< The address of the FIFO pointer register.
+		Callback<response::read_fifo_queue> const & callback,     ///< The callback to invoke when the reply or error arrives.
+		std::chrono::milliseconds timeout = use_default_timeout   ///< The timeout for the request, or use_default_timeout.
+	);
+
+protected:
+	/// Serialize a request and queue it.
+	template<typename T>
+	void send_message(
+		std::uint8_t unit,                ///< The unit ID of the server.
+		T const & request,                ///< The request.
+		Handler handler,                  ///< The handler to invoke when the reply arrives.
+		std::chrono::milliseconds timeout ///< The timeout for the request, or use_default_timeout.
+	);
+
+	/// Add a transaction to the queue and send it if the bus is idle.
+	void queue_transaction(transaction_t & transaction);
+
+	/// Send the next queued transaction if the bus is idle.
+	void start_next();
+
+	/// Finish the current transaction and invoke its handler.
+	void finish_transaction(std::uint8_t const * pdu, std::size_t length, std::error_code const & error);
+
+	/// Close the serial port and abort all transactions with an error.
+	void close_(std::error_code const & error);
+
+	/// Start a read operation.
+	void start_read();
+
+	/// Called when the serial port finished a read operation.
+	void on_read(std::error_code const & error, std::size_t bytes_transferred);
+
+	/// Called when the serial port finished writing a request.
+	void on_write(std::error_code const & error, std::uint64_t id);
+
+	/// Called when the silence between frames has passed.
+	void on_gap(std::error_code const & error);
+
+	/// Called when the reply timeout expires.
+	void on_timeout(std::error_code const & error, std::uint64_t id);
+
+	/// Try to frame the reply to the current transaction from the read buffer.
+	void process_reply();
+};
+
+}
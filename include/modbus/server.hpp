@@ -0,0 +1,242 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <system_error>
+
+#include <asio/io_context.hpp>
+#include <asio/strand.hpp>
+#include <asio/ip/tcp.hpp>
+
+#include "capture.hpp"
+#include "functions.hpp"
+#include "tcp.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+namespace modbus {
+
+/// A Modbus server accepting connections from Modbus/TCP clients.
+/**
+ * The server accepts any number of concurrent connections.
+ * Each connection has its own strand, so different connections are served in parallel
+ * when the IO context is run by multiple threads.
+ *
+ * Requests are dispatched to the user handler registered for their function code.
+ * Requests for function codes without a handler are answered with an illegal_function exception.
+ * Clients may pipeline requests: all complete requests in the read buffer are dispatched at once,
+ * and the replies are flushed in a single write when possible.
+ * Replies may be sent in any order, since Modbus/TCP matches them to requests by transaction ID.
+ *
+ * Handlers should be set before listen() is called and not be modified afterwards.
+ * The server must outlive all handlers queued on the IO context.
+ */
+class server {
+protected:
+	class connection;
+
+public:
+	typedef asio::ip::tcp tcp;
+
+	/// Object used by a request handler to send the reply to a request.
+	/**
+	 * The reply object may be copied, stored and invoked later from any thread.
+	 * It must be invoked exactly once.
+	 */
+	template<typename T>
+	class reply {
+	public:
+		/// Construct a reply object for a request on a connection.
+		reply(std::shared_ptr<connection> connection, tcp_mbap const & header) : _connection(std::move(connection)), _header(header) {}
+
+		/// Send the response to the client.
+		/**
+		 * If an error is given, an exception response is sent instead.
+		 * Errors in the Modbus category with a standard exception code are sent as-is,
+		 * any other error is sent as server_device_failure.
+		 */
+		void operator() (T const & response, std::error_code const & error = {}) const;
+
+		/// Send an exception response to the client.
+		void operator() (std::error_code const & error) const {
+			(*this)(T{}, error);
+		}
+
+		/// Get the MBAP header of the request.
+		tcp_mbap const & header() const {
+			return _header;
+		}
+
+		/// Get the ID of the connection the request arrived on.
+		/**
+		 * Only meant to tell connections apart, for example to schedule requests fairly per client.
+		 * Connection IDs are assigned in increasing order and are never reused by the same server.
+		 */
+		std::uint64_t connection_id() const;
+
+	private:
+		std::shared_ptr<connection> _connection;
+		tcp_mbap _header;
+	};
+
+	/// Request handler type.
+	template<typename T>
+	using Handler = std::function<void (tcp_mbap const & header, T const & request, reply<typename T::response> const & reply)>;
+
+	/// Handler for read_coils requests.
+	Handler<request::read_coils> on_read_coils;
+
+	/// Handler for read_discrete_inputs requests.
+	Handler<request::read_discrete_inputs> on_read_discrete_inputs;
+
+	/// Handler for read_holding_registers requests.
+	Handler<request::read_holding_registers> on_read_holding_registers;
+
+	/// Handler for read_input_registers requests.
+	Handler<request::read_input_registers> on_read_input_registers;
+
+	/// Handler for write_single_coil requests.
+	Handler<request::write_single_coil> on_write_single_coil;
+
+	/// Handler for write_single_register requests.
+	Handler<request::write_single_register> on_write_single_register;
+
+	/// Handler for write_multiple_coils requests.
+	Handler<request::write_multiple_coils> on_write_multiple_coils;
+
+	/// Handler for write_multiple_registers requests.
+	Handler<request::write_multiple_registers> on_write_multiple_registers;
+
+	/// Handler for mask_write_register requests.
+	Handler<request::mask_write_register> on_mask_write_register;
+
+	/// Handler for read_write_multiple_registers requests.
+	Handler<request::read_write_multiple_registers> on_read_write_multiple_registers;
+
+	/// Handler for read_file_record requests.
+	Handler<request::read_file_record> on_read_file_record;
+
+	/// Handler for write_file_record requests.
+	Handler<request::write_file_record> on_write_file_record;
+
+	/// Handler for read_fifo_queue requests.
+	Handler<request::read_fifo_queue> on_read_fifo_queue;
+
+	/// Callback to invoke for IO errors on the acceptor or on a connection.
+	/**
+	 * A connection with an IO error is closed. The server keeps accepting new connections.
+	 * Regular disconnects by the client are not reported.
+	 */
+	std::function<void (std::error_code const &)> on_io_error;
+
+	/// Callback to invoke when a connection is closed.
+	/**
+	 * Invoked exactly once per connection with the ID returned by reply::connection_id(),
+	 * both for disconnects by the client and for connections closed by the server.
+	 */
+	std::function<void (std::uint64_t connection)> on_disconnect;
+
+	/// If set, the server records every frame it receives and sends in this capture file.
+	/**
+	 * Responses are recorded when they are queued for writing.
+	 * The capture file may be shared with other clients and servers.
+	 * It should be set before listen() is called and not be modified afterwards.
+	 */
+	std::shared_ptr<capture_file> capture;
+
+protected:
+	/// Strand to use to prevent concurrent access to the acceptor and the connection set.
+	asio::strand<asio::io_context::executor_type> strand;
+
+	/// The acceptor to use.
+	tcp::acceptor acceptor;
+
+	/// The currently open connections.
+	std::set<std::shared_ptr<connection>> connections;
+
+	/// The ID to give to the next accepted connection.
+	std::uint64_t next_connection_id = 0;
+
+public:
+	/// Construct a server.
+	server(
+		asio::io_context & io_context ///< The IO context to use.
+	);
+
+	/// Get the IO executor used by the server.
+	tcp::acceptor::executor_type io_executor() { return acceptor.get_executor(); };
+
+	/// Start listening for connections on an endpoint.
+	/**
+	 * \return The error that occured while opening the acceptor, if any.
+	 */
+	std::error_code listen(
+		tcp::endpoint const & endpoint ///< The endpoint to listen on.
+	);
+
+	/// Start listening for connections on all interfaces at the given port.
+	/**
+	 * \return The error that occured while opening the acceptor, if any.
+	 */
+	std::error_code listen(
+		std::uint16_t port = 502 ///< The port to listen on.
+	) {
+		return listen(tcp::endpoint(tcp::v4(), port));
+	}
+
+	/// Get the local endpoint the server is listening on.
+	/**
+	 * Useful to find out the port the server is listening on after listening on port 0.
+	 */
+	tcp::endpoint local_endpoint() const {
+		std::error_code error;
+		return acceptor.local_endpoint(error);
+	}
+
+	/// Stop accepting connections and close all open connections.
+	void close();
+
+protected:
+	/// Start an asynchronous accept operation.
+	void accept();
+
+	/// Called when the acceptor accepted a connection.
+	void on_accept(
+		std::error_code const & error,          ///<[in] The error that occured, if any.
+		std::shared_ptr<connection> connection  ///<[in] The connection that was accepted.
+	);
+
+	/// Remove a closed connection from the connection set.
+	void remove(
+		std::shared_ptr<connection> const & connection ///<[in] The connection to remove.
+	);
+};
+
+}
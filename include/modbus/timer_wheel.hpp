@@ -0,0 +1,235 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace modbus {
+
+/// Hierarchical timer wheel for a fixed number of timers.
+/**
+ * Timers are identified by an index in the range [0, capacity).
+ * Scheduling and cancelling a timer are O(1), and advancing the wheel by one tick
+ * costs O(1) plus the work for the timers that expire or move to a lower level.
+ *
+ * The wheel has four levels of 64 buckets each.
+ * Level N holds timers that expire within 64^(N+1) ticks.
+ * Timers further in the future are placed in the last level and rescheduled when they come up.
+ *
+ * The wheel does not keep track of time itself. The owner advances it to the current tick.
+ */
+class timer_wheel {
+public:
+	/// Number of bits of the tick used per level.
+	static constexpr int level_bits = 6;
+
+	/// Number of buckets per level.
+	static constexpr std::size_t level_size = std::size_t(1) << level_bits;
+
+	/// Number of levels.
+	static constexpr int levels = 4;
+
+protected:
+	/// Marker for the end of a list or an unused bucket index.
+	enum : std::uint32_t { none = 0xffffffff };
+
+	/// A timer in the wheel.
+	struct node {
+		/// The tick at which the timer expires.
+		std::uint64_t deadline = 0;
+
+		/// The next timer in the bucket.
+		std::uint32_t next = none;
+
+		/// The previous timer in the bucket.
+		std::uint32_t prev = none;
+
+		/// The bucket the timer is in, or none if the timer is not scheduled.
+		std::uint32_t bucket = none;
+	};
+
+	/// The timers.
+	std::vector<node> nodes;
+
+	/// The first timer of each bucket.
+	std::vector<std::uint32_t> buckets;
+
+	/// The current tick.
+	std::uint64_t current = 0;
+
+	/// The number of scheduled timers.
+	std::size_t count = 0;
+
+public:
+	/// Construct a timer wheel.
+	explicit timer_wheel(
+		std::size_t capacity ///< The number of timers.
+	) : nodes(capacity), buckets(levels * level_size, std::uint32_t(none)) {}
+
+	/// Get the current tick.
+	std::uint64_t now() const {
+		return current;
+	}
+
+	/// Get the number of scheduled timers.
+	std::size_t size() const {
+		return count;
+	}
+
+	/// Check if no timers are scheduled.
+	bool empty() const {
+		return count == 0;
+	}
+
+	/// Check if a timer is scheduled.
+	bool scheduled(std::size_t id) const {
+		return nodes[id].bucket != none;
+	}
+
+	/// Schedule a timer to expire at the given tick.
+	/**
+	 * If the timer was already scheduled, it is rescheduled.
+	 * A deadline in the past expires on the next tick.
+	 */
+	void schedule(std::size_t id, std::uint64_t deadline) {
+		cancel(id);
+		nodes[id].deadline = deadline;
+
+		// The bucket for the current tick has already been processed.
+		insert(id, current + 1);
+		++count;
+	}
+
+	/// Cancel a timer.
+	/**
+	 * Does nothing if the timer is not scheduled.
+	 */
+	void cancel(std::size_t id) {
+		if (nodes[id].bucket == none) return;
+		unlink(id);
+		--count;
+	}
+
+	/// Advance the wheel to the given tick.
+	/**
+	 * Calls expire(id) for every timer that expired.
+	 * The expire callback may schedule and cancel timers.
+	 */
+	template<typename F>
+	void advance(std::uint64_t tick, F && expire) {
+		// Without scheduled timers, there is nothing to process on the way.
+		if (count == 0 && tick > current) current = tick;
+
+		while (current < tick) {
+			++current;
+
+			// Move timers from higher levels down when their bucket comes up.
+			for (int level = levels - 1; level > 0; --level) {
+				if (current & ((std::uint64_t(1) << (level * level_bits)) - 1)) continue;
+				cascade(level * level_size + (current >> (level * level_bits) & (level_size - 1)));
+			}
+
+			// Expire timers in the current bucket of the first level.
+			std::uint32_t & bucket = buckets[current & (level_size - 1)];
+			while (bucket != none) {
+				std::uint32_t id = bucket;
+				unlink(id);
+				--count;
+				expire(std::size_t(id));
+			}
+
+			if (count == 0) current = tick;
+		}
+	}
+
+	/// Get the next tick at which advance() may have work to do.
+	/**
+	 * The returned tick is never later than the first deadline,
+	 * but it may be earlier if timers need to move to a lower level first.
+	 *
+	 * Should only be called if the wheel is not empty.
+	 */
+	std::uint64_t next_tick() const {
+		// Look for the first non-empty bucket in the first level, up to the next cascade.
+		std::uint64_t boundary = (current | (level_size - 1)) + 1;
+		for (std::uint64_t tick = current + 1; tick < boundary; ++tick) {
+			if (buckets[tick & (level_size - 1)] != none) return tick;
+		}
+		return boundary;
+	}
+
+protected:
+	/// Insert a timer in the right bucket based on its deadline.
+	/**
+	 * Deadlines before the given earliest tick are treated as expiring at the earliest tick.
+	 */
+	void insert(std::uint32_t id, std::uint64_t earliest) {
+		node & timer = nodes[id];
+		std::uint64_t deadline = timer.deadline > earliest ? timer.deadline : earliest;
+		std::uint64_t delta    = deadline - current;
+
+		int level = 0;
+		while (level < levels - 1 && delta >= std::uint64_t(1) << ((level + 1) * level_bits)) ++level;
+
+		// Deadlines beyond the last level are clamped, and rescheduled when they come up.
+		if (delta >= std::uint64_t(1) << (levels * level_bits)) deadline = current + (std::uint64_t(1) << (levels * level_bits)) - 1;
+
+		std::uint32_t bucket = level * level_size + (deadline >> (level * level_bits) & (level_size - 1));
+		timer.bucket = bucket;
+		timer.prev   = none;
+		timer.next   = buckets[bucket];
+		if (timer.next != none) nodes[timer.next].prev = id;
+		buckets[bucket] = id;
+	}
+
+	/// Remove a timer from its bucket.
+	void unlink(std::uint32_t id) {
+		node & timer = nodes[id];
+		if (timer.prev != none) nodes[timer.prev].next = timer.next;
+		else buckets[timer.bucket] = timer.next;
+		if (timer.next != none) nodes[timer.next].prev = timer.prev;
+		timer.next   = none;
+		timer.prev   = none;
+		timer.bucket = none;
+	}
+
+	/// Move all timers from a bucket to the buckets matching their remaining time.
+	void cascade(std::uint32_t bucket) {
+		std::uint32_t id = buckets[bucket];
+		buckets[bucket] = none;
+		while (id != none) {
+			std::uint32_t next = nodes[id].next;
+			nodes[id].bucket = none;
+
+			// Cascading happens before the bucket for the current tick is processed.
+			insert(id, current);
+			id = next;
+		}
+	}
+};
+
+}
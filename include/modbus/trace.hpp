@@ -0,0 +1,170 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace modbus {
+
+/// Timestamps of the life cycle of one transaction.
+/**
+ * All timestamps are taken from std::chrono::steady_clock.
+ * The differences between consecutive timestamps attribute the round trip time to:
+ *  - queueing in the client: enqueued to serialized, and serialized to written,
+ *  - the network, the kernel and the device: written to received,
+ *  - reading the rest of the reply: received to parsed,
+ *  - deserializing the reply and running the callback: parsed to completed.
+ */
+struct transaction_trace {
+	using time_point = std::chrono::steady_clock::time_point;
+
+	/// The transaction ID of the request.
+	std::uint16_t transaction;
+
+	/// The unit identifier of the request.
+	std::uint8_t unit;
+
+	/// The function code of the request.
+	std::uint8_t function;
+
+	/// The time the request was passed to the client.
+	time_point enqueued;
+
+	/// The time the request was serialized into its frame buffer.
+	time_point serialized;
+
+	/// The time the write operation that carried the last byte of the request completed.
+	time_point written;
+
+	/// The time the read operation that carried the first byte of the reply completed.
+	time_point received;
+
+	/// The time the MBAP header of the complete reply was parsed.
+	time_point parsed;
+
+	/// The time the reply handler returned, after the user callback.
+	time_point completed;
+};
+
+/// Lock-free ring buffer of transaction traces with a single producer and a single consumer.
+/**
+ * The client is the producer: it pushes a trace from its strand for every transaction that received a reply.
+ * The application is the consumer: it drains the ring from any one thread at a time.
+ * A ring must not be shared by more than one client.
+ *
+ * If the ring is full, new traces are dropped and counted.
+ */
+class trace_ring {
+public:
+	/// Construct a ring that holds at least the given number of traces.
+	/**
+	 * The capacity is rounded up to a power of two.
+	 */
+	explicit trace_ring(std::size_t capacity) {
+		std::size_t size = 1;
+		while (size < capacity) size *= 2;
+		records.reset(new transaction_trace[size]);
+		mask = size - 1;
+	}
+
+	trace_ring(trace_ring const &) = delete;
+	trace_ring & operator= (trace_ring const &) = delete;
+
+	/// Get the maximum number of traces in the ring.
+	std::size_t capacity() const { return mask + 1; }
+
+	/// Get the number of traces dropped because the ring was full.
+	std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+	/// Push a trace, only called by the producer.
+	/**
+	 * \return False if the ring was full and the trace was dropped.
+	 */
+	bool push(transaction_trace const & trace) {
+		std::size_t head = head_.load(std::memory_order_relaxed);
+		if (head - tail_.load(std::memory_order_acquire) > mask) {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		records[head & mask] = trace;
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Pop the oldest trace, only called by the consumer.
+	/**
+	 * \return False if the ring was empty.
+	 */
+	bool pop(transaction_trace & trace) {
+		std::size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail == head_.load(std::memory_order_acquire)) return false;
+		trace = records[tail & mask];
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Pass all traces in the ring to a function, oldest first, only called by the consumer.
+	/**
+	 * \return The number of traces drained.
+	 */
+	template<typename F>
+	std::size_t drain(F && function) {
+		std::size_t tail = tail_.load(std::memory_order_relaxed);
+		std::size_t head = head_.load(std::memory_order_acquire);
+		for (std::size_t i = tail; i != head; ++i) function(static_cast<transaction_trace const &>(records[i & mask]));
+		tail_.store(head, std::memory_order_release);
+		return head - tail;
+	}
+
+private:
+	/// The traces.
+	std::unique_ptr<transaction_trace[]> records;
+
+	/// The capacity minus one, used to wrap indices.
+	std::size_t mask;
+
+	/// Padding to keep the producer and consumer indices on separate cache lines.
+	char padding0[64];
+
+	/// The index of the next trace to push, written by the producer.
+	std::atomic<std::size_t> head_{0};
+
+	char padding1[64];
+
+	/// The index of the next trace to pop, written by the consumer.
+	std::atomic<std::size_t> tail_{0};
+
+	char padding2[64];
+
+	/// The number of dropped traces.
+	std::atomic<std::uint64_t> dropped_{0};
+};
+
+}
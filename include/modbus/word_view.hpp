@@ -0,0 +1,140 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace modbus {
+
+/// Read-only view of a list of 16 bit words stored in big endian.
+/**
+ * The view does not own the data it refers to.
+ * Words are decoded when they are accessed.
+ */
+class word_view {
+public:
+	/// Random access iterator over the words in a view.
+	class iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type        = std::uint16_t;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = void;
+		using reference         = std::uint16_t;
+
+		iterator() = default;
+		explicit iterator(std::uint8_t const * data) : data(data) {}
+
+		std::uint16_t operator* () const { return std::uint16_t(data[0] << 8 | data[1]); }
+		std::uint16_t operator[] (difference_type n) const { return *(*this + n); }
+
+		iterator & operator++ () { data += 2; return *this; }
+		iterator & operator-- () { data -= 2; return *this; }
+		iterator operator++ (int) { iterator result = *this; ++*this; return result; }
+		iterator operator-- (int) { iterator result = *this; --*this; return result; }
+		iterator & operator+= (difference_type n) { data += 2 * n; return *this; }
+		iterator & operator-= (difference_type n) { data -= 2 * n; return *this; }
+
+		friend iterator operator+ (iterator a, difference_type n) { return a += n; }
+		friend iterator operator+ (difference_type n, iterator a) { return a += n; }
+		friend iterator operator- (iterator a, difference_type n) { return a -= n; }
+		friend difference_type operator- (iterator a, iterator b) { return (a.data - b.data) / 2; }
+
+		friend bool operator== (iterator a, iterator b) { return a.data == b.data; }
+		friend bool operator!= (iterator a, iterator b) { return a.data != b.data; }
+		friend bool operator<  (iterator a, iterator b) { return a.data <  b.data; }
+		friend bool operator>  (iterator a, iterator b) { return a.data >  b.data; }
+		friend bool operator<= (iterator a, iterator b) { return a.data <= b.data; }
+		friend bool operator>= (iterator a, iterator b) { return a.data >= b.data; }
+
+	private:
+		std::uint8_t const * data = nullptr;
+	};
+
+	/// Construct an empty view.
+	word_view() = default;
+
+	/// Construct a view of a number of big endian words.
+	word_view(
+		std::uint8_t const * data, ///< The first byte of the first word.
+		std::size_t count          ///< The number of words.
+	) : _data(data), _size(count) {}
+
+	/// Get the number of words in the view.
+	std::size_t size() const {
+		return _size;
+	}
+
+	/// Check if the view is empty.
+	bool empty() const {
+		return _size == 0;
+	}
+
+	/// Get the raw big endian data of the view.
+	std::uint8_t const * data() const {
+		return _data;
+	}
+
+	/// Get a word from the view.
+	std::uint16_t operator[] (std::size_t index) const {
+		return std::uint16_t(_data[2 * index] << 8 | _data[2 * index + 1]);
+	}
+
+	/// Get an iterator to the first word.
+	iterator begin() const {
+		return iterator(_data);
+	}
+
+	/// Get an iterator past the last word.
+	iterator end() const {
+		return iterator(_data + 2 * _size);
+	}
+
+	/// Get a view of a part of this view.
+	word_view subview(
+		std::size_t offset, ///< The index of the first word of the part.
+		std::size_t count   ///< The number of words in the part.
+	) const {
+		return word_view(_data + 2 * offset, count);
+	}
+
+	/// Copy the words to a vector.
+	std::vector<std::uint16_t> to_vector() const {
+		return std::vector<std::uint16_t>(begin(), end());
+	}
+
+private:
+	/// The first byte of the first word.
+	std::uint8_t const * _data = nullptr;
+
+	/// The number of words.
+	std::size_t _size = 0;
+};
+
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "request.hpp"
+#include "response.hpp"
+#include "tcp.hpp"
+#include "impl/serialize.hpp"
+#include "impl/deserialize.hpp"
+
+namespace {
+	using namespace modbus;
+
+	/// Size of the buffer to serialize into, the maximum size of a Modbus/TCP ADU.
+	constexpr std::size_t buffer_size = 260;
+
+	/// Make a message with a payload of the given number of values.
+	/**
+	 * Messages without a variable payload ignore the count.
+	 */
+	void fill(request::read_coils & adu,               std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(request::read_discrete_inputs & adu,     std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(request::read_holding_registers & adu,   std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(request::read_input_registers & adu,     std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(request::write_single_coil & adu,        std::size_t)       { adu = {0x10, true}; }
+	void fill(request::write_single_register & adu,    std::size_t)       { adu = {0x10, 0x1234}; }
+	void fill(request::write_multiple_coils & adu,     std::size_t count) { adu.address = 0x10; adu.values = bit_vector(count, true); }
+	void fill(request::write_multiple_registers & adu, std::size_t count) { adu.address = 0x10; adu.values.assign(count, 0x1234); }
+	void fill(request::mask_write_register & adu,      std::size_t)       { adu = {0x10, 0xff00, 0x0012}; }
+	void fill(request::read_write_multiple_registers & adu, std::size_t count) { adu.read_address = 0x10; adu.read_count = count; adu.write_address = 0x10; adu.values.assign(std::min<std::size_t>(count, 121), 0x1234); }
+	void fill(request::read_file_record & adu,         std::size_t count) { adu.records = {{4, 0, std::uint16_t(std::min<std::size_t>(count, 124))}}; }
+	void fill(request::write_file_record & adu,        std::size_t count) { adu.records = {{4, 0, std::vector<std::uint16_t>(std::min<std::size_t>(count, 122), 0x1234)}}; }
+	void fill(request::read_fifo_queue & adu,          std::size_t)       { adu = {0x10}; }
+
+	void fill(response::read_coils & adu,               std::size_t count) { adu.values = bit_vector(count, true); }
+	void fill(response::read_discrete_inputs & adu,     std::size_t count) { adu.values = bit_vector(count, true); }
+	void fill(response::read_holding_registers & adu,   std::size_t count) { adu.values.assign(count, 0x1234); }
+	void fill(response::read_input_registers & adu,     std::size_t count) { adu.values.assign(count, 0x1234); }
+	void fill(response::write_single_coil & adu,        std::size_t)       { adu = {0x10, true}; }
+	void fill(response::write_single_register & adu,    std::size_t)       { adu = {0x10, 0x1234}; }
+	void fill(response::write_multiple_coils & adu,     std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(response::write_multiple_registers & adu, std::size_t count) { adu = {0x10, std::uint16_t(count)}; }
+	void fill(response::mask_write_register & adu,      std::size_t)       { adu = {0x10, 0xff00, 0x0012}; }
+	void fill(response::read_write_multiple_registers & adu, std::size_t count) { adu.values.assign(count, 0x1234); }
+	void fill(response::read_file_record & adu,         std::size_t count) { adu.records = {std::vector<std::uint16_t>(std::min<std::size_t>(count, 124), 0x1234)}; }
+	void fill(response::write_file_record & adu,        std::size_t count) { adu.records = {{4, 0, std::vector<std::uint16_t>(std::min<std::size_t>(count, 122), 0x1234)}}; }
+	void fill(response::read_fifo_queue & adu,          std::size_t count) { adu.values.assign(std::min<std::size_t>(count, 31), 0x1234); }
+
+	void fill(tcp_mbap & header, std::size_t) {
+		header.transaction = 0x1234;
+		header.protocol    = 0;
+		header.length      = 6;
+		header.unit        = 1;
+	}
+
+	/// Clear the values of a message that is decoded again, keeping the allocated memory.
+	template<typename T> void clear(T &) {}
+	void clear(request::write_multiple_coils & adu)          { adu.values.clear(); }
+	void clear(request::write_multiple_registers & adu)      { adu.values.clear(); }
+	void clear(response::read_coils & adu)                   { adu.values.clear(); }
+	void clear(response::read_discrete_inputs & adu)         { adu.values.clear(); }
+	void clear(response::read_holding_registers & adu)       { adu.values.clear(); }
+	void clear(response::read_input_registers & adu)         { adu.values.clear(); }
+	void clear(request::read_write_multiple_registers & adu)  { adu.values.clear(); }
+	void clear(request::write_file_record & adu)              { adu.records.clear(); }
+	void clear(response::read_write_multiple_registers & adu) { adu.values.clear(); }
+	void clear(response::read_file_record & adu)              { adu.records.clear(); }
+	void clear(response::write_file_record & adu)             { adu.records.clear(); }
+	void clear(response::read_fifo_queue & adu)               { adu.values.clear(); }
+
+	/// The message type to serialize as input for deserializing T.
+	template<typename T> struct encoded_as { using type = T; };
+	template<> struct encoded_as<response::read_holding_registers_view> { using type = response::read_holding_registers; };
+	template<> struct encoded_as<response::read_input_registers_view>   { using type = response::read_input_registers; };
+
+	/// Serialize a message with the given payload size into a buffer.
+	template<typename T>
+	std::size_t encode(std::uint8_t * buffer, std::size_t count) {
+		T adu;
+		fill(adu, count);
+		return impl::serialize(buffer, adu);
+	}
+
+	/// Measure serializing a message of type T.
+	template<typename T>
+	void serialize(benchmark::State & state) {
+		T adu;
+		fill(adu, state.range(0));
+		std::uint8_t buffer[buffer_size];
+		std::size_t size = 0;
+
+		for (auto _ : state) {
+			std::uint8_t * out = buffer;
+			benchmark::DoNotOptimize(adu);
+			size = impl::serialize(out, adu);
+			benchmark::DoNotOptimize(buffer);
+			benchmark::ClobberMemory();
+		}
+
+		state.SetBytesProcessed(state.iterations() * size);
+	}
+
+	/// Measure deserializing a message of type T.
+	template<typename T>
+	void deserialize(benchmark::State & state) {
+		std::uint8_t buffer[buffer_size];
+		std::size_t size = encode<typename encoded_as<T>::type>(buffer, state.range(0));
+		T adu;
+
+		for (auto _ : state) {
+			std::error_code error;
+			clear(adu);
+			benchmark::DoNotOptimize(buffer);
+			std::uint8_t const * end = impl::deserialize(static_cast<std::uint8_t const *>(buffer), size, adu, error);
+			benchmark::DoNotOptimize(end);
+			benchmark::DoNotOptimize(adu);
+			if (error) state.SkipWithError(error.message().c_str());
+		}
+
+		state.SetBytesProcessed(state.iterations() * size);
+	}
+
+	/// Payload sizes for register lists, up to the protocol limit of 125 registers.
+	void registers(benchmark::internal::Benchmark * benchmark) {
+		benchmark->RangeMultiplier(2)->Range(1, 125);
+	}
+
+	/// Payload sizes for coil lists, up to the protocol limit of 2000 coils.
+	void coils(benchmark::internal::Benchmark * benchmark) {
+		benchmark->RangeMultiplier(4)->Range(1, 2000);
+	}
+
+	/// Payload sizes for coil lists in write requests, up to the protocol limit of 1968 coils.
+	void written_coils(benchmark::internal::Benchmark * benchmark) {
+		benchmark->RangeMultiplier(4)->Range(1, 1968);
+	}
+
+	/// A single payload size for messages without a variable payload.
+	void fixed(benchmark::internal::Benchmark * benchmark) {
+		benchmark->Arg(1);
+	}
+}
+
+BENCHMARK_TEMPLATE(serialize, tcp_mbap)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, tcp_mbap)->Apply(fixed);
+
+BENCHMARK_TEMPLATE(serialize, request::read_coils)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::read_discrete_inputs)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::read_holding_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::read_input_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::write_single_coil)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::write_single_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::write_multiple_coils)->Apply(written_coils);
+BENCHMARK_TEMPLATE(serialize, request::write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, request::mask_write_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, request::read_write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, request::read_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, request::write_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, request::read_fifo_queue)->Apply(fixed);
+
+BENCHMARK_TEMPLATE(deserialize, request::read_coils)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::read_discrete_inputs)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::read_holding_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::read_input_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::write_single_coil)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::write_single_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::write_multiple_coils)->Apply(written_coils);
+BENCHMARK_TEMPLATE(deserialize, request::write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, request::mask_write_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, request::read_write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, request::read_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, request::write_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, request::read_fifo_queue)->Apply(fixed);
+
+BENCHMARK_TEMPLATE(serialize, response::read_coils)->Apply(coils);
+BENCHMARK_TEMPLATE(serialize, response::read_discrete_inputs)->Apply(coils);
+BENCHMARK_TEMPLATE(serialize, response::read_holding_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, response::read_input_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, response::write_single_coil)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, response::write_single_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, response::write_multiple_coils)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, response::write_multiple_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, response::mask_write_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(serialize, response::read_write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, response::read_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, response::write_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(serialize, response::read_fifo_queue)->Apply(registers);
+
+BENCHMARK_TEMPLATE(deserialize, response::read_coils)->Apply(coils);
+BENCHMARK_TEMPLATE(deserialize, response::read_discrete_inputs)->Apply(coils);
+BENCHMARK_TEMPLATE(deserialize, response::read_holding_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::read_input_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::read_holding_registers_view)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::read_input_registers_view)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::write_single_coil)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, response::write_single_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, response::write_multiple_coils)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, response::write_multiple_registers)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, response::mask_write_register)->Apply(fixed);
+BENCHMARK_TEMPLATE(deserialize, response::read_write_multiple_registers)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::read_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::write_file_record)->Apply(registers);
+BENCHMARK_TEMPLATE(deserialize, response::read_fifo_queue)->Apply(registers);
+
+BENCHMARK_MAIN();
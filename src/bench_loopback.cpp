@@ -0,0 +1,257 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "latency_histogram.hpp"
+#include "server.hpp"
+
+namespace {
+	using clock = std::chrono::steady_clock;
+	using modbus::latency_histogram;
+
+	/// Benchmark parameters for one run.
+	struct config {
+		unsigned int threads;
+		unsigned int clients;
+		unsigned int depth;
+		std::uint16_t registers;
+		std::chrono::milliseconds duration;
+	};
+
+	/// A client that keeps a fixed number of reads in flight.
+	struct load {
+		std::unique_ptr<modbus::client> client;
+		std::atomic<std::uint64_t> completed{0};
+		std::atomic<std::uint64_t> errors{0};
+		std::atomic<bool> recording{false};
+		std::atomic<bool> stop{false};
+		std::uint16_t registers;
+
+		/// Latencies of the reads completed while recording, only touched from the strand of the client.
+		latency_histogram latencies;
+
+		explicit load(asio::io_context & io_context, std::uint16_t registers) : client(new modbus::client(io_context)), registers(registers) {}
+
+		void read() {
+			clock::time_point start = clock::now();
+			client->read_holding_registers_view(0, 0, registers, [this, start] (modbus::tcp_mbap const &, modbus::response::read_holding_registers_view const &, std::error_code const & error) {
+				if (error) {
+					errors.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				if (recording.load(std::memory_order_relaxed)) {
+					latencies.record(clock::now() - start);
+				}
+				completed.fetch_add(1, std::memory_order_relaxed);
+				if (!stop.load(std::memory_order_relaxed)) read();
+			});
+		}
+	};
+
+	/// Result of one run.
+	struct result {
+		double rate;
+		latency_histogram latencies;
+	};
+
+	/// Sum the completed requests of all clients.
+	std::uint64_t total_completed(std::vector<std::unique_ptr<load>> const & loads) {
+		std::uint64_t result = 0;
+		for (auto const & load : loads) result += load->completed.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	/// Run the benchmark for one configuration.
+	result run(config const & config) {
+		asio::io_context io_context;
+		std::vector<std::uint16_t> registers(125);
+
+		modbus::server server{io_context};
+		server.on_read_holding_registers = [&registers] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+			if (request.address + request.count > registers.size()) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+			reply({{registers.begin() + request.address, registers.begin() + request.address + request.count}});
+		};
+
+		std::error_code error = server.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+		if (error) {
+			std::cerr << "Failed to listen: " << error.message() << "\n";
+			std::exit(1);
+		}
+		std::string port = std::to_string(server.local_endpoint().port());
+
+		// Connect all clients and start the reads once connected.
+		std::vector<std::unique_ptr<load>> loads;
+		std::atomic<unsigned int> connected{0};
+		for (unsigned int i = 0; i < config.clients; ++i) {
+			loads.emplace_back(new load(io_context, config.registers));
+			load & load = *loads.back();
+			load.client->connect("127.0.0.1", port, [&load, &connected, &config] (std::error_code const & error) {
+				if (error) {
+					std::cerr << "Failed to connect: " << error.message() << "\n";
+					std::exit(1);
+				}
+				++connected;
+				for (unsigned int i = 0; i < config.depth; ++i) load.read();
+			});
+		}
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < config.threads; ++i) threads.emplace_back([&io_context] () { io_context.run(); });
+
+		while (connected < config.clients) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		// Warm up, then measure.
+		std::this_thread::sleep_for(config.duration / 5);
+		for (auto & load : loads) load->recording = true;
+		auto start = clock::now();
+		std::uint64_t start_count = total_completed(loads);
+		std::this_thread::sleep_for(config.duration);
+		std::uint64_t end_count = total_completed(loads);
+		auto end = clock::now();
+		for (auto & load : loads) load->recording = false;
+
+		// Let the outstanding reads drain before closing everything.
+		for (auto & load : loads) load->stop = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		for (auto & load : loads) load->client->close();
+		server.close();
+		for (auto & thread : threads) thread.join();
+
+		result result;
+		result.rate = (end_count - start_count) / std::chrono::duration<double>(end - start).count();
+		for (auto const & load : loads) {
+			if (load->errors) std::cerr << "Warning: " << load->errors << " requests failed.\n";
+			result.latencies.merge(load->latencies);
+		}
+		return result;
+	}
+
+	/// Parse a comma separated list of numbers.
+	std::vector<unsigned int> parse_list(char const * list) {
+		std::vector<unsigned int> result;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ',')) result.push_back(std::atoi(item.c_str()));
+		return result;
+	}
+
+	/// Get the default thread counts: powers of two up to the number of cores, and the number of cores.
+	std::vector<unsigned int> default_threads() {
+		unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned int> result;
+		for (unsigned int threads = 1; threads < cores; threads *= 2) result.push_back(threads);
+		result.push_back(cores);
+		return result;
+	}
+
+	void usage(char const * name) {
+		std::cerr << "Usage: " << name << " [--depth=LIST] [--registers=LIST] [--clients=LIST] [--threads=LIST] [--duration=MS]\n"
+			<< "Every combination of the comma separated lists is measured.\n";
+	}
+}
+
+/// Usage: modbus_bench_loopback [--depth=LIST] [--registers=LIST] [--clients=LIST] [--threads=LIST] [--duration=MS]
+int main(int argc, char * * argv) {
+	std::vector<unsigned int> depths    = {1, 8, 32};
+	std::vector<unsigned int> registers = {1, 125};
+	std::vector<unsigned int> clients   = {1, 16};
+	std::vector<unsigned int> threads   = default_threads();
+	std::chrono::milliseconds duration{500};
+
+	for (int i = 1; i < argc; ++i) {
+		char const * value = std::strchr(argv[i], '=');
+		if (!value) {
+			usage(argv[0]);
+			return 1;
+		}
+		std::string option(argv[i], value - argv[i]);
+		++value;
+		if      (option == "--depth")     depths    = parse_list(value);
+		else if (option == "--registers") registers = parse_list(value);
+		else if (option == "--clients")   clients   = parse_list(value);
+		else if (option == "--threads")   threads   = parse_list(value);
+		else if (option == "--duration")  duration  = std::chrono::milliseconds(std::atoi(value));
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::cout << "Loopback read_holding_registers benchmark, " << duration.count() << " ms per run.\n"
+		<< "Latencies are round trip times in microseconds.\n\n";
+
+	std::cout
+		<< std::setw(8)  << "threads"
+		<< std::setw(8)  << "clients"
+		<< std::setw(8)  << "depth"
+		<< std::setw(10) << "registers"
+		<< std::setw(14) << "requests/s"
+		<< std::setw(10) << "p50"
+		<< std::setw(10) << "p99"
+		<< std::setw(10) << "p999"
+		<< "\n";
+
+	for (unsigned int thread_count : threads) {
+		for (unsigned int client_count : clients) {
+			for (unsigned int depth : depths) {
+				for (unsigned int register_count : registers) {
+					config config;
+					config.threads   = thread_count;
+					config.clients   = client_count;
+					config.depth     = depth;
+					config.registers = register_count;
+					config.duration  = duration;
+
+					result result = run(config);
+					std::cout << std::fixed
+						<< std::setw(8)  << thread_count
+						<< std::setw(8)  << client_count
+						<< std::setw(8)  << depth
+						<< std::setw(10) << register_count
+						<< std::setw(14) << std::setprecision(0) << result.rate
+						<< std::setw(10) << std::setprecision(1) << result.latencies.percentile(0.5).count()   / 1e3
+						<< std::setw(10) << std::setprecision(1) << result.latencies.percentile(0.99).count()  / 1e3
+						<< std::setw(10) << std::setprecision(1) << result.latencies.percentile(0.999).count() / 1e3
+						<< std::endl;
+				}
+			}
+		}
+	}
+}
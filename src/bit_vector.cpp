@@ -0,0 +1,129 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "bit_vector.hpp"
+
+namespace modbus {
+
+namespace {
+	/// True if the 64 bit kernels can be used, which rely on little endian byte order.
+	constexpr bool little_endian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+	/// Pack 8 booleans into a byte.
+	/**
+	 * Multiplying moves bit 0 of every input byte i to bit 56 + i, without carries between the terms.
+	 */
+	inline std::uint8_t pack8(bool const * values) {
+		std::uint64_t word;
+		std::memcpy(&word, values, 8);
+		return (word * 0x0102040810204080ull) >> 56;
+	}
+
+	/// Unpack a byte into 8 booleans.
+	/**
+	 * Multiplying copies the byte to every byte of the word, the mask selects bit i in byte i,
+	 * and the addition carries any set bit into the high bit of its byte.
+	 */
+	inline void unpack8(std::uint8_t byte, bool * out) {
+		std::uint64_t word = (byte * 0x0101010101010101ull) & 0x8040201008040201ull;
+		word = ((word + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+		std::memcpy(out, &word, 8);
+	}
+}
+
+/// Pack an array of booleans into bytes, least significant bit first.
+void pack_bits(bool const * values, std::size_t count, std::uint8_t * out) {
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	// 32 bits at a time: shift bit 0 of every byte to the sign bit and collect the sign bits.
+	for (; i + 32 <= count; i += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + i));
+		std::uint32_t bits = _mm256_movemask_epi8(_mm256_slli_epi16(bytes, 7));
+		out[i / 8 + 0] = bits >>  0;
+		out[i / 8 + 1] = bits >>  8;
+		out[i / 8 + 2] = bits >> 16;
+		out[i / 8 + 3] = bits >> 24;
+	}
+#endif
+
+#if defined(__SSE2__)
+	// 16 bits at a time.
+	for (; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(values + i));
+		std::uint32_t bits = _mm_movemask_epi8(_mm_slli_epi16(bytes, 7));
+		out[i / 8 + 0] = bits >> 0;
+		out[i / 8 + 1] = bits >> 8;
+	}
+#endif
+
+	// 8 bits at a time.
+	if (little_endian) {
+		for (; i + 8 <= count; i += 8) out[i / 8] = pack8(values + i);
+	}
+
+	// Remaining bits, one at a time.
+	for (; i < count; i += 8) {
+		std::uint8_t byte = 0;
+		for (std::size_t bit = 0; bit < 8 && i + bit < count; ++bit) byte |= values[i + bit] << bit;
+		out[i / 8] = byte;
+	}
+}
+
+/// Unpack bytes into an array of booleans, least significant bit first.
+void unpack_bits(std::uint8_t const * data, std::size_t count, bool * out) {
+	std::size_t i = 0;
+
+#if defined(__SSE2__)
+	// 16 bits at a time: copy each byte to 8 lanes, select bit i in lane i and compare to get 0 or 1.
+	__m128i const mask = _mm_set1_epi64x(0x8040201008040201ll);
+	__m128i const ones = _mm_set1_epi8(1);
+	for (; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_set_epi64x(std::uint64_t(data[i / 8 + 1]) * 0x0101010101010101ull, std::uint64_t(data[i / 8]) * 0x0101010101010101ull);
+		__m128i bits  = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(bytes, mask), mask), ones);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), bits);
+	}
+#endif
+
+	// 8 bits at a time.
+	if (little_endian) {
+		for (; i + 8 <= count; i += 8) unpack8(data[i / 8], out + i);
+	}
+
+	// Remaining bits, one at a time.
+	for (; i < count; ++i) out[i] = data[i / 8] >> (i % 8) & 1;
+}
+
+}
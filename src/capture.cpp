@@ -0,0 +1,205 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "capture.hpp"
+#include "impl/pcap.hpp"
+
+namespace modbus {
+
+namespace {
+	/// Header of a recorded frame in the pending buffer, followed by the frame itself.
+	struct entry_header {
+		std::uint64_t timestamp;
+		std::uint32_t source_address;
+		std::uint32_t destination_address;
+		std::uint16_t source_port;
+		std::uint16_t destination_port;
+		std::uint32_t size;
+	};
+
+	/// Get the IPv4 address of an endpoint in host byte order, or zero for other endpoints.
+	std::uint32_t ipv4_address(asio::ip::tcp::endpoint const & endpoint) {
+		asio::ip::address address = endpoint.address();
+		return address.is_v4() ? address.to_v4().to_ulong() : 0;
+	}
+}
+
+/// Flush and close the file.
+capture_file::~capture_file() {
+	close();
+}
+
+/// Open a file and start the writer thread.
+std::error_code capture_file::open(std::string const & path) {
+	close();
+
+	file = std::fopen(path.c_str(), "wb");
+	if (!file) return std::error_code(errno, std::generic_category());
+
+	std::uint8_t header[impl::pcap_file_header_size];
+	impl::write_pcap_file_header(header);
+	if (std::fwrite(header, sizeof(header), 1, file) != 1) {
+		std::error_code error(errno, std::generic_category());
+		std::fclose(file);
+		file = nullptr;
+		return error;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	open_    = true;
+	stopping = false;
+	dropped_ = 0;
+	error_   = std::error_code();
+	writer   = std::thread(&capture_file::run, this);
+	return std::error_code();
+}
+
+/// Write all recorded frames, stop the writer thread and close the file.
+void capture_file::close() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!open_) return;
+		open_    = false;
+		stopping = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+	std::fclose(file);
+	file = nullptr;
+}
+
+/// Check if the file is open.
+bool capture_file::is_open() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return open_;
+}
+
+/// Record a frame.
+void capture_file::record(tcp::endpoint const & local, tcp::endpoint const & remote, direction direction, std::uint8_t const * data, std::size_t size) {
+	entry_header header;
+	header.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	header.size      = size;
+
+	tcp::endpoint const & source      = direction == direction::outgoing ? local  : remote;
+	tcp::endpoint const & destination = direction == direction::outgoing ? remote : local;
+	header.source_address      = ipv4_address(source);
+	header.source_port         = source.port();
+	header.destination_address = ipv4_address(destination);
+	header.destination_port    = destination.port();
+
+	bool notify;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!open_) return;
+		if (pending.size() + sizeof(header) + size > max_pending) {
+			++dropped_;
+			return;
+		}
+
+		notify = pending.empty();
+		std::size_t offset = pending.size();
+		pending.resize(offset + sizeof(header) + size);
+		std::memcpy(pending.data() + offset, &header, sizeof(header));
+		std::memcpy(pending.data() + offset + sizeof(header), data, size);
+	}
+
+	// The writer only sleeps while the buffer is empty.
+	if (notify) wake.notify_one();
+}
+
+/// Get the number of frames dropped because the writer fell behind.
+std::uint64_t capture_file::dropped() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return dropped_;
+}
+
+/// Get the error that stopped the writer thread, if any.
+std::error_code capture_file::error() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return error_;
+}
+
+/// Write recorded frames until the file is closed.
+void capture_file::run() {
+	using flow = std::tuple<std::uint32_t, std::uint16_t, std::uint32_t, std::uint16_t>;
+
+	// Next TCP sequence number per flow, so that the frames of a connection form a valid TCP stream.
+	std::map<flow, std::uint32_t> sequence;
+
+	std::vector<std::uint8_t> batch;
+	std::vector<std::uint8_t> output;
+	bool failed = false;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] () { return stopping || !pending.empty(); });
+		if (pending.empty()) break;
+		std::swap(batch, pending);
+		lock.unlock();
+
+		output.clear();
+		for (std::size_t offset = 0; offset < batch.size();) {
+			entry_header header;
+			std::memcpy(&header, batch.data() + offset, sizeof(header));
+			offset += sizeof(header);
+
+			std::uint32_t & seq = sequence.emplace(flow(header.source_address, header.source_port, header.destination_address, header.destination_port), 1).first->second;
+			std::uint32_t & ack = sequence.emplace(flow(header.destination_address, header.destination_port, header.source_address, header.source_port), 1).first->second;
+
+			impl::pcap_packet packet;
+			packet.timestamp           = header.timestamp;
+			packet.source_address      = header.source_address;
+			packet.source_port         = header.source_port;
+			packet.destination_address = header.destination_address;
+			packet.destination_port    = header.destination_port;
+			packet.sequence            = seq;
+			packet.acknowledgement     = ack;
+			impl::append_pcap_packet(output, packet, batch.data() + offset, header.size);
+
+			seq    += header.size;
+			offset += header.size;
+		}
+
+		if (!failed && !output.empty() && std::fwrite(output.data(), output.size(), 1, file) != 1) {
+			failed = true;
+			std::lock_guard<std::mutex> error_lock(mutex);
+			error_ = std::error_code(errno, std::generic_category());
+		}
+		batch.clear();
+
+		lock.lock();
+	}
+
+	if (!failed) std::fflush(file);
+}
+
+}
@@ -22,10 +22,14 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <functional>
 #include <system_error>
 
+#include <asio/bind_executor.hpp>
 #include <asio/connect.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/post.hpp>
 #include <asio/read.hpp>
 #include <asio/write.hpp>
 
@@ -36,166 +40,375 @@
 namespace modbus {
 
 namespace {
-	// Make a handler that deserializes a messages and passes it to the user callback.
+	/// Get the key to compare reads for deduplication.
+	/**
+	 * \return False for requests that are not deduplicated.
+	 */
 	template<typename T>
-	std::function<std::uint8_t const * (std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error)>
-	make_handler(client::Callback<T> && callback) {
-		return [callback] (std::uint8_t const * start, std::size_t length, tcp_mbap const & header, std::error_code error) {
-			T response;
-			std::uint8_t const * current = start;
-			std::uint8_t const * end     = start + length;
-
-			// Pass errors to callback.
-			if (error) {
-				callback(header, response, error);
-				return current;
-			}
+	bool read_key(std::uint8_t, T const &, std::uint64_t &) {
+		return false;
+	}
 
-			// Make sure the message contains atleast a function code.
-			if (length < 1) {
-				callback(header, response, modbus_error(errc::message_size_mismatch));
-				return current;
-			}
+	template<typename T>
+	bool register_read_key(std::uint8_t unit, T const & request, std::uint64_t & key) {
+		key = std::uint64_t(unit) << 40 | std::uint64_t(request.function) << 32 | std::uint32_t(request.address) << 16 | request.count;
+		return true;
+	}
 
-			// Function codes 128 and above are exception responses.
-			if (*current >= 128) {
-				callback(header, response, modbus_error(length >= 2 ? errc_t(start[1]) : errc::message_size_mismatch));
-				return current;
-			}
+	bool read_key(std::uint8_t unit, request::read_coils const & request, std::uint64_t & key)             { return register_read_key(unit, request, key); }
+	bool read_key(std::uint8_t unit, request::read_discrete_inputs const & request, std::uint64_t & key)   { return register_read_key(unit, request, key); }
+	bool read_key(std::uint8_t unit, request::read_holding_registers const & request, std::uint64_t & key) { return register_read_key(unit, request, key); }
+	bool read_key(std::uint8_t unit, request::read_input_registers const & request, std::uint64_t & key)   { return register_read_key(unit, request, key); }
 
-			// Try to deserialize the PDU.
-			current = impl::deserialize(current, end - current, response, error);
-			if (error) {
-				callback(header, response, error);
-				return current;
-			}
+	/// Buffer sequence that refers to an array of buffers without copying it.
+	struct buffer_range {
+		using value_type     = asio::const_buffer;
+		using const_iterator = asio::const_buffer const *;
 
-			// Check response length consistency.
-			// Length from the MBAP header includes the unit ID (1 byte) which is part of the MBAP header, not the response ADU.
-			if (current - start != header.length - 1) {
-				callback(header, response, modbus_error(errc::message_size_mismatch));
-				return current;
-			}
+		asio::const_buffer const * first;
+		asio::const_buffer const * last;
+
+		const_iterator begin() const { return first; }
+		const_iterator end()   const { return last; }
+	};
+}
 
-			callback(header, response, error);
-			return current;
-		};
+/// Deserialize the PDU of a reply.
+template<typename T>
+std::uint8_t const * client::decode_reply(std::uint8_t const * start, std::size_t length, tcp_mbap const & header, T & response, std::error_code & error) {
+	// Pass errors to callback.
+	if (error) return start;
+
+	// Make sure the message contains atleast a function code.
+	if (length < 1) {
+		error = modbus_error(errc::message_size_mismatch);
+		return start;
+	}
+
+	// Function codes 128 and above are exception responses.
+	if (*start >= 128) {
+		error = modbus_error(length >= 2 ? errc_t(start[1]) : errc::message_size_mismatch);
+		return start;
 	}
+
+	// Try to deserialize the PDU.
+	std::uint8_t const * current = impl::deserialize(start, length, response, error);
+	if (error) return current;
+
+	// Check response length consistency.
+	// Length from the MBAP header includes the unit ID (1 byte) which is part of the MBAP header, not the response ADU.
+	if (current - start != header.length - 1) {
+		error = modbus_error(errc::message_size_mismatch);
+	}
+
+	return current;
 }
 
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_coils &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_discrete_inputs &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_holding_registers &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_input_registers &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_holding_registers_view &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_input_registers_view &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::write_single_coil &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::write_single_register &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::write_multiple_coils &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::write_multiple_registers &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::mask_write_register &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_write_multiple_registers &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_file_record &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::write_file_record &, std::error_code &);
+template std::uint8_t const * client::decode_reply(std::uint8_t const *, std::size_t, tcp_mbap const &, response::read_fifo_queue &, std::error_code &);
+
 /// Send a Modbus request to the server.
 template<typename T>
 void client::send_message(
-	std::uint8_t unit,                               ///< The unit identifier of the target device.
-	T const & request,                               ///< The application data unit of the request.
-	client::Callback<typename T::response> callback  ///< The callback to invoke when the reply arrives.
+	std::uint8_t unit,                                ///< The unit identifier of the target device.
+	T const & request,                                ///< The application data unit of the request.
+	Handler handler,                                  ///< The handler to invoke when the reply arrives.
+	std::chrono::milliseconds timeout                 ///< The timeout for the request, or use_default_timeout.
 ) {
-	strand.dispatch([this, unit, request, callback] () mutable {
-		auto handler = make_handler<typename T::response>(std::move(callback));
+	std::chrono::steady_clock::time_point enqueued;
+	if (collect_statistics || trace) enqueued = std::chrono::steady_clock::now();
+	asio::dispatch(strand, std::bind(&client::start_transaction<T>, this, unit, request, std::move(handler), timeout, enqueued));
+}
 
+/// Allocate a transaction for a request and write the request to the server.
+template<typename T>
+void client::start_transaction(std::uint8_t unit, T const & request, Handler & handler, std::chrono::milliseconds timeout, std::chrono::steady_clock::time_point enqueued) {
+	// Reject requests that do not fit in the frame buffer of a slot.
+	if (7 + request.length() > max_frame_size) {
 		tcp_mbap header;
-		header.transaction = allocate_transaction(request.function, handler);
-		header.protocol    = 0;                    // 0 means Modbus.
-		header.length      = request.length() + 1; // Unit ID is also counted in length field.
+		header.transaction = 0;
+		header.protocol    = 0;
+		header.length      = 0;
 		header.unit        = unit;
+		handler(nullptr, 0, header, modbus_error(errc::message_too_large));
+		return;
+	}
 
-		auto out = std::ostreambuf_iterator<char>(&write_buffer);
-		impl::serialize(out, header);
-		impl::serialize(out, request);
-		flush_write_buffer();
-	});
+	// Attach the handler to an identical read in flight.
+	std::uint64_t key = 0;
+	bool shared = deduplicate_reads && read_key(unit, request, key);
+	if (shared) {
+		auto found = in_flight_reads.find(key);
+		if (found != in_flight_reads.end()) {
+			find_transaction(found->second)->followers.push_back(std::move(handler));
+			if (collect_statistics) {
+				std::lock_guard<std::mutex> lock(statistics_mutex);
+				++stats.deduplicated_reads;
+			}
+			return;
+		}
+	} else if (deduplicate_reads) {
+		// Other requests may change the data of the unit, so later reads must not share a reply that was sent before them.
+		forget_reads(unit);
+	}
+
+	tcp_mbap header;
+	if (!allocate_transaction(request.function, handler, header.transaction)) {
+		header.protocol = 0;
+		header.length   = 0;
+		header.unit     = unit;
+		handler(nullptr, 0, header, modbus_error(errc::too_many_transactions));
+		return;
+	}
+	transactions[header.transaction & (transaction_slots - 1)].unit     = unit;
+	transactions[header.transaction & (transaction_slots - 1)].enqueued = enqueued;
+	if (shared) {
+		transactions[header.transaction & (transaction_slots - 1)].shared   = true;
+		transactions[header.transaction & (transaction_slots - 1)].read_key = key;
+		in_flight_reads.emplace(key, header.transaction);
+	}
 
+	if (timeout == use_default_timeout) timeout = default_timeout;
+	if (timeout.count() > 0) start_timeout(header.transaction, timeout);
+
+	header.protocol    = 0;                    // 0 means Modbus.
+	header.length      = request.length() + 1; // Unit ID is also counted in length field.
+	header.unit        = unit;
+
+	// Serialize into the frame buffer of the slot.
+	std::size_t slot = header.transaction & (transaction_slots - 1);
+	std::uint8_t * out = frames.get() + slot * max_frame_size;
+	impl::serialize(out, header);
+	impl::serialize(out, request);
+	transactions[slot].frame_size = 7 + request.length();
+	if (trace) transactions[slot].serialized = std::chrono::steady_clock::now();
+	queue_frame(transactions[slot]);
 }
 
+template void client::send_message(std::uint8_t, request::read_coils const &,               Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_discrete_inputs const &,     Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_holding_registers const &,   Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_input_registers const &,     Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::write_single_coil const &,        Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::write_single_register const &,    Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::write_multiple_coils const &,     Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::write_multiple_registers const &, Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::mask_write_register const &,      Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_write_multiple_registers const &, Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_file_record const &,         Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::write_file_record const &,        Handler, std::chrono::milliseconds);
+template void client::send_message(std::uint8_t, request::read_fifo_queue const &,          Handler, std::chrono::milliseconds);
+
+std::chrono::milliseconds const client::use_default_timeout{-1};
+constexpr int client::transaction_slot_bits;
+constexpr std::size_t client::transaction_slots;
+constexpr std::size_t client::max_frame_size;
+
+/// Queue a register read to be coalesced with other reads queued in the same strand turn.
+template<typename T>
+void client::queue_read(
+	std::uint8_t unit,                                ///< The unit identifier of the target device.
+	T const & request,                                ///< The application data unit of the request.
+	client::Callback<typename T::response> callback,  ///< The callback to invoke when the reply arrives.
+	std::chrono::milliseconds timeout                 ///< The timeout for the request, or use_default_timeout.
+) {
+	asio::dispatch(strand, [this, unit, request, callback, timeout] () {
+		pending_reads(request).push_back({unit, request, callback, timeout});
+
+		// Post the flush, so that it runs after all handlers that are already queued on the strand.
+		if (pending_reads_posted) return;
+		pending_reads_posted = true;
+		asio::post(strand, std::bind(&client::flush_pending_reads, this));
+	});
+}
+
+template void client::queue_read(std::uint8_t, request::read_holding_registers const &, Callback<response::read_holding_registers>, std::chrono::milliseconds);
+template void client::queue_read(std::uint8_t, request::read_input_registers const &,   Callback<response::read_input_registers>,   std::chrono::milliseconds);
+
 /// Construct a client.
-client::client(asio::io_context & io_context) : strand(io_context), socket(io_context), resolver(io_context) {
-	_connected = false;
+client::client(asio::io_context & io_context) : strand(io_context.get_executor()), socket(io_context), resolver(io_context), timeout_timer(io_context), reconnect_timer(io_context), random(std::random_device()()) {
+	timeout_epoch = std::chrono::steady_clock::now();
+
+	transactions.resize(transaction_slots);
+	frames.reset(new std::uint8_t[transaction_slots * max_frame_size]);
+	held.resize(transaction_slots);
+	transmit_queue.reserve(transaction_slots);
+	write_batch.reserve(transaction_slots);
+	write_buffers.reserve(transaction_slots);
+	free_slots.resize(transaction_slots);
+	for (std::size_t i = 0; i < transaction_slots; ++i) free_slots[i] = i;
+	free_count = transaction_slots;
 }
 
 /// Connect to a server.
 void client::connect(std::string const & hostname, std::string const & port, std::function<void(std::error_code const &)> callback) {
-	tcp::resolver::query query(hostname, port);
+	asio::dispatch(strand, [this, hostname, port, callback] () {
+		// Remember the server for automatic reconnects.
+		this->hostname = hostname;
+		this->port     = port;
 
-	auto handler = strand.wrap(std::bind(&client::on_resolve, this, std::placeholders::_1, std::placeholders::_2, callback));
-	resolver.async_resolve(query, handler);
+		tcp::resolver::query query(hostname, port);
+
+		auto handler = asio::bind_executor(strand, std::bind(&client::on_resolve, this, std::placeholders::_1, std::placeholders::_2, callback));
+		resolver.async_resolve(query, handler);
+	});
 }
 
 /// Disconnect from the server.
 void client::close() {
-	// Call all remaining transaction handlers with operation_aborted, then clear transactions.
-	for (auto & transaction : transactions) transaction.second.handler(nullptr, 0, {}, asio::error::operation_aborted);
-	transactions.clear();
+	asio::dispatch(strand, std::bind(&client::close_, this));
+}
 
-	// Shutdown and close socket.
+/// Disconnect from the server.
+void client::close_() {
 	std::error_code error;
+	reconnecting = false;
+	reconnect_timer.cancel(error);
+
+	// Call all remaining transaction handlers with operation_aborted and release the transactions.
+	for (auto & transaction : transactions) {
+		if (transaction.active) abort_transaction(transaction, asio::error::operation_aborted);
+	}
+
+	// Aborting sent transactions moves held transactions to the transmit queue, which were aborted as well.
+	held_count = 0;
+	transmit_queue.clear();
+
+	timeout_timer.cancel(error);
+	timeout_timer_tick = 0;
+
+	// Shutdown and close socket.
 	resolver.cancel();
 	socket.shutdown(tcp::socket::shutdown_both, error);
 	socket.close(error);
+	_open      = false;
 	_connected = false;
 }
 
 /// Reset the client.
 void client::reset() {
+	asio::dispatch(strand, std::bind(&client::reset_, this));
+}
+
+/// Reset the client.
+void client::reset_() {
 	// Clear buffers.
+	// A busy write operation still finishes with an error, which clears the writing flag.
 	read_buffer.consume(read_buffer.size());
-	write_buffer.consume(write_buffer.size());
-	writing.clear();
 
 	// Old socket may hold now invalid file descriptor.
 	socket = asio::ip::tcp::socket(io_executor());
+	_open      = false;
 	_connected = false;
 }
 
 /// Read a number of coils from the connected server.
-void client::read_coils(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_coils> const & callback) {
-	send_message(unit, request::read_coils{address, count}, callback);
+void client::read_coils(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_coils> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_coils{address, count}, make_handler<response::read_coils>(callback), timeout);
 }
 
 /// Read a number of discrete inputs from the connected server.
-void client::read_discrete_inputs(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_discrete_inputs> const & callback) {
-	send_message(unit, request::read_discrete_inputs{address, count}, callback);
+void client::read_discrete_inputs(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_discrete_inputs> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_discrete_inputs{address, count}, make_handler<response::read_discrete_inputs>(callback), timeout);
 }
 
 /// Read a number of holding registers from the connected server.
-void client::read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_holding_registers> const & callback) {
-	send_message(unit, request::read_holding_registers{address, count}, callback);
+void client::read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_holding_registers> const & callback, std::chrono::milliseconds timeout) {
+	if (coalesce_reads) return queue_read(unit, request::read_holding_registers{address, count}, callback, timeout);
+	send_message(unit, request::read_holding_registers{address, count}, make_handler<response::read_holding_registers>(callback), timeout);
 }
 
 /// Read a number of input registers from the connected server.
-void client::read_input_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_input_registers> const & callback) {
-	send_message(unit, request::read_input_registers{address, count}, callback);
+void client::read_input_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_input_registers> const & callback, std::chrono::milliseconds timeout) {
+	if (coalesce_reads) return queue_read(unit, request::read_input_registers{address, count}, callback, timeout);
+	send_message(unit, request::read_input_registers{address, count}, make_handler<response::read_input_registers>(callback), timeout);
+}
+
+/// Read a number of holding registers from the connected server without copying the values.
+void client::read_holding_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_holding_registers_view> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_holding_registers{address, count}, make_handler<response::read_holding_registers_view>(callback), timeout);
+}
+
+/// Read a number of input registers from the connected server without copying the values.
+void client::read_input_registers_view(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_input_registers_view> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_input_registers{address, count}, make_handler<response::read_input_registers_view>(callback), timeout);
 }
 
 /// Write to a single coil on the connected server.
-void client::write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, Callback<response::write_single_coil> const & callback) {
-	send_message(unit, request::write_single_coil{address, value}, callback);
+void client::write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, Callback<response::write_single_coil> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_single_coil{address, value}, make_handler<response::write_single_coil>(callback), timeout);
 }
 
 /// Write to a single register on the connected server.
-void client::write_single_register(std::uint8_t unit, std::uint16_t address, std::uint16_t value, Callback<response::write_single_register> const & callback) {
-	send_message(unit, request::write_single_register{address, value}, callback);
+void client::write_single_register(std::uint8_t unit, std::uint16_t address, std::uint16_t value, Callback<response::write_single_register> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_single_register{address, value}, make_handler<response::write_single_register>(callback), timeout);
 }
 
 /// Write to a number of coils on the connected server.
-void client::write_multiple_coils(std::uint8_t unit, std::uint16_t address, std::vector<bool> values, Callback<response::write_multiple_coils> const & callback) {
-	send_message(unit, request::write_multiple_coils{address, values}, callback);
+void client::write_multiple_coils(std::uint8_t unit, std::uint16_t address, bit_vector values, Callback<response::write_multiple_coils> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_multiple_coils{address, std::move(values)}, make_handler<response::write_multiple_coils>(callback), timeout);
 }
 
 /// Write to a number of registers on the connected server.
-void client::write_multiple_registers(std::uint8_t unit, std::uint16_t address, std::vector<uint16_t> values, Callback<response::write_multiple_registers> const & callback) {
-	send_message(unit, request::write_multiple_registers{address, values}, callback);
+void client::write_multiple_registers(std::uint8_t unit, std::uint16_t address, std::vector<uint16_t> values, Callback<response::write_multiple_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_multiple_registers{address, std::move(values)}, make_handler<response::write_multiple_registers>(callback), timeout);
 }
 
 	/// Perform a masked write to a register on the connected server.
-void client::mask_write_register(std::uint8_t unit, std::uint16_t address, std::uint16_t and_mask, std::uint16_t or_mask, Callback<response::mask_write_register> const & callback) {
-	send_message(unit, request::mask_write_register{address, and_mask, or_mask}, callback);
+void client::mask_write_register(std::uint8_t unit, std::uint16_t address, std::uint16_t and_mask, std::uint16_t or_mask, Callback<response::mask_write_register> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::mask_write_register{address, and_mask, or_mask}, make_handler<response::mask_write_register>(callback), timeout);
+}
+
+/// Write to and then read from a number of registers on the connected server in one transaction.
+void client::read_write_multiple_registers(std::uint8_t unit, std::uint16_t read_address, std::uint16_t read_count, std::uint16_t write_address, std::vector<std::uint16_t> values, Callback<response::read_write_multiple_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_write_multiple_registers{read_address, read_count, write_address, std::move(values)}, make_handler<response::read_write_multiple_registers>(callback), timeout);
+}
+
+/// Read a number of file records from the connected server.
+void client::read_file_record(std::uint8_t unit, std::vector<file_record_reference> records, Callback<response::read_file_record> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_file_record{std::move(records)}, make_handler<response::read_file_record>(callback), timeout);
+}
+
+/// Write a number of file records on the connected server.
+void client::write_file_record(std::uint8_t unit, std::vector<file_record> records, Callback<response::write_file_record> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_file_record{std::move(records)}, make_handler<response::write_file_record>(callback), timeout);
+}
+
+/// Read the contents of a FIFO queue from the connected server.
+void client::read_fifo_queue(std::uint8_t unit, std::uint16_t address, Callback<response::read_fifo_queue> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_fifo_queue{address}, make_handler<response::read_fifo_queue>(callback), timeout);
+}
+
+/// Get a copy of the collected statistics.
+client::statistics client::statistics_snapshot() const {
+	std::lock_guard<std::mutex> lock(statistics_mutex);
+	return stats;
+}
+
+/// Reset the collected statistics.
+void client::reset_statistics() {
+	std::lock_guard<std::mutex> lock(statistics_mutex);
+	stats = statistics();
 }
 
 /// Called when the resolver finished resolving a hostname.
 void client::on_resolve(std::error_code const & error, tcp::resolver::iterator iterator, std::function<void(std::error_code const &)> callback) {
 	if (error) return callback(error);
 
-	auto handler = strand.wrap(std::bind(&client::on_connect, this, std::placeholders::_1, std::placeholders::_2, callback));
+	auto handler = asio::bind_executor(strand, std::bind(&client::on_connect, this, std::placeholders::_1, std::placeholders::_2, callback));
 	asio::async_connect(socket, iterator, handler);
 }
 
@@ -207,51 +420,497 @@ void client::on_connect(std::error_code const & error, tcp::resolver::iterator i
 
 	// Start read loop if no error occured.
 	if (!error) {
+		_open      = true;
 		_connected = true;
-		auto handler = strand.wrap(std::bind(&client::on_read, this, std::placeholders::_1, std::placeholders::_2));
-		socket.async_read_some(read_buffer.prepare(1024), handler);
+		capture_endpoints();
+		start_read();
+	}
+}
+
+/// Start the read loop.
+void client::start_read() {
+	auto handler = bind_memory(strand, read_memory, std::bind(&client::on_read, this, std::placeholders::_1, std::placeholders::_2));
+	socket.async_read_some(read_buffer.prepare(1024), handler);
+}
+
+/// Handle the loss of an established connection when auto_reconnect is enabled.
+void client::on_connection_lost() {
+	std::error_code error;
+	socket.shutdown(tcp::socket::shutdown_both, error);
+	socket.close(error);
+	_open      = false;
+	_connected = false;
+	read_buffer.consume(read_buffer.size());
+
+	// Replies to sent requests can not arrive anymore, but requests that were never written are kept.
+	reconnecting      = true;
+	reconnect_backoff = reconnect_delay;
+	for (auto & transaction : transactions) {
+		if (transaction.active && transaction.state == transmit_state::sent) abort_transaction(transaction, modbus_error(errc::connection_lost));
 	}
+
+	schedule_reconnect();
+}
+
+/// Schedule the next reconnect attempt with backoff and jitter.
+void client::schedule_reconnect() {
+	// The client may have been closed by a callback.
+	if (!reconnecting) return;
+
+	// Use a random delay between half and all of the backoff, so that clients do not reconnect in lockstep.
+	std::chrono::milliseconds::rep backoff = std::max<std::chrono::milliseconds::rep>(1, std::min(reconnect_backoff, max_reconnect_delay).count());
+	std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(backoff - backoff / 2, backoff);
+	reconnect_backoff = std::min(reconnect_backoff * 2, max_reconnect_delay);
+
+	reconnect_timer.expires_after(std::chrono::milliseconds(jitter(random)));
+	reconnect_timer.async_wait(asio::bind_executor(strand, std::bind(&client::on_reconnect_timer, this, std::placeholders::_1)));
+}
+
+/// Called when the reconnect timer expires.
+void client::on_reconnect_timer(std::error_code const & error) {
+	if (error == asio::error::operation_aborted || !reconnecting) return;
+
+	tcp::resolver::query query(hostname, port);
+	auto handler = asio::bind_executor(strand, std::bind(&client::on_reconnect_resolve, this, std::placeholders::_1, std::placeholders::_2));
+	resolver.async_resolve(query, handler);
+}
+
+/// Called when the resolver finished resolving a hostname for a reconnect attempt.
+void client::on_reconnect_resolve(std::error_code const & error, tcp::resolver::iterator iterator) {
+	if (!reconnecting) return;
+	if (error) return schedule_reconnect();
+
+	auto handler = asio::bind_executor(strand, std::bind(&client::on_reconnect_connect, this, std::placeholders::_1, std::placeholders::_2));
+	asio::async_connect(socket, iterator, handler);
+}
+
+/// Called when the socket finished connecting for a reconnect attempt.
+void client::on_reconnect_connect(std::error_code const & error, tcp::resolver::iterator iterator) {
+	(void) iterator;
+	if (!reconnecting) return;
+	if (error) return schedule_reconnect();
+
+	reconnecting = false;
+	_open        = true;
+	_connected   = true;
+	capture_endpoints();
+	start_read();
+
+	// Send the requests that were kept while reconnecting.
+	flush_transmit_queue();
+	if (on_reconnect) on_reconnect();
 }
 
 /// Called when the socket finished a read operation.
 void client::on_read(std::error_code const & error, size_t bytes_transferred) {
 	if (error) {
+		_connected = false;
 		if (on_io_error) on_io_error(error);
+
+		// Reconnect, unless the connection was closed on purpose.
+		if (auto_reconnect && _open) on_connection_lost();
 		return;
 	}
 
+	if (trace) {
+		read_time    = std::chrono::steady_clock::now();
+		read_carried = read_buffer.size();
+		if (read_carried == 0) front_received = read_time;
+	}
+
 	read_buffer.commit(bytes_transferred);
 
+	if (collect_statistics) {
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		stats.bytes_in += bytes_transferred;
+	}
+
 	// Parse and process all complete messages in the buffer.
 	while (process_message());
+	previous_read_time = read_time;
 
-	// Read more data.
-	auto handler = strand.wrap(std::bind(&client::on_read, this, std::placeholders::_1, std::placeholders::_2));
-	socket.async_read_some(read_buffer.prepare(1024), handler);
+	// Read more data, unless processing closed the connection.
+	if (_open) start_read();
 }
 
 /// Called when the socket finished a write operation.
 void client::on_write(std::error_code const & error, size_t bytes_transferred) {
 	if (error) {
+		finish_write();
 		if (on_io_error) on_io_error(error);
-		writing.clear();
+
+		// Reconnect, unless the connection was closed on purpose.
+		if (auto_reconnect && _open) on_connection_lost();
 		return;
 	}
 
-	write_buffer.consume(bytes_transferred);
+	if (collect_statistics) {
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		stats.bytes_out += bytes_transferred;
+	}
 
-	if (write_buffer.size()) {
-		flush_write_buffer_();
-	} else {
-		writing.clear();
+	std::chrono::steady_clock::time_point now;
+	if (trace) now = std::chrono::steady_clock::now();
+
+	// Skip the buffers that have been written completely.
+	while (bytes_transferred > 0) {
+		asio::const_buffer & buffer = write_buffers[write_offset];
+		if (bytes_transferred < buffer.size()) {
+			buffer = buffer + bytes_transferred;
+			break;
+		}
+		bytes_transferred -= buffer.size();
+		if (trace) transactions[write_batch[write_offset]].written = now;
+		if (capture) {
+			std::size_t slot = write_batch[write_offset];
+			capture->record(capture_local, capture_remote, capture_file::direction::outgoing, frames.get() + slot * max_frame_size, transactions[slot].frame_size);
+		}
+		++write_offset;
+	}
+
+	// Continue with the rest of the batch after a partial write.
+	if (write_offset < write_buffers.size()) {
+		write_batch_();
+		return;
 	}
+
+	finish_write();
+	flush_transmit_queue();
 }
 
 /// Allocate a transaction in the transaction table.
-std::uint16_t client::allocate_transaction(std::uint8_t function, Handler handler) {
-	std::uint16_t id = ++next_id;
-	transactions.insert({id, {function, handler}});
-	return id;
+bool client::allocate_transaction(std::uint8_t function, Handler & handler, std::uint16_t & id) {
+	if (free_count == 0) return false;
+
+	std::uint16_t slot = free_slots[free_head];
+	free_head = (free_head + 1) % transaction_slots;
+	--free_count;
+
+	transaction_t & transaction = transactions[slot];
+	transaction.function = function;
+	transaction.unit     = 0;
+	transaction.active   = true;
+	transaction.state    = transmit_state::held;
+	transaction.handler  = std::move(handler);
+
+	id = transaction.generation << transaction_slot_bits | slot;
+	return true;
+}
+
+/// Find an open transaction by transaction ID.
+client::transaction_t * client::find_transaction(std::uint16_t id) {
+	transaction_t & transaction = transactions[id & (transaction_slots - 1)];
+	if (!transaction.active) return nullptr;
+	if (std::uint16_t(transaction.generation << transaction_slot_bits) != (id & ~(transaction_slots - 1))) return nullptr;
+	return &transaction;
+}
+
+/// Release a transaction slot so that it can be reused.
+void client::release_transaction(transaction_t & transaction) {
+	std::size_t slot = &transaction - transactions.data();
+	timeouts.cancel(slot);
+
+	transaction.active  = false;
+	transaction.handler.reset();
+	if (transaction.shared) {
+		in_flight_reads.erase(transaction.read_key);
+		transaction.shared = false;
+	}
+	transaction.generation = (transaction.generation + 1) & ((1 << (16 - transaction_slot_bits)) - 1);
+
+	// A frame that is still being written keeps its slot until the write finishes.
+	if (!transaction.in_write) free_slot(slot);
+
+	if (transaction.state != transmit_state::held) {
+		--in_flight;
+		send_held();
+	}
+}
+
+/// Stop attaching new reads to the reads in flight to a unit.
+void client::forget_reads(std::uint8_t unit) {
+	for (auto read = in_flight_reads.begin(); read != in_flight_reads.end();) {
+		if (read->first >> 40 != unit) {
+			++read;
+			continue;
+		}
+		find_transaction(read->second)->shared = false;
+		read = in_flight_reads.erase(read);
+	}
+}
+
+/// Remember the endpoints of a new connection for the capture file.
+void client::capture_endpoints() {
+	std::error_code error;
+	capture_local  = socket.local_endpoint(error);
+	capture_remote = socket.remote_endpoint(error);
+}
+
+/// Remove a processed message from the read buffer.
+void client::consume_message(std::size_t size) {
+	read_buffer.consume(size);
+	if (!trace) return;
+
+	// The next message started in the previous read if it begins in the bytes that were carried over.
+	read_carried   = read_carried > size ? read_carried - size : 0;
+	front_received = read_carried > 0 ? previous_read_time : read_time;
+}
+
+/// Return a slot to the ring buffer of free slots.
+void client::free_slot(std::size_t slot) {
+	free_slots[(free_head + free_count) % transaction_slots] = slot;
+	++free_count;
+}
+
+/// Queue the frame of a new transaction for transmission, or hold it if the in-flight window is full.
+void client::queue_frame(transaction_t & transaction) {
+	std::size_t slot = &transaction - transactions.data();
+	std::uint16_t id = transaction.generation << transaction_slot_bits | slot;
+
+	if (held_count > 0 || (max_in_flight > 0 && in_flight >= max_in_flight)) {
+		transaction.state = transmit_state::held;
+		held[(held_head + held_count) % transaction_slots] = id;
+		++held_count;
+		return;
+	}
+
+	transaction.state = transmit_state::queued;
+	++in_flight;
+	transmit_queue.push_back(id);
+	post_flush();
+}
+
+/// Move held transactions to the transmit queue while the in-flight window has room.
+void client::send_held() {
+	while (held_count > 0 && (max_in_flight == 0 || in_flight < max_in_flight)) {
+		std::uint16_t id = held[held_head];
+		held_head = (held_head + 1) % transaction_slots;
+		--held_count;
+
+		// Skip transactions that timed out while they were held.
+		transaction_t * transaction = find_transaction(id);
+		if (!transaction || transaction->state != transmit_state::held) continue;
+
+		transaction->state = transmit_state::queued;
+		++in_flight;
+		transmit_queue.push_back(id);
+		post_flush();
+	}
+}
+
+/// Post a flush of the transmit queue to the strand, if not already posted.
+void client::post_flush() {
+	if (flush_posted) return;
+	flush_posted = true;
+	asio::post(strand, bind_memory(strand, flush_memory, [this] () {
+		flush_posted = false;
+		flush_transmit_queue();
+	}));
+}
+
+/// Write all frames in the transmit queue with a single gather write.
+void client::flush_transmit_queue() {
+	if (writing || reconnecting || transmit_queue.empty()) return;
+
+	for (std::uint16_t id : transmit_queue) {
+		// Skip transactions that were released while they were queued.
+		transaction_t * transaction = find_transaction(id);
+		if (!transaction || transaction->state != transmit_state::queued) continue;
+
+		transaction->state    = transmit_state::sent;
+		transaction->in_write = true;
+		write_batch.push_back(id & (transaction_slots - 1));
+		write_buffers.push_back(asio::buffer(frames.get() + (id & (transaction_slots - 1)) * max_frame_size, transaction->frame_size));
+	}
+	transmit_queue.clear();
+
+	if (write_batch.empty()) return;
+
+	if (collect_statistics) {
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		stats.frames_out     += write_batch.size();
+		stats.in_flight       = in_flight;
+		stats.peak_in_flight  = std::max(stats.peak_in_flight, in_flight);
+	}
+
+	writing      = true;
+	write_offset = 0;
+	write_batch_();
+}
+
+/// Write the remaining buffers of the current batch.
+void client::write_batch_() {
+	auto handler = bind_memory(strand, write_memory, std::bind(&client::on_write, this, std::placeholders::_1, std::placeholders::_2));
+	socket.async_write_some(buffer_range{write_buffers.data() + write_offset, write_buffers.data() + write_buffers.size()}, handler);
+}
+
+/// Finish the current write operation and release slots that were kept for it.
+void client::finish_write() {
+	for (std::uint16_t slot : write_batch) {
+		transaction_t & transaction = transactions[slot];
+		transaction.in_write = false;
+		if (!transaction.active) free_slot(slot);
+	}
+
+	write_batch.clear();
+	write_buffers.clear();
+	writing = false;
+}
+
+/// Release an open transaction and invoke its handler with an error.
+void client::abort_transaction(transaction_t & transaction, std::error_code const & error) {
+	std::size_t slot = &transaction - transactions.data();
+
+	tcp_mbap header;
+	header.transaction = transaction.generation << transaction_slot_bits | slot;
+	header.protocol    = 0;
+	header.length      = 0;
+	header.unit        = transaction.unit;
+
+	// Release the transaction before calling the handler, since the handler may start new transactions.
+	Handler handler = std::move(transaction.handler);
+	std::vector<Handler> followers = std::move(transaction.followers);
+	transaction.followers.clear();
+	release_transaction(transaction);
+	handler(nullptr, 0, header, error);
+	for (Handler & follower : followers) follower(nullptr, 0, header, error);
+}
+
+/// Get the current tick of the timeout timer wheel.
+std::uint64_t client::timeout_tick() const {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - timeout_epoch).count();
+}
+
+/// Start the timeout for an open transaction.
+void client::start_timeout(std::uint16_t id, std::chrono::milliseconds timeout) {
+	std::uint64_t now = timeout_tick();
+
+	// An empty wheel may lag behind, let it jump to the present first.
+	if (timeouts.empty()) timeouts.advance(now, [] (std::size_t) {});
+
+	timeouts.schedule(id & (transaction_slots - 1), now + timeout.count());
+	arm_timeout_timer();
+}
+
+/// Arm the timeout timer for the next tick the timer wheel needs to be advanced.
+void client::arm_timeout_timer() {
+	if (timeouts.empty()) return;
+
+	// Nothing to do if the timer is already armed early enough.
+	std::uint64_t tick = timeouts.next_tick();
+	if (timeout_timer_tick != 0 && timeout_timer_tick <= tick) return;
+
+	timeout_timer_tick = tick;
+	timeout_timer.expires_at(timeout_epoch + std::chrono::milliseconds(tick));
+	timeout_timer.async_wait(bind_memory(strand, timer_memory, std::bind(&client::on_timeout_timer, this, std::placeholders::_1)));
+}
+
+/// Called when the timeout timer expires.
+void client::on_timeout_timer(std::error_code const & error) {
+	// The timer was re-armed or the client was closed.
+	if (error == asio::error::operation_aborted) return;
+
+	timeout_timer_tick = 0;
+	timeouts.advance(timeout_tick(), [this] (std::size_t slot) {
+		abort_transaction(transactions[slot], modbus_error(errc::transaction_timeout));
+		if (collect_statistics) {
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			++stats.timeouts;
+			stats.in_flight = in_flight;
+		}
+	});
+	arm_timeout_timer();
+}
+
+/// Coalesce and send all pending reads.
+void client::flush_pending_reads() {
+	pending_reads_posted = false;
+
+	std::vector<pending_read_t<request::read_holding_registers>> holding_reads;
+	std::vector<pending_read_t<request::read_input_registers>>   input_reads;
+	std::swap(holding_reads, pending_holding_reads);
+	std::swap(input_reads,   pending_input_reads);
+
+	send_coalesced(std::move(holding_reads));
+	send_coalesced(std::move(input_reads));
+}
+
+/// Coalesce and send a list of pending reads.
+template<typename T>
+void client::send_coalesced(std::vector<pending_read_t<T>> reads) {
+	// Sort reads by unit and address, keeping the original order for equal ranges.
+	std::stable_sort(reads.begin(), reads.end(), [] (pending_read_t<T> const & a, pending_read_t<T> const & b) {
+		if (a.unit != b.unit) return a.unit < b.unit;
+		return a.request.address < b.request.address;
+	});
+
+	// Reads that are invalid by themselves are sent as-is, so the server can reject them.
+	auto valid = [] (pending_read_t<T> const & read) {
+		return read.request.count > 0 && read.request.count <= 125;
+	};
+
+	std::size_t i = 0;
+	while (i < reads.size()) {
+		std::size_t end_index = i + 1;
+		std::size_t start     = reads[i].request.address;
+		std::size_t end       = start + reads[i].request.count;
+
+		// Extend the group as long as the merged read stays within the protocol limit.
+		if (valid(reads[i])) {
+			while (end_index < reads.size()) {
+				pending_read_t<T> const & next = reads[end_index];
+				std::size_t next_end = std::size_t(next.request.address) + next.request.count;
+				if (next.unit != reads[i].unit || !valid(next)) break;
+				if (next.request.address > end + coalesce_gap) break;
+				if (std::max(end, next_end) - start > 125) break;
+				end = std::max(end, next_end);
+				++end_index;
+			}
+		}
+
+		if (end_index == i + 1) {
+			send_message(reads[i].unit, reads[i].request, make_handler<typename T::response>(std::move(reads[i].callback)), reads[i].timeout);
+		} else {
+			std::vector<pending_read_t<T>> group(std::make_move_iterator(reads.begin() + i), std::make_move_iterator(reads.begin() + end_index));
+			send_merged(std::move(group), start, end - start);
+		}
+
+		i = end_index;
+	}
+}
+
+/// Send a merged read for a group of pending reads and split the reply.
+template<typename T>
+void client::send_merged(std::vector<pending_read_t<T>> reads, std::uint16_t address, std::uint16_t count) {
+	// Use the shortest timeout of the group.
+	std::chrono::milliseconds timeout = std::chrono::milliseconds::zero();
+	for (auto const & read : reads) {
+		std::chrono::milliseconds read_timeout = read.timeout == use_default_timeout ? default_timeout : read.timeout;
+		if (read_timeout.count() > 0 && (timeout.count() == 0 || read_timeout < timeout)) timeout = read_timeout;
+	}
+
+	std::uint8_t unit = reads.front().unit;
+	send_message(unit, T{address, count}, make_handler<typename T::response>([this, reads, address] (tcp_mbap const & header, typename T::response const & response, std::error_code const & error) {
+		// The merged range may include registers the server does not have, so retry the reads separately.
+		if (error && error.category() == modbus_category() && error.value() < 0x80) {
+			for (auto const & read : reads) send_message(read.unit, read.request, make_handler<typename T::response>(read.callback), read.timeout);
+			return;
+		}
+
+		for (auto const & read : reads) {
+			typename T::response part;
+			std::size_t offset = read.request.address - address;
+
+			if (error) {
+				read.callback(header, part, error);
+			} else if (offset + read.request.count > response.values.size()) {
+				read.callback(header, part, modbus_error(errc::message_size_mismatch));
+			} else {
+				part.values.assign(response.values.begin() + offset, response.values.begin() + offset + read.request.count);
+				read.callback(header, part, error);
+			}
+		}
+	}), timeout);
 }
 
 /// Parse and process a message from the read buffer.
@@ -259,49 +918,94 @@ bool client::process_message() {
 	/// Modbus/TCP MBAP header is 7 bytes.
 	if (read_buffer.size() < 7) return false;
 
-	uint8_t const * data = asio::buffer_cast<uint8_t const *>(read_buffer.data());
+	uint8_t const * frame = asio::buffer_cast<uint8_t const *>(read_buffer.data());
 
 	std::error_code error;
 	tcp_mbap header;
 
-	data = impl::deserialize(data, read_buffer.size(), header, error);
+	uint8_t const * data = impl::deserialize(frame, read_buffer.size(), header, error);
+
+	// Length includes the unit ID and must fit atleast a function code, but no more than a maximum size PDU.
+	if (!error && header.protocol != 0) error = modbus_error(errc::invalid_value);
+	if (!error && (header.length < 2 || header.length > 254)) error = modbus_error(errc::message_size_mismatch);
 
 	// Handle deserialization errors in TCP MBAP.
 	// Cant send an error to a specific transaction and can't continue to read from the connection.
 	if (error) {
 		if (on_io_error) on_io_error(error);
-		close();
+		if (auto_reconnect && _open) {
+			on_connection_lost();
+		} else {
+			close_();
+		}
 		return false;
 	}
 
 	// Ensure entire message is in buffer.
 	if (read_buffer.size() < std::size_t(6 + header.length)) return false;
 
-	auto transaction = transactions.find(header.transaction);
-	if (transaction == transactions.end()) {
-		// TODO: Transaction not found. Possibly call on_io_error?
+	if (capture) capture->record(capture_local, capture_remote, capture_file::direction::incoming, frame, 6 + header.length);
+
+	transaction_t * transaction = find_transaction(header.transaction);
+	if (!transaction) {
+		// Transaction not found, the reply is dropped.
+		// TODO: Possibly call on_io_error?
+		if (collect_statistics) {
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			++stats.frames_in;
+			++stats.orphaned_replies;
+		}
+		consume_message(6 + header.length);
 		return true;
 	}
-	data = transaction->second.handler(data, header.length - 1, header, std::error_code());
-	transactions.erase(transaction);
 
-	// Remove read data and handled transaction.
-	read_buffer.consume(6 + header.length);
+	// Release the transaction before calling the handler, since the handler may start new transactions.
+	// The trace data is copied out first, since the slot can be reused by the handler.
+	Handler handler = std::move(transaction->handler);
+	std::vector<Handler> followers = std::move(transaction->followers);
+	transaction->followers.clear();
+	transaction_trace record;
+	record.transaction = header.transaction;
+	record.unit        = transaction->unit;
+	record.function    = transaction->function;
+	record.enqueued    = transaction->enqueued;
+	record.serialized  = transaction->serialized;
+	record.written     = transaction->written;
+	record.received    = front_received;
+	release_transaction(*transaction);
+
+	std::uint8_t const * pdu = data;
+	if (!collect_statistics && !trace) {
+		data = handler(data, header.length - 1, header, std::error_code());
+	} else {
+		// Function codes 128 and above are exception responses.
+		int exception = header.length >= 3 && data[0] >= 128 ? data[1] : -1;
+
+		record.parsed    = std::chrono::steady_clock::now();
+		data = handler(data, header.length - 1, header, std::error_code());
+		record.completed = std::chrono::steady_clock::now();
+
+		if (collect_statistics) {
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			++stats.frames_in;
+			if (exception >= 0) ++stats.exceptions[exception];
+			// Transactions sent before statistics were enabled have no enqueue time.
+			if (record.enqueued != std::chrono::steady_clock::time_point()) {
+				stats.latencies[record.unit << 8 | record.function].record(record.parsed - record.enqueued);
+			}
+			stats.handler_time.record(record.completed - record.parsed);
+			stats.in_flight = in_flight;
+		}
+		if (trace) trace->push(record);
+	}
 
-	return true;
-}
+	// Identical reads attached to the transaction get the same reply.
+	for (Handler & follower : followers) follower(pdu, header.length - 1, header, std::error_code());
 
-/// Flush the write buffer.
-void client::flush_write_buffer_() {
-	auto handler = strand.wrap(std::bind(&client::on_write, this, std::placeholders::_1, std::placeholders::_2));
-	socket.async_write_some(write_buffer.data(), handler);
-}
+	// Remove read data and handled transaction.
+	consume_message(6 + header.length);
 
-/// Flush the write buffer.
-void client::flush_write_buffer() {
-	if (writing.test_and_set()) return;
-	flush_write_buffer_();
+	return true;
 }
 
-
 }
@@ -52,10 +52,24 @@ namespace {
 				case errc::message_too_large:                       return "peer error: message size limit exceeded";
 				case errc::unexpected_function_code:                return "peer error: unexpected function code";
 				case errc::invalid_value:                           return "peer error: invalid value received";
+				case errc::crc_mismatch:                            return "peer error: CRC mismatch";
+
+				case errc::too_many_transactions:                   return "local error: too many open transactions";
+				case errc::transaction_timeout:                     return "local error: transaction timed out";
+				case errc::connection_lost:                         return "local error: connection lost before the reply arrived";
 			}
 
 			return "unknown error: " + std::to_string(error);
 		}
+
+		/// Map errors to a generic error condition where one exists.
+		std::error_condition default_error_condition(int error) const noexcept override {
+			switch (errc::errc_t(error)) {
+				case errc::transaction_timeout: return std::errc::timed_out;
+				case errc::connection_lost:     return std::errc::connection_aborted;
+				default:                        return std::error_condition(error, *this);
+			}
+		}
 	} modbus_category_;
 }
 
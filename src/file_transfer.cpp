@@ -0,0 +1,194 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include <asio/dispatch.hpp>
+
+#include "file_transfer.hpp"
+#include "error.hpp"
+
+namespace modbus {
+
+constexpr std::uint16_t file_transfer::max_read_count;
+constexpr std::uint16_t file_transfer::max_write_count;
+constexpr std::uint16_t file_transfer::max_fifo_count;
+
+/// Construct a file transfer helper.
+file_transfer::file_transfer(asio::io_context & io_context, modbus::client & client) : _client(client), strand(io_context.get_executor()) {}
+
+/// Read a range of records from a file.
+void file_transfer::read_file(std::uint8_t unit, std::uint16_t file, std::uint16_t record, std::size_t count, Sink sink, Done done) {
+	auto transfer = std::make_shared<transfer_t>();
+	transfer->type    = kind::read;
+	transfer->unit    = unit;
+	transfer->file    = file;
+	transfer->address = record;
+	transfer->total   = count;
+	transfer->sink    = std::move(sink);
+	transfer->done    = std::move(done);
+	start(std::move(transfer));
+}
+
+/// Write a range of records to a file.
+void file_transfer::write_file(std::uint8_t unit, std::uint16_t file, std::uint16_t record, std::vector<std::uint16_t> values, Done done) {
+	auto transfer = std::make_shared<transfer_t>();
+	transfer->type    = kind::write;
+	transfer->unit    = unit;
+	transfer->file    = file;
+	transfer->address = record;
+	transfer->total   = values.size();
+	transfer->values  = std::move(values);
+	transfer->done    = std::move(done);
+	start(std::move(transfer));
+}
+
+/// Read a FIFO queue.
+void file_transfer::read_fifo(std::uint8_t unit, std::uint16_t address, Sink sink, Done done, std::size_t max_reads) {
+	auto transfer = std::make_shared<transfer_t>();
+	transfer->type       = kind::fifo;
+	transfer->unit       = unit;
+	transfer->file       = 0;
+	transfer->address    = address;
+	transfer->total      = max_reads > 0 ? std::numeric_limits<std::size_t>::max() : 0;
+	transfer->sink       = std::move(sink);
+	transfer->fifo_reads = max_reads;
+	transfer->done       = std::move(done);
+	start(std::move(transfer));
+}
+
+/// Start a transfer, or fail it if the range is invalid.
+void file_transfer::start(std::shared_ptr<transfer_t> transfer) {
+	if (transfer->type != kind::fifo && transfer->address + transfer->total > 0x10000) {
+		transfer->error = std::make_error_code(std::errc::invalid_argument);
+	}
+	asio::dispatch(strand, std::bind(&file_transfer::fill, this, std::move(transfer)));
+}
+
+/// Send requests until the transfer has depth requests in flight, and finish the transfer when it is complete.
+void file_transfer::fill(std::shared_ptr<transfer_t> const & transfer) {
+	transfer_t & state = *transfer;
+
+	// FIFO reads are sent one at a time, since every read changes the queue.
+	std::size_t limit = state.type == kind::fifo ? 1 : std::max<std::size_t>(depth, 1);
+
+	while (!state.error && state.in_flight < limit && state.next < state.total) {
+		std::size_t offset = state.next;
+		++state.in_flight;
+
+		if (state.type == kind::read) {
+			std::size_t count = std::min<std::size_t>(state.total - offset, max_read_count);
+			state.next += count;
+			file_record_reference reference{state.file, std::uint16_t(state.address + offset), std::uint16_t(count)};
+			_client.read_file_record(state.unit, {reference}, [this, transfer, offset, count] (tcp_mbap const &, response::read_file_record const & response, std::error_code const & error) {
+				std::vector<std::uint16_t> values;
+				if (!error && response.records.size() == 1) values = response.records[0];
+				asio::dispatch(strand, std::bind(&file_transfer::on_read, this, transfer, offset, count, std::move(values), error));
+			}, timeout);
+		} else if (state.type == kind::write) {
+			std::size_t count = std::min<std::size_t>(state.total - offset, max_write_count);
+			state.next += count;
+			file_record record{state.file, std::uint16_t(state.address + offset), {state.values.begin() + offset, state.values.begin() + offset + count}};
+			_client.write_file_record(state.unit, {std::move(record)}, [this, transfer, count] (tcp_mbap const &, response::write_file_record const &, std::error_code const & error) {
+				asio::dispatch(strand, std::bind(&file_transfer::on_write, this, transfer, count, error));
+			}, timeout);
+		} else {
+			// The offset of the next read is only known when this read completes.
+			state.next = state.total;
+			_client.read_fifo_queue(state.unit, state.address, [this, transfer] (tcp_mbap const &, response::read_fifo_queue const & response, std::error_code const & error) {
+				asio::dispatch(strand, std::bind(&file_transfer::on_fifo, this, transfer, response.values, error));
+			}, timeout);
+		}
+	}
+
+	if (state.in_flight > 0 || (!state.error && state.completed < state.total)) return;
+
+	// Release the callbacks before invoking done, so they don't keep references alive.
+	Done done = std::move(state.done);
+	state.done = nullptr;
+	state.sink = nullptr;
+	if (done) done(state.error);
+}
+
+/// Called when a read of a file transfer completes.
+void file_transfer::on_read(std::shared_ptr<transfer_t> const & transfer, std::size_t offset, std::size_t count, std::vector<std::uint16_t> & values, std::error_code const & error) {
+	transfer_t & state = *transfer;
+	--state.in_flight;
+
+	if (!state.error) {
+		if (error) {
+			state.error = error;
+		} else if (values.size() != count) {
+			state.error = modbus_error(errc::message_size_mismatch);
+		} else {
+			// Pass on all data that is now in order.
+			state.pending.emplace(offset, std::move(values));
+			while (!state.pending.empty() && state.pending.begin()->first == state.completed) {
+				std::vector<std::uint16_t> const & chunk = state.pending.begin()->second;
+				if (state.sink) state.sink(state.completed, chunk);
+				state.completed += chunk.size();
+				state.pending.erase(state.pending.begin());
+			}
+		}
+	}
+
+	fill(transfer);
+}
+
+/// Called when a write of a file transfer completes.
+void file_transfer::on_write(std::shared_ptr<transfer_t> const & transfer, std::size_t count, std::error_code const & error) {
+	transfer_t & state = *transfer;
+	--state.in_flight;
+
+	if (!state.error) {
+		if (error) state.error = error;
+		else state.completed += count;
+	}
+
+	fill(transfer);
+}
+
+/// Called when a read of a FIFO transfer completes.
+void file_transfer::on_fifo(std::shared_ptr<transfer_t> const & transfer, std::vector<std::uint16_t> & values, std::error_code const & error) {
+	transfer_t & state = *transfer;
+	--state.in_flight;
+
+	if (error) {
+		state.error = error;
+	} else {
+		if (!values.empty() && state.sink) state.sink(state.completed, values);
+		state.completed += values.size();
+		state.next       = state.completed;
+
+		// Stop after the last allowed read, or when a short read means the queue is drained.
+		--state.fifo_reads;
+		if (state.fifo_reads == 0 || values.size() < max_fifo_count) state.total = state.completed;
+	}
+
+	fill(transfer);
+}
+
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <utility>
+
+#include <asio/dispatch.hpp>
+
+#include "gateway.hpp"
+#include "error.hpp"
+#include "impl/forward.hpp"
+
+namespace modbus {
+
+/// Construct a gateway.
+gateway::gateway(asio::io_context & io_context) : server(io_context), io_context(io_context) {
+	server.on_read_coils               = std::bind(&gateway::forward<request::read_coils>,               this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_discrete_inputs     = std::bind(&gateway::forward<request::read_discrete_inputs>,     this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_holding_registers   = std::bind(&gateway::forward<request::read_holding_registers>,   this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_input_registers     = std::bind(&gateway::forward<request::read_input_registers>,     this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_single_coil        = std::bind(&gateway::forward<request::write_single_coil>,        this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_single_register    = std::bind(&gateway::forward<request::write_single_register>,    this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_multiple_coils     = std::bind(&gateway::forward<request::write_multiple_coils>,     this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_multiple_registers = std::bind(&gateway::forward<request::write_multiple_registers>, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_mask_write_register      = std::bind(&gateway::forward<request::mask_write_register>,      this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_write_multiple_registers = std::bind(&gateway::forward<request::read_write_multiple_registers>, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_file_record         = std::bind(&gateway::forward<request::read_file_record>,         this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_file_record        = std::bind(&gateway::forward<request::write_file_record>,        this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_fifo_queue          = std::bind(&gateway::forward<request::read_fifo_queue>,          this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_disconnect               = std::bind(&gateway::disconnect, this, std::placeholders::_1);
+}
+
+/// Add an RTU bus that serves a set of units.
+rtu_client & gateway::add_bus(std::vector<std::uint8_t> const & units) {
+	buses.emplace_back(new bus(io_context));
+	for (std::uint8_t unit : units) routes[unit] = buses.back().get();
+	return buses.back()->client;
+}
+
+/// Stop accepting connections and close all connections and buses.
+void gateway::close() {
+	server.close();
+	for (auto & bus : buses) bus->client.close();
+}
+
+/// Forward a request to the bus of its unit.
+template<typename T>
+void gateway::forward(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply) {
+	bus * target = routes[header.unit];
+	if (!target) return reply(modbus_error(errc::gateway_path_unavailable));
+
+	std::uint8_t unit = header.unit;
+	queue(*target, reply.connection_id(), [target, unit, request, reply] (std::function<void ()> done) {
+		impl::send(target->client, unit, request, [reply, done] (tcp_mbap const &, typename T::response const & response, std::error_code const & error) {
+			reply(response, impl::gateway_error(error));
+			done();
+		});
+	}, [reply] () {
+		reply(modbus_error(errc::server_device_busy));
+	});
+}
+
+/// Queue a request on a bus.
+void gateway::queue(bus & bus, std::uint64_t connection, job job, std::function<void ()> busy) {
+	asio::dispatch(bus.strand, [this, &bus, connection, job, busy] () mutable {
+		std::deque<gateway::job> & queue = bus.queues[connection];
+		if (queue.size() >= max_queued) return busy();
+		if (queue.empty()) bus.ready.push_back(connection);
+		queue.push_back(std::move(job));
+		pump(bus);
+	});
+}
+
+/// Drop the queued requests of a closed connection from all buses.
+void gateway::disconnect(std::uint64_t connection) {
+	for (auto & bus : buses) {
+		gateway::bus * target = bus.get();
+		asio::dispatch(target->strand, [target, connection] () {
+			if (!target->queues.erase(connection)) return;
+			target->ready.erase(std::find(target->ready.begin(), target->ready.end(), connection));
+		});
+	}
+}
+
+/// Pass queued requests to the RTU client of a bus while it has room.
+void gateway::pump(bus & bus) {
+	while (bus.in_flight < bus_depth && !bus.ready.empty()) {
+		// Take one request from the next connection, and move the connection to the back if it has more.
+		std::uint64_t connection = bus.ready.front();
+		bus.ready.pop_front();
+
+		auto queue = bus.queues.find(connection);
+		job next = std::move(queue->second.front());
+		queue->second.pop_front();
+		if (queue->second.empty()) {
+			bus.queues.erase(queue);
+		} else {
+			bus.ready.push_back(connection);
+		}
+
+		++bus.in_flight;
+		next([this, &bus] () {
+			asio::dispatch(bus.strand, [this, &bus] () {
+				--bus.in_flight;
+				pump(bus);
+			});
+		});
+	}
+}
+
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#endif
+
+namespace modbus {
+namespace impl {
+
+	/// Swap the bytes of every 16 bit word in a block of memory.
+	/**
+	 * The kernel is selected at compile time: AVX2, SSE2 or NEON when available,
+	 * with a 64 bit scalar loop for the remainder.
+	 *
+	 * Input and output may be the same, but may not otherwise overlap.
+	 */
+	inline void byteswap16(std::uint8_t * out, std::uint8_t const * in, std::size_t count) {
+		std::size_t i = 0;
+
+#if defined(__AVX2__)
+		// 16 words at a time.
+		__m256i const shuffle = _mm256_setr_epi8(
+			1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+			1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+		);
+		for (; i + 16 <= count; i += 16) {
+			__m256i words = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(in + 2 * i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i), _mm256_shuffle_epi8(words, shuffle));
+		}
+#elif defined(__SSE2__)
+		// 8 words at a time.
+		for (; i + 8 <= count; i += 8) {
+			__m128i words = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in + 2 * i));
+			words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), words);
+		}
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+		// 8 words at a time.
+		for (; i + 8 <= count; i += 8) {
+			vst1q_u8(out + 2 * i, vrev16q_u8(vld1q_u8(in + 2 * i)));
+		}
+#endif
+
+		// 4 words at a time.
+		for (; i + 4 <= count; i += 4) {
+			std::uint64_t words;
+			std::memcpy(&words, in + 2 * i, 8);
+			words = (words & 0x00ff00ff00ff00ffull) << 8 | (words & 0xff00ff00ff00ff00ull) >> 8;
+			std::memcpy(out + 2 * i, &words, 8);
+		}
+
+		// Remaining words.
+		for (; i < count; ++i) {
+			std::uint8_t high = in[2 * i];
+			out[2 * i]     = in[2 * i + 1];
+			out[2 * i + 1] = high;
+		}
+	}
+
+	/// Read a block of big endian 16 bit words.
+	inline void load_be16(std::uint16_t * out, std::uint8_t const * in, std::size_t count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::memcpy(out, in, count * 2);
+#else
+		byteswap16(reinterpret_cast<std::uint8_t *>(out), in, count);
+#endif
+	}
+
+	/// Write a block of 16 bit words in big endian.
+	inline void store_be16(std::uint8_t * out, std::uint16_t const * in, std::size_t count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		std::memcpy(out, in, count * 2);
+#else
+		byteswap16(out, reinterpret_cast<std::uint8_t const *>(in), count);
+#endif
+	}
+
+}}
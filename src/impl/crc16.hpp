@@ -0,0 +1,85 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace modbus {
+namespace impl {
+
+	/// Lookup tables for a slice-by-8 CRC-16/Modbus.
+	/**
+	 * table[0] is the regular byte-wise table for the reflected polynomial 0xa001.
+	 * table[k] gives the CRC contribution of a byte followed by k zero bytes.
+	 */
+	struct crc16_tables {
+		std::uint16_t table[8][256];
+
+		crc16_tables() {
+			for (unsigned int byte = 0; byte < 256; ++byte) {
+				std::uint16_t crc = byte;
+				for (int bit = 0; bit < 8; ++bit) crc = crc & 1 ? (crc >> 1) ^ 0xa001 : crc >> 1;
+				table[0][byte] = crc;
+			}
+
+			for (unsigned int byte = 0; byte < 256; ++byte) {
+				for (int k = 1; k < 8; ++k) {
+					std::uint16_t previous = table[k - 1][byte];
+					table[k][byte] = (previous >> 8) ^ table[0][previous & 0xff];
+				}
+			}
+		}
+	};
+
+	/// Get the CRC-16/Modbus lookup tables.
+	inline crc16_tables const & crc16_table() {
+		static crc16_tables const tables;
+		return tables;
+	}
+
+	/// Compute the CRC-16/Modbus of a block of memory.
+	/**
+	 * Processes eight bytes per step with the slice-by-8 tables and the remainder byte by byte.
+	 * Pass the result of a previous call as initial value to continue a CRC.
+	 *
+	 * \return The CRC, which is transmitted low byte first.
+	 */
+	inline std::uint16_t crc16(std::uint8_t const * data, std::size_t size, std::uint16_t crc = 0xffff) {
+		auto const & t = crc16_table().table;
+
+		for (; size >= 8; size -= 8, data += 8) {
+			crc ^= data[0] | data[1] << 8;
+			crc = t[7][crc & 0xff] ^ t[6][crc >> 8]
+				^ t[5][data[2]] ^ t[4][data[3]] ^ t[3][data[4]]
+				^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+		}
+
+		for (; size > 0; --size, ++data) crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+		return crc;
+	}
+
+}}
@@ -29,7 +29,12 @@
 
 #include <system_error>
 
+#include "bit_vector.hpp"
 #include "error.hpp"
+#include "file_record.hpp"
+#include "word_view.hpp"
+
+#include "byte_order.hpp"
 
 namespace modbus {
 namespace impl {
@@ -94,7 +99,7 @@ namespace impl {
 	template<typename InputIterator>
 	InputIterator deserialize_bool(InputIterator start, bool & out, std::error_code & error) {
 		std::uint16_t word = 0xbeef;
-		deserialize_be16(start, word);
+		start = deserialize_be16(start, word);
 		out = uint16_to_bool(word, error);
 		return start;
 	}
@@ -126,25 +131,33 @@ namespace impl {
 	 * \return Iterator past the read sequence.
 	 */
 	template<typename InputIterator>
-	InputIterator deserialize_bit_list(InputIterator start, std::size_t length, std::size_t bit_count, std::vector<bool> & values, std::error_code & error) {
+	InputIterator deserialize_bit_list(InputIterator start, std::size_t length, std::size_t bit_count, bit_vector & values, std::error_code & error) {
 		// Check available data length.
 		if (!check_length(length, (bit_count + 7) / 8, error)) return start;
 
-		// Read bits.
-		values.reserve(values.size() + bit_count);
-		for (unsigned int start_bit = 0; start_bit < bit_count; start_bit += 8) {
-			std::uint8_t byte;
-			start = deserialize_be8(start, byte);
+		// Read bits. The bit vector uses the wire format, so the bytes are copied as-is.
+		std::size_t byte_count = (bit_count + 7) / 8;
+		values.resize(bit_count);
+		for (std::size_t i = 0; i < byte_count; ++i) start = deserialize_be8(start, values.data()[i]);
 
-			for (unsigned int sub_bit = 0; sub_bit < 8 && start_bit + sub_bit < bit_count; ++sub_bit) {
-				values.push_back(byte & 1);
-				byte >>= 1;
-			}
-		}
+		// Resizing to the same size clears the unused bits of the last byte.
+		values.resize(bit_count);
 
 		return start;
 	}
 
+	/// Reads a Modbus list of bits from a byte buffer.
+	/**
+	 * \return Pointer past the read sequence.
+	 */
+	inline std::uint8_t const * deserialize_bit_list(std::uint8_t const * start, std::size_t length, std::size_t bit_count, bit_vector & values, std::error_code & error) {
+		// Check available data length.
+		if (!check_length(length, (bit_count + 7) / 8, error)) return start;
+
+		values.assign_packed(start, bit_count);
+		return start + (bit_count + 7) / 8;
+	}
+
 	/// Read a Modbus vector of 16 bit words from a byte sequence.
 	/**
 	 * Reads the given number of words as 16 bit integers.
@@ -168,6 +181,48 @@ namespace impl {
 		return start;
 	}
 
+	/// Read a Modbus vector of 16 bit words from a byte buffer.
+	/**
+	 * Byte swaps the whole block at once.
+	 *
+	 * \return Pointer past the read sequence.
+	 */
+	inline std::uint8_t const * deserialize_word_list(std::uint8_t const * start, std::size_t length, std::size_t word_count, std::vector<std::uint16_t> & values, std::error_code & error) {
+		// Check available data length.
+		if (!check_length(length, word_count * 2, error)) return start;
+
+		std::size_t offset = values.size();
+		values.resize(offset + word_count);
+		load_be16(values.data() + offset, start, word_count);
+		return start + word_count * 2;
+	}
+
+	/// Read a view of a Modbus vector of 16 bit words from a byte sequence representing a response message.
+	/**
+	 * Reads byte count as 8 bit integer and makes a view of the words that follow.
+	 * The words are not decoded, and the view refers to the input data.
+	 * An odd byte count is rejected with invalid_value.
+	 *
+	 * Reads nothing if error code contains an error.
+	 *
+	 * \return Pointer past the read sequence.
+	 */
+	inline std::uint8_t const * deserialize_words_response(std::uint8_t const * start, std::size_t length, word_view & values, std::error_code & error) {
+		if (!check_length(length, 3, error)) return start;
+
+		// Read byte count, which must be a whole number of words.
+		std::uint8_t byte_count;
+		start = deserialize_be8(start, byte_count);
+		if (byte_count % 2 != 0) {
+			error = modbus_error(errc::invalid_value);
+			return start;
+		}
+		if (!check_length(length - 1, byte_count, error)) return start;
+
+		values = word_view(start, byte_count / 2);
+		return start + byte_count;
+	}
+
 	/// Read a Modbus vector of bits from a byte sequence representing a request message.
 	/**
 	 * Reads bit count as 16 bit integer, byte count as 8 bit integer and finally the bits packed in little endian.
@@ -177,7 +232,7 @@ namespace impl {
 	 * \return Iterator past the read sequence.
 	 */
 	template<typename InputIterator>
-	InputIterator deserialize_bits_request(InputIterator start, std::size_t length, std::vector<bool> & values, std::error_code & error) {
+	InputIterator deserialize_bits_request(InputIterator start, std::size_t length, bit_vector & values, std::error_code & error) {
 		if (!check_length(length, 3, error)) return start;
 
 		// Read word and byte count.
@@ -205,8 +260,8 @@ namespace impl {
 	 * \return Iterator past the read sequence.
 	 */
 	template<typename InputIterator>
-	InputIterator deserialize_bits_response(InputIterator start, std::size_t length, std::vector<bool> & values, std::error_code & error) {
-		if (!check_length(length, 3, error)) return start;
+	InputIterator deserialize_bits_response(InputIterator start, std::size_t length, bit_vector & values, std::error_code & error) {
+		if (!check_length(length, 1, error)) return start;
 
 		// Read word and byte count.
 		std::uint8_t  byte_count;
@@ -246,6 +301,7 @@ namespace impl {
 	/// Read a Modbus vector of 16 bit words from a byte sequence representing a response message.
 	/**
 	 * Reads byte count as 8 bit integer and finally the words as 16 bit integers.
+	 * An odd byte count is rejected with invalid_value.
 	 *
 	 * Reads nothing if error code contains an error.
 	 *
@@ -255,11 +311,64 @@ namespace impl {
 	InputIterator deserialize_words_response(InputIterator start, std::size_t length, std::vector<std::uint16_t> & values, std::error_code & error) {
 		if (!check_length(length, 3, error)) return start;
 
-		// Read word and byte count.
+		// Read byte count, which must be a whole number of words.
 		std::uint8_t  byte_count;
 		start = deserialize_be8 (start, byte_count);
+		if (byte_count % 2 != 0) {
+			error = modbus_error(errc::invalid_value);
+			return start;
+		}
 		start = deserialize_word_list(start, length - 1, byte_count / 2, values, error);
 		return start;
 	}
 
+	/// Read the reference type of a file record and check that it is 6.
+	/**
+	 * Sets the error code to invalid_value if the reference type is wrong,
+	 * but only if the error code is empty.
+	 *
+	 * \return Iterator past the read sequence.
+	 */
+	template<typename InputIterator>
+	InputIterator deserialize_reference_type(InputIterator start, std::error_code & error) {
+		std::uint8_t reference_type;
+		start = deserialize_be8(start, reference_type);
+		if (reference_type != 6 && !error) error = modbus_error(errc::invalid_value);
+		return start;
+	}
+
+	/// Read a list of file records from a byte sequence representing a write_file_record message.
+	/**
+	 * Reads the number of bytes of all records as 8 bit integer,
+	 * followed by the reference type, file number, record number, record length and values of every record.
+	 *
+	 * Reads nothing if error code contains an error.
+	 *
+	 * \return Iterator past the read sequence.
+	 */
+	template<typename InputIterator>
+	InputIterator deserialize_file_records(InputIterator start, std::size_t length, std::vector<file_record> & records, std::error_code & error) {
+		if (!check_length(length, 1, error)) return start;
+
+		std::uint8_t data_length;
+		start = deserialize_be8(start, data_length);
+		if (!check_length(length - 1, data_length, error)) return start;
+
+		for (std::size_t remaining = data_length; remaining > 0;) {
+			if (!check_length(remaining, 7, error)) return start;
+
+			std::uint16_t count;
+			records.emplace_back();
+			start = deserialize_reference_type(start, error);
+			start = deserialize_be16(start, records.back().file);
+			start = deserialize_be16(start, records.back().record);
+			start = deserialize_be16(start, count);
+			start = deserialize_word_list(start, remaining - 7, count, records.back().values, error);
+			if (error) return start;
+			remaining -= 7 + count * 2;
+		}
+
+		return start;
+	}
+
 }}
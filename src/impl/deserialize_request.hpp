@@ -34,7 +34,7 @@ namespace impl {
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::read_coils & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.count   );
 	return start;
@@ -44,7 +44,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::read
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::read_discrete_inputs & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.count   );
 	return start;
@@ -54,7 +54,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::read
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::read_holding_registers & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.count   );
 	return start;
@@ -64,7 +64,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::read
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::read_input_registers & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.count   );
 	return start;
@@ -74,9 +74,9 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::read
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::write_single_coil & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
-	start = deserialize_bool(start, adu.value   );
+	start = deserialize_bool(start, adu.value, error);
 	return start;
 }
 
@@ -84,7 +84,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::writ
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::write_single_register & adu, std::error_code & error) {
 	if (!check_length(length, 5, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.value   );
 	return start;
@@ -94,7 +94,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::writ
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::write_multiple_coils & adu, std::error_code & error) {
 	if (!check_length(length, 3, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_bits_request(start, length - 3, adu.values, error);
 	return start;
@@ -104,7 +104,7 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::writ
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::write_multiple_registers & adu, std::error_code & error) {
 	if (!check_length(length, 3, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_words_request(start, length - 3, adu.values, error);
 	return start;
@@ -114,11 +114,66 @@ InputIterator deserialize(InputIterator start, std::size_t length, request::writ
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, request::mask_write_register & adu, std::error_code & error) {
 	if (!check_length(length, 7, error)) return start;
-	start = deserialize_be8 (start, adu.function);
+	start = deserialize_function(start, adu.function, error);
 	start = deserialize_be16(start, adu.address );
 	start = deserialize_be16(start, adu.and_mask);
 	start = deserialize_be16(start, adu.or_mask );
 	return start;
 }
 
+/// Deserialize a read_write_multiple_registers request.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, request::read_write_multiple_registers & adu, std::error_code & error) {
+	if (!check_length(length, 7, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_be16(start, adu.read_address );
+	start = deserialize_be16(start, adu.read_count   );
+	start = deserialize_be16(start, adu.write_address);
+	start = deserialize_words_request(start, length - 7, adu.values, error);
+	return start;
+}
+
+/// Deserialize a read_file_record request.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, request::read_file_record & adu, std::error_code & error) {
+	if (!check_length(length, 2, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+
+	// Every sub-request is 7 bytes.
+	std::uint8_t byte_count;
+	start = deserialize_be8(start, byte_count);
+	if (byte_count % 7 != 0) {
+		error = modbus_error(errc::message_size_mismatch);
+		return start;
+	}
+	if (!check_length(length - 2, byte_count, error)) return start;
+
+	adu.records.resize(byte_count / 7);
+	for (file_record_reference & record : adu.records) {
+		start = deserialize_reference_type(start, error);
+		start = deserialize_be16(start, record.file  );
+		start = deserialize_be16(start, record.record);
+		start = deserialize_be16(start, record.count );
+	}
+	return start;
+}
+
+/// Deserialize a write_file_record request.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, request::write_file_record & adu, std::error_code & error) {
+	if (!check_length(length, 1, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_file_records(start, length - 1, adu.records, error);
+	return start;
+}
+
+/// Deserialize a read_fifo_queue request.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, request::read_fifo_queue & adu, std::error_code & error) {
+	if (!check_length(length, 3, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_be16(start, adu.address);
+	return start;
+}
+
 }}
@@ -70,6 +70,30 @@ InputIterator deserialize(InputIterator start, std::size_t length, response::rea
 	return start;
 }
 
+/// Deserialize a read_holding_registers response as a view.
+/**
+ * The view refers to the input data.
+ */
+inline std::uint8_t const * deserialize(std::uint8_t const * start, std::size_t length, response::read_holding_registers_view & adu, std::error_code & error) {
+	if (!check_length(length, 1, error)) return start;
+
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_words_response(start, length - 1, adu.values, error);
+	return start;
+}
+
+/// Deserialize a read_input_registers response as a view.
+/**
+ * The view refers to the input data.
+ */
+inline std::uint8_t const * deserialize(std::uint8_t const * start, std::size_t length, response::read_input_registers_view & adu, std::error_code & error) {
+	if (!check_length(length, 1, error)) return start;
+
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_words_response(start, length - 1, adu.values, error);
+	return start;
+}
+
 /// Deserialize a write_single_coil response.
 template<typename InputIterator>
 InputIterator deserialize(InputIterator start, std::size_t length, response::write_single_coil & adu, std::error_code & error) {
@@ -121,4 +145,71 @@ InputIterator deserialize(InputIterator start, std::size_t length, response::mas
 	return start;
 }
 
+/// Deserialize a read_write_multiple_registers response.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, response::read_write_multiple_registers & adu, std::error_code & error) {
+	if (!check_length(length, 1, error)) return start;
+
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_words_response(start, length - 1, adu.values, error);
+	return start;
+}
+
+/// Deserialize a read_file_record response.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, response::read_file_record & adu, std::error_code & error) {
+	if (!check_length(length, 2, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+
+	std::uint8_t data_length;
+	start = deserialize_be8(start, data_length);
+	if (!check_length(length - 2, data_length, error)) return start;
+
+	// Every sub-response is a length, the reference type and the values.
+	for (std::size_t remaining = data_length; remaining > 0;) {
+		if (!check_length(remaining, 2, error)) return start;
+
+		std::uint8_t record_length;
+		start = deserialize_be8(start, record_length);
+		start = deserialize_reference_type(start, error);
+		if (record_length % 2 != 1 && !error) error = modbus_error(errc::message_size_mismatch);
+
+		adu.records.emplace_back();
+		start = deserialize_word_list(start, remaining - 2, record_length / 2, adu.records.back(), error);
+		if (error) return start;
+		remaining -= 1 + record_length;
+	}
+	return start;
+}
+
+/// Deserialize a write_file_record response.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, response::write_file_record & adu, std::error_code & error) {
+	if (!check_length(length, 1, error)) return start;
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_file_records(start, length - 1, adu.records, error);
+	return start;
+}
+
+/// Deserialize a read_fifo_queue response.
+template<typename InputIterator>
+InputIterator deserialize(InputIterator start, std::size_t length, response::read_fifo_queue & adu, std::error_code & error) {
+	if (!check_length(length, 5, error)) return start;
+
+	std::uint16_t byte_count;
+	std::uint16_t fifo_count;
+	start = deserialize_function(start, adu.function, error);
+	start = deserialize_be16(start, byte_count);
+	start = deserialize_be16(start, fifo_count);
+
+	// The byte count includes the FIFO count.
+	if (byte_count != 2 + 2 * fifo_count) {
+		if (!error) error = modbus_error(errc::message_size_mismatch);
+		return start;
+	}
+
+	start = deserialize_word_list(start, length - 5, fifo_count, adu.values, error);
+	return start;
+}
+
 }}
@@ -0,0 +1,131 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <system_error>
+
+#include "error.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+namespace modbus {
+namespace impl {
+
+	/// Translate the error of a forwarded request to the error to send to the original client.
+	/**
+	 * Exception responses are forwarded as-is.
+	 * Other errors of the target server, including timeouts and framing errors, mean the target failed to respond.
+	 * Local errors, such as a closed connection or serial port, mean the target is not reachable.
+	 */
+	inline std::error_code gateway_error(std::error_code const & error) {
+		if (!error) return error;
+		if (error.category() == modbus_category()) {
+			if (error.value() > 0 && error.value() < 0x80) return error;
+			return modbus_error(errc::gateway_target_device_failed_to_respond);
+		}
+		return modbus_error(errc::gateway_path_unavailable);
+	}
+
+	/// Send a read_coils request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_coils const & request, typename Client::template Callback<response::read_coils> const & callback) {
+		client.read_coils(unit, request.address, request.count, callback);
+	}
+
+	/// Send a read_discrete_inputs request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_discrete_inputs const & request, typename Client::template Callback<response::read_discrete_inputs> const & callback) {
+		client.read_discrete_inputs(unit, request.address, request.count, callback);
+	}
+
+	/// Send a read_holding_registers request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_holding_registers const & request, typename Client::template Callback<response::read_holding_registers> const & callback) {
+		client.read_holding_registers(unit, request.address, request.count, callback);
+	}
+
+	/// Send a read_input_registers request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_input_registers const & request, typename Client::template Callback<response::read_input_registers> const & callback) {
+		client.read_input_registers(unit, request.address, request.count, callback);
+	}
+
+	/// Send a write_single_coil request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::write_single_coil const & request, typename Client::template Callback<response::write_single_coil> const & callback) {
+		client.write_single_coil(unit, request.address, request.value, callback);
+	}
+
+	/// Send a write_single_register request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::write_single_register const & request, typename Client::template Callback<response::write_single_register> const & callback) {
+		client.write_single_register(unit, request.address, request.value, callback);
+	}
+
+	/// Send a write_multiple_coils request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::write_multiple_coils const & request, typename Client::template Callback<response::write_multiple_coils> const & callback) {
+		client.write_multiple_coils(unit, request.address, request.values, callback);
+	}
+
+	/// Send a write_multiple_registers request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::write_multiple_registers const & request, typename Client::template Callback<response::write_multiple_registers> const & callback) {
+		client.write_multiple_registers(unit, request.address, request.values, callback);
+	}
+
+	/// Send a mask_write_register request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::mask_write_register const & request, typename Client::template Callback<response::mask_write_register> const & callback) {
+		client.mask_write_register(unit, request.address, request.and_mask, request.or_mask, callback);
+	}
+
+	/// Send a read_write_multiple_registers request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_write_multiple_registers const & request, typename Client::template Callback<response::read_write_multiple_registers> const & callback) {
+		client.read_write_multiple_registers(unit, request.read_address, request.read_count, request.write_address, request.values, callback);
+	}
+
+	/// Send a read_file_record request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_file_record const & request, typename Client::template Callback<response::read_file_record> const & callback) {
+		client.read_file_record(unit, request.records, callback);
+	}
+
+	/// Send a write_file_record request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::write_file_record const & request, typename Client::template Callback<response::write_file_record> const & callback) {
+		client.write_file_record(unit, request.records, callback);
+	}
+
+	/// Send a read_fifo_queue request with a client.
+	template<typename Client>
+	void send(Client & client, std::uint8_t unit, request::read_fifo_queue const & request, typename Client::template Callback<response::read_fifo_queue> const & callback) {
+		client.read_fifo_queue(unit, request.address, callback);
+	}
+
+}}
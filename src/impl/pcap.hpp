@@ -0,0 +1,307 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace modbus {
+namespace impl {
+
+	/// Magic number of a pcap file with nanosecond timestamps.
+	constexpr std::uint32_t pcap_magic_nanoseconds  = 0xa1b23c4d;
+
+	/// Magic number of a pcap file with microsecond timestamps.
+	constexpr std::uint32_t pcap_magic_microseconds = 0xa1b2c3d4;
+
+	/// Link type of packets starting with an Ethernet header.
+	constexpr std::uint32_t linktype_ethernet = 1;
+
+	/// Link type of packets starting with an IPv4 or IPv6 header.
+	constexpr std::uint32_t linktype_raw = 101;
+
+	/// Link type of packets starting with an IPv4 header.
+	constexpr std::uint32_t linktype_ipv4 = 228;
+
+	/// Size of the pcap file header.
+	constexpr std::size_t pcap_file_header_size = 24;
+
+	/// Size of the pcap record header.
+	constexpr std::size_t pcap_record_header_size = 16;
+
+	/// Size of the synthesized IPv4 header.
+	constexpr std::size_t ipv4_header_size = 20;
+
+	/// Size of the synthesized TCP header.
+	constexpr std::size_t tcp_header_size = 20;
+
+	/// A TCP packet to write to a pcap file.
+	struct pcap_packet {
+		/// Nanoseconds since the epoch.
+		std::uint64_t timestamp;
+
+		std::uint32_t source_address;
+		std::uint16_t source_port;
+		std::uint32_t destination_address;
+		std::uint16_t destination_port;
+		std::uint32_t sequence;
+		std::uint32_t acknowledgement;
+	};
+
+	/// A TCP payload read from a pcap file.
+	struct pcap_frame {
+		/// Nanoseconds since the epoch.
+		std::uint64_t timestamp;
+
+		std::uint32_t source_address;
+		std::uint16_t source_port;
+		std::uint32_t destination_address;
+		std::uint16_t destination_port;
+
+		/// The TCP payload.
+		std::uint8_t const * data;
+
+		/// The size of the TCP payload.
+		std::size_t size;
+	};
+
+	/// Write a 32 bit integer in native byte order, as used by pcap headers.
+	inline void write_native32(std::uint8_t * out, std::uint32_t value) {
+		std::memcpy(out, &value, 4);
+	}
+
+	/// Write a 16 bit integer in network byte order.
+	inline void write_network16(std::uint8_t * out, std::uint16_t value) {
+		out[0] = value >> 8;
+		out[1] = value;
+	}
+
+	/// Write a 32 bit integer in network byte order.
+	inline void write_network32(std::uint8_t * out, std::uint32_t value) {
+		write_network16(out,     value >> 16);
+		write_network16(out + 2, value);
+	}
+
+	/// Read a 16 bit integer in network byte order.
+	inline std::uint16_t read_network16(std::uint8_t const * in) {
+		return in[0] << 8 | in[1];
+	}
+
+	/// Read a 32 bit integer in network byte order.
+	inline std::uint32_t read_network32(std::uint8_t const * in) {
+		return std::uint32_t(read_network16(in)) << 16 | read_network16(in + 2);
+	}
+
+	/// Add data to a ones' complement checksum as used by IP and TCP.
+	inline std::uint32_t checksum_add(std::uint32_t sum, std::uint8_t const * data, std::size_t size) {
+		for (std::size_t i = 0; i + 1 < size; i += 2) sum += read_network16(data + i);
+		if (size % 2) sum += data[size - 1] << 8;
+		return sum;
+	}
+
+	/// Fold a ones' complement sum into a checksum.
+	inline std::uint16_t checksum_finish(std::uint32_t sum) {
+		while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+		return ~sum;
+	}
+
+	/// Write the header of a pcap file with nanosecond timestamps and IPv4 packets.
+	inline void write_pcap_file_header(std::uint8_t * out) {
+		write_native32(out +  0, pcap_magic_nanoseconds);
+		write_native32(out +  4, 2 | 4 << 16); // Version 2.4, as two 16 bit integers.
+		write_native32(out +  8, 0);           // Time zone offset, always zero.
+		write_native32(out + 12, 0);           // Timestamp accuracy, always zero.
+		write_native32(out + 16, 65535);       // Snapshot length.
+		write_native32(out + 20, linktype_ipv4);
+		if (*reinterpret_cast<std::uint16_t const *>("\x01\x00") != 1) {
+			// Big endian hosts need the version fields swapped, since they are two separate 16 bit integers.
+			write_native32(out + 4, 2 << 16 | 4);
+		}
+	}
+
+	/// Append a pcap record for a TCP packet with synthesized IPv4 and TCP headers.
+	inline void append_pcap_packet(std::vector<std::uint8_t> & output, pcap_packet const & packet, std::uint8_t const * payload, std::size_t size) {
+		std::size_t ip_size = ipv4_header_size + tcp_header_size + size;
+		std::size_t offset  = output.size();
+		output.resize(offset + pcap_record_header_size + ip_size);
+		std::uint8_t * out = output.data() + offset;
+
+		write_native32(out +  0, packet.timestamp / 1000000000);
+		write_native32(out +  4, packet.timestamp % 1000000000);
+		write_native32(out +  8, ip_size);
+		write_native32(out + 12, ip_size);
+		out += pcap_record_header_size;
+
+		std::uint8_t * ip = out;
+		ip[0] = 0x45;                             // Version 4, header length 5 words.
+		ip[1] = 0;                                // Type of service.
+		write_network16(ip + 2, ip_size);         // Total length.
+		write_network16(ip + 4, 0);               // Identification.
+		write_network16(ip + 6, 0x4000);          // Don't fragment.
+		ip[8] = 64;                               // Time to live.
+		ip[9] = 6;                                // Protocol: TCP.
+		write_network16(ip + 10, 0);              // Checksum, filled in below.
+		write_network32(ip + 12, packet.source_address);
+		write_network32(ip + 16, packet.destination_address);
+		write_network16(ip + 10, checksum_finish(checksum_add(0, ip, ipv4_header_size)));
+
+		std::uint8_t * tcp = ip + ipv4_header_size;
+		write_network16(tcp +  0, packet.source_port);
+		write_network16(tcp +  2, packet.destination_port);
+		write_network32(tcp +  4, packet.sequence);
+		write_network32(tcp +  8, packet.acknowledgement);
+		tcp[12] = 5 << 4;                         // Header length 5 words.
+		tcp[13] = 0x18;                           // Flags: PSH, ACK.
+		write_network16(tcp + 14, 0xffff);        // Window.
+		write_network16(tcp + 16, 0);             // Checksum, filled in below.
+		write_network16(tcp + 18, 0);             // Urgent pointer.
+		std::memcpy(tcp + tcp_header_size, payload, size);
+
+		// The TCP checksum covers a pseudo header with the addresses, protocol and TCP length.
+		std::uint32_t sum = checksum_add(0, ip + 12, 8);
+		sum += 6 + tcp_header_size + size;
+		sum  = checksum_add(sum, tcp, tcp_header_size + size);
+		write_network16(tcp + 16, checksum_finish(sum));
+	}
+
+	/// Reader for TCP payloads in a pcap file.
+	/**
+	 * Supports microsecond and nanosecond timestamps in either byte order,
+	 * and Ethernet, raw IP and IPv4 link types.
+	 * Packets that are not IPv4/TCP or have no payload are skipped.
+	 */
+	class pcap_reader {
+	public:
+		pcap_reader() = default;
+		pcap_reader(pcap_reader const &) = delete;
+		pcap_reader & operator= (pcap_reader const &) = delete;
+
+		~pcap_reader() {
+			if (file) std::fclose(file);
+		}
+
+		/// Open a file and read the file header.
+		std::error_code open(std::string const & path) {
+			file = std::fopen(path.c_str(), "rb");
+			if (!file) return std::error_code(errno, std::generic_category());
+
+			std::uint8_t header[pcap_file_header_size];
+			if (std::fread(header, sizeof(header), 1, file) != 1) return std::make_error_code(std::errc::invalid_argument);
+
+			std::uint32_t magic = read32(header);
+			if (magic != pcap_magic_nanoseconds && magic != pcap_magic_microseconds) {
+				swapped = true;
+				magic   = read32(header);
+			}
+			if      (magic == pcap_magic_nanoseconds)  nanoseconds = true;
+			else if (magic == pcap_magic_microseconds) nanoseconds = false;
+			else return std::make_error_code(std::errc::invalid_argument);
+
+			linktype = read32(header + 20) & 0xffff;
+			if (linktype != linktype_ethernet && linktype != linktype_raw && linktype != linktype_ipv4) return std::make_error_code(std::errc::not_supported);
+			return std::error_code();
+		}
+
+		/// Read the next TCP payload.
+		/**
+		 * The payload stays valid until the next call.
+		 *
+		 * \return False at the end of the file.
+		 */
+		bool next(pcap_frame & frame) {
+			std::uint8_t header[pcap_record_header_size];
+			while (std::fread(header, sizeof(header), 1, file) == 1) {
+				std::uint64_t seconds  = read32(header);
+				std::uint64_t fraction = read32(header + 4);
+				std::size_t   size     = read32(header + 8);
+
+				packet.resize(size);
+				if (size && std::fread(packet.data(), size, 1, file) != 1) return false;
+
+				frame.timestamp = seconds * 1000000000 + (nanoseconds ? fraction : fraction * 1000);
+				if (parse(packet.data(), size, frame)) return true;
+			}
+			return false;
+		}
+
+	private:
+		/// Read a 32 bit integer from a pcap header.
+		std::uint32_t read32(std::uint8_t const * in) const {
+			std::uint32_t value;
+			std::memcpy(&value, in, 4);
+			if (swapped) value = (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+			return value;
+		}
+
+		/// Parse the IPv4 and TCP headers of a packet.
+		bool parse(std::uint8_t const * data, std::size_t size, pcap_frame & frame) const {
+			if (linktype == linktype_ethernet) {
+				if (size < 14 || read_network16(data + 12) != 0x0800) return false;
+				data += 14;
+				size -= 14;
+			}
+
+			if (size < ipv4_header_size || data[0] >> 4 != 4 || data[9] != 6) return false;
+			std::size_t ip_header = (data[0] & 0xf) * 4;
+			std::size_t ip_size   = std::min<std::size_t>(size, read_network16(data + 2));
+			if (ip_size < ip_header + tcp_header_size) return false;
+
+			std::uint8_t const * tcp = data + ip_header;
+			std::size_t tcp_header = (tcp[12] >> 4) * 4;
+			if (ip_size < ip_header + tcp_header) return false;
+
+			frame.source_address      = read_network32(data + 12);
+			frame.destination_address = read_network32(data + 16);
+			frame.source_port         = read_network16(tcp);
+			frame.destination_port    = read_network16(tcp + 2);
+			frame.data                = tcp + tcp_header;
+			frame.size                = ip_size - ip_header - tcp_header;
+			return frame.size > 0;
+		}
+
+		/// The file.
+		std::FILE * file = nullptr;
+
+		/// True if the file was written in the opposite byte order.
+		bool swapped = false;
+
+		/// True if the timestamps have nanosecond resolution.
+		bool nanoseconds = true;
+
+		/// The link type of the packets.
+		std::uint32_t linktype = linktype_ipv4;
+
+		/// The data of the current packet.
+		std::vector<std::uint8_t> packet;
+	};
+
+}}
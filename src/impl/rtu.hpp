@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+
+#include "error.hpp"
+#include "functions.hpp"
+
+#include "crc16.hpp"
+
+namespace modbus {
+namespace impl {
+
+	/// Maximum size of a Modbus RTU frame: unit ID, PDU of up to 253 bytes and CRC.
+	constexpr std::size_t rtu_max_frame_size = 256;
+
+	/// Timing of an RTU serial line.
+	struct rtu_timing {
+		/// Time to transmit one character.
+		std::chrono::nanoseconds character;
+
+		/// Maximum silence between two characters of a frame (t1.5).
+		std::chrono::nanoseconds inter_character;
+
+		/// Minimum silence between two frames (t3.5).
+		std::chrono::nanoseconds frame_gap;
+	};
+
+	/// Compute the timing of an RTU serial line.
+	/**
+	 * A character is a start bit, eight data bits, an optional parity bit and the stop bits.
+	 * Above 19200 baud the specification fixes t1.5 at 750 us and t3.5 at 1750 us.
+	 */
+	inline rtu_timing make_rtu_timing(
+		unsigned int baud_rate, ///< The baud rate.
+		bool parity,            ///< True if a parity bit is sent.
+		unsigned int half_stop  ///< The number of stop bits times two.
+	) {
+		std::uint64_t half_bits = 2 * (1 + 8 + (parity ? 1 : 0)) + half_stop;
+
+		rtu_timing timing;
+		timing.character = std::chrono::nanoseconds(half_bits * 1000000000 / (2 * std::uint64_t(baud_rate)));
+		if (baud_rate > 19200) {
+			timing.inter_character = std::chrono::microseconds(750);
+			timing.frame_gap       = std::chrono::microseconds(1750);
+		} else {
+			timing.inter_character = timing.character * 3 / 2;
+			timing.frame_gap       = timing.character * 7 / 2;
+		}
+		return timing;
+	}
+
+	/// Append the CRC to an RTU frame.
+	/**
+	 * \return Pointer past the CRC.
+	 */
+	inline std::uint8_t * append_rtu_crc(std::uint8_t * start, std::uint8_t * end) {
+		std::uint16_t crc = crc16(start, end - start);
+		*end++ = crc & 0xff;
+		*end++ = crc >> 8;
+		return end;
+	}
+
+	/// Check the CRC at the end of an RTU frame.
+	inline bool check_rtu_crc(std::uint8_t const * frame, std::size_t size) {
+		if (size < 4) return false;
+		std::uint16_t crc = crc16(frame, size - 2);
+		return frame[size - 2] == (crc & 0xff) && frame[size - 1] == crc >> 8;
+	}
+
+	/// Get the size of an RTU response frame from its first bytes.
+	/**
+	 * The size follows from the function code, and for reads from the byte count.
+	 * The function code of the response must match the request, or be its exception response.
+	 *
+	 * \return The size of the frame including unit ID and CRC, or zero if more bytes are needed to tell.
+	 */
+	inline std::size_t rtu_response_size(
+		std::uint8_t function,      ///<[in] The function code of the request.
+		std::uint8_t const * frame, ///<[in] The received bytes of the response.
+		std::size_t size,           ///<[in] The number of received bytes.
+		std::error_code & error     ///<[out] Set if the response can not be framed.
+	) {
+		if (size < 2) return 0;
+		if (frame[1] == (function | 0x80)) return 5;
+		if (frame[1] != function) {
+			error = modbus_error(errc::unexpected_function_code);
+			return 0;
+		}
+
+		switch (function) {
+			case functions::read_coils:
+			case functions::read_discrete_inputs:
+			case functions::read_holding_registers:
+			case functions::read_input_registers:
+			case functions::read_write_multiple_registers:
+			case functions::read_file_record:
+			case functions::write_file_record:
+				return size < 3 ? 0 : 5 + frame[2];
+			case functions::read_fifo_record:
+				return size < 4 ? 0 : 6 + (frame[2] << 8 | frame[3]);
+			case functions::write_single_coil:
+			case functions::write_single_register:
+			case functions::write_multiple_coils:
+			case functions::write_multiple_registers:
+				return 8;
+			case functions::mask_write_register:
+				return 10;
+		}
+
+		error = modbus_error(errc::unexpected_function_code);
+		return 0;
+	}
+
+	/// Get the size of the PDU a server would reply with to a write request.
+	/**
+	 * Used to complete broadcast writes, which are not answered.
+	 * Single writes and masked writes are echoed, multiple writes are answered with the address and count.
+	 *
+	 * \return The size of the reply PDU, which is a prefix of the request PDU, or zero for requests that can not be broadcast.
+	 */
+	inline std::size_t rtu_broadcast_reply_size(std::uint8_t function, std::size_t request_size) {
+		switch (function) {
+			case functions::write_single_coil:
+			case functions::write_single_register:
+			case functions::mask_write_register:
+				return request_size;
+			case functions::write_multiple_coils:
+			case functions::write_multiple_registers:
+				return 5;
+			case functions::write_file_record:
+				return request_size;
+		}
+		return 0;
+	}
+
+}}
@@ -23,9 +23,16 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 
+#include "bit_vector.hpp"
+#include "file_record.hpp"
+
+#include "byte_order.hpp"
+
 namespace modbus {
 namespace impl {
 
@@ -61,24 +68,49 @@ namespace impl {
 	/// Serialize a packed list of booleans for Modbus.
 	/**
 	 * Writes the bits packed in little endian.
+	 * The bit vector is already in wire format, so the bytes are copied as-is.
 	 *
 	 * \return The number of bytes written.
 	 */
 	template<typename OutputIterator>
-	std::size_t serialize_bit_list(OutputIterator & out, std::vector<bool> const & values) {
-		std::size_t written = 0;
+	std::size_t serialize_bit_list(OutputIterator & out, bit_vector const & values) {
+		out = std::copy(values.data(), values.data() + values.byte_size(), out);
+		return values.byte_size();
+	}
 
-		for (std::size_t start_bit = 0; start_bit < values.size(); start_bit += 8) {
-			std::uint8_t byte = 0;
-			for (int sub_bit = 0; sub_bit < 8 && start_bit + sub_bit < values.size(); ++sub_bit) {
-				byte |= 1 << sub_bit;
-			}
-			written += serialize_be8(out, byte);
-		}
+	/// Serialize a packed list of booleans for Modbus to a byte buffer.
+	/**
+	 * \return The number of bytes written.
+	 */
+	inline std::size_t serialize_bit_list(std::uint8_t * & out, bit_vector const & values) {
+		std::memcpy(out, values.data(), values.byte_size());
+		out += values.byte_size();
+		return values.byte_size();
+	}
 
+	/// Serialize a list of 16 bit words in big endian.
+	/**
+	 * \return The number of bytes written.
+	 */
+	template<typename OutputIterator>
+	std::size_t serialize_word_list(OutputIterator & out, std::vector<std::uint16_t> const & values) {
+		std::size_t written = 0;
+		for (auto value : values) written += serialize_be16(out, value);
 		return written;
 	}
 
+	/// Serialize a list of 16 bit words in big endian to a byte buffer.
+	/**
+	 * Byte swaps the whole block at once.
+	 *
+	 * \return The number of bytes written.
+	 */
+	inline std::size_t serialize_word_list(std::uint8_t * & out, std::vector<std::uint16_t> const & values) {
+		store_be16(out, values.data(), values.size());
+		out += values.size() * 2;
+		return values.size() * 2;
+	}
+
 
 	/// Serialize a vector of booleans for a Modbus request message.
 	/**
@@ -89,7 +121,7 @@ namespace impl {
 	 * \return The number of bytes written.
 	 */
 	template<typename OutputIterator>
-	std::size_t serialize_bits_request(OutputIterator & out, std::vector<bool> const & values) {
+	std::size_t serialize_bits_request(OutputIterator & out, bit_vector const & values) {
 		std::size_t written = 0;
 
 		// Serialize bit count and byte count.
@@ -108,7 +140,7 @@ namespace impl {
 	 * \return The number of bytes written.
 	 */
 	template<typename OutputIterator>
-	std::size_t serialize_bits_response(OutputIterator & out, std::vector<bool> const & values) {
+	std::size_t serialize_bits_response(OutputIterator & out, bit_vector const & values) {
 		std::size_t written = 0;
 
 		// Serialize byte count and packed bits.
@@ -133,7 +165,7 @@ namespace impl {
 		// Serialize word count, byte count and data.
 		written += serialize_be16(out, values.size());
 		written += serialize_be8(out,  values.size() * 2);
-		for (auto value : values) written += serialize_be16(out, value);
+		written += serialize_word_list(out, values);
 
 		return written;
 	}
@@ -152,7 +184,33 @@ namespace impl {
 
 		// Serialize byte count and data.
 		written += serialize_be8(out, values.size() * 2);
-		for (auto value : values) written += serialize_be16(out, value);
+		written += serialize_word_list(out, values);
+
+		return written;
+	}
+
+	/// Serialize a list of file records for a Modbus write_file_record message.
+	/**
+	 * Writes the number of bytes of all records as uint8,
+	 * followed by the reference type, file number, record number, record length and values of every record.
+	 *
+	 * \return The number of bytes written.
+	 */
+	template<typename OutputIterator>
+	std::size_t serialize_file_records(OutputIterator & out, std::vector<file_record> const & records) {
+		std::size_t written = 0;
+
+		std::size_t data_length = 0;
+		for (file_record const & record : records) data_length += 7 + record.values.size() * 2;
+		written += serialize_be8(out, data_length);
+
+		for (file_record const & record : records) {
+			written += serialize_be8(out,  6); // Reference type, always 6.
+			written += serialize_be16(out, record.file);
+			written += serialize_be16(out, record.record);
+			written += serialize_be16(out, record.values.size());
+			written += serialize_word_list(out, record.values);
+		}
 
 		return written;
 	}
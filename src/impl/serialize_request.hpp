@@ -121,4 +121,49 @@ std::size_t serialize(OutputIterator & out, request::mask_write_register const &
 	return written;
 }
 
+/// Serialize a read_write_multiple_registers request.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, request::read_write_multiple_registers const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out,  adu.function);
+	written += serialize_be16(out, adu.read_address);
+	written += serialize_be16(out, adu.read_count);
+	written += serialize_be16(out, adu.write_address);
+	written += serialize_words_request(out, adu.values);
+	return written;
+}
+
+/// Serialize a read_file_record request.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, request::read_file_record const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out, adu.function);
+	written += serialize_be8(out, adu.records.size() * 7);
+	for (file_record_reference const & record : adu.records) {
+		written += serialize_be8(out,  6); // Reference type, always 6.
+		written += serialize_be16(out, record.file);
+		written += serialize_be16(out, record.record);
+		written += serialize_be16(out, record.count);
+	}
+	return written;
+}
+
+/// Serialize a write_file_record request.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, request::write_file_record const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out, adu.function);
+	written += serialize_file_records(out, adu.records);
+	return written;
+}
+
+/// Serialize a read_fifo_queue request.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, request::read_fifo_queue const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out,  adu.function);
+	written += serialize_be16(out, adu.address);
+	return written;
+}
+
 }}
@@ -117,4 +117,64 @@ std::size_t serialize(OutputIterator & out, response::mask_write_register const
 	return written;
 }
 
+/// Serialize a read_write_multiple_registers response.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, response::read_write_multiple_registers const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out, adu.function);
+	written += serialize_words_response(out, adu.values);
+	return written;
+}
+
+/// Serialize a read_file_record response.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, response::read_file_record const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out, adu.function);
+
+	std::size_t data_length = 0;
+	for (std::vector<std::uint16_t> const & values : adu.records) data_length += 2 + values.size() * 2;
+	written += serialize_be8(out, data_length);
+
+	for (std::vector<std::uint16_t> const & values : adu.records) {
+		written += serialize_be8(out, 1 + values.size() * 2);
+		written += serialize_be8(out, 6); // Reference type, always 6.
+		written += serialize_word_list(out, values);
+	}
+	return written;
+}
+
+/// Serialize a write_file_record response.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, response::write_file_record const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out, adu.function);
+	written += serialize_file_records(out, adu.records);
+	return written;
+}
+
+/// Serialize a read_fifo_queue response.
+template<typename OutputIterator>
+std::size_t serialize(OutputIterator & out, response::read_fifo_queue const & adu) {
+	std::size_t written = 0;
+	written += serialize_be8(out,  adu.function);
+	written += serialize_be16(out, 2 + adu.values.size() * 2);
+	written += serialize_be16(out, adu.values.size());
+	written += serialize_word_list(out, adu.values);
+	return written;
+}
+
+/// Serialize an exception response.
+/**
+ * An exception response consists of the function code with the high bit set,
+ * followed by the exception code.
+ */
+template<typename OutputIterator>
+std::size_t serialize_exception(OutputIterator & out, std::uint8_t function, std::uint8_t exception) {
+	std::size_t written = 0;
+	written += serialize_be8(out, function | 0x80);
+	written += serialize_be8(out, exception);
+	return written;
+}
+
 }}
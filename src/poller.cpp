@@ -0,0 +1,303 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+
+#include "poller.hpp"
+
+namespace modbus {
+
+namespace {
+	/// Update an exponential moving average over roughly the last 16 samples.
+	template<typename T>
+	void update_average(T & average, T sample) {
+		average += (sample - average) / 16;
+	}
+
+	/// Get the absolute value of a duration.
+	poller::clock::duration abs(poller::clock::duration duration) {
+		return duration < poller::clock::duration::zero() ? -duration : duration;
+	}
+}
+
+/// Construct a poller.
+poller::poller(asio::io_context & io_context, modbus::client & client) : _client(client), strand(io_context.get_executor()), timer(io_context) {}
+
+/// Add a scan group.
+std::size_t poller::add_group(std::chrono::milliseconds period, overrun_policy policy, std::chrono::milliseconds offset) {
+	// Scheduling divides by the period, and a zero period would never advance the deadline.
+	assert(period.count() > 0 && "scan group period must be positive");
+
+	group_t group;
+	group.period = period;
+	group.offset = offset;
+	group.policy = policy;
+	groups.push_back(std::move(group));
+	return groups.size() - 1;
+}
+
+/// Remove a scan group.
+void poller::remove_group(std::size_t group) {
+	asio::dispatch(strand, [this, group] () {
+		groups[group].removed = true;
+		groups[group].due     = false;
+
+		// Rebuild the heap without the group, and re-arm the timer in case it was waiting for the group.
+		auto removed = [group] (entry_t const & entry) { return entry.group == group; };
+		queue.erase(std::remove_if(queue.begin(), queue.end(), removed), queue.end());
+		std::make_heap(queue.begin(), queue.end());
+
+		std::error_code error;
+		timer.cancel(error);
+		arm_timer();
+	});
+}
+
+/// Add a read of coils to a scan group.
+void poller::read_coils(std::size_t group, std::uint8_t unit, std::uint16_t address, std::uint16_t count, client::Callback<response::read_coils> callback) {
+	client & client = _client;
+	add_read(group, [&client, unit, address, count, callback] (std::function<void (std::error_code const &)> done) {
+		client.read_coils(unit, address, count, [callback, done] (tcp_mbap const & header, response::read_coils const & response, std::error_code const & error) {
+			if (callback) callback(header, response, error);
+			done(error);
+		});
+	});
+}
+
+/// Add a read of discrete inputs to a scan group.
+void poller::read_discrete_inputs(std::size_t group, std::uint8_t unit, std::uint16_t address, std::uint16_t count, client::Callback<response::read_discrete_inputs> callback) {
+	client & client = _client;
+	add_read(group, [&client, unit, address, count, callback] (std::function<void (std::error_code const &)> done) {
+		client.read_discrete_inputs(unit, address, count, [callback, done] (tcp_mbap const & header, response::read_discrete_inputs const & response, std::error_code const & error) {
+			if (callback) callback(header, response, error);
+			done(error);
+		});
+	});
+}
+
+/// Add a read of holding registers to a scan group.
+void poller::read_holding_registers(std::size_t group, std::uint8_t unit, std::uint16_t address, std::uint16_t count, client::Callback<response::read_holding_registers> callback) {
+	client & client = _client;
+	add_read(group, [&client, unit, address, count, callback] (std::function<void (std::error_code const &)> done) {
+		client.read_holding_registers(unit, address, count, [callback, done] (tcp_mbap const & header, response::read_holding_registers const & response, std::error_code const & error) {
+			if (callback) callback(header, response, error);
+			done(error);
+		});
+	});
+}
+
+/// Add a read of input registers to a scan group.
+void poller::read_input_registers(std::size_t group, std::uint8_t unit, std::uint16_t address, std::uint16_t count, client::Callback<response::read_input_registers> callback) {
+	client & client = _client;
+	add_read(group, [&client, unit, address, count, callback] (std::function<void (std::error_code const &)> done) {
+		client.read_input_registers(unit, address, count, [callback, done] (tcp_mbap const & header, response::read_input_registers const & response, std::error_code const & error) {
+			if (callback) callback(header, response, error);
+			done(error);
+		});
+	});
+}
+
+/// Start polling.
+void poller::start() {
+	asio::dispatch(strand, [this] () {
+		if (running) return;
+		running = true;
+
+		clock::time_point now = clock::now();
+		queue.clear();
+		for (std::size_t i = 0; i < groups.size(); ++i) {
+			if (groups[i].removed) continue;
+			groups[i].deadline = now + groups[i].offset;
+			groups[i].due      = false;
+			queue.push_back({groups[i].deadline, i});
+		}
+		std::make_heap(queue.begin(), queue.end());
+		arm_timer();
+	});
+}
+
+/// Stop polling.
+void poller::stop() {
+	asio::dispatch(strand, [this] () {
+		running = false;
+		queue.clear();
+
+		std::error_code error;
+		timer.cancel(error);
+	});
+}
+
+/// Get the statistics of a scan group.
+poller::statistics poller::group_statistics(std::size_t group) const {
+	std::lock_guard<std::mutex> lock(statistics_mutex);
+	return groups[group].stats;
+}
+
+/// Add a read to a scan group.
+void poller::add_read(std::size_t group, Read read) {
+	groups[group].reads.push_back(std::move(read));
+}
+
+/// Arm the timer for the earliest deadline.
+void poller::arm_timer() {
+	if (!running || queue.empty()) return;
+	timer.expires_at(queue.front().deadline);
+	timer.async_wait(asio::bind_executor(strand, std::bind(&poller::on_timer, this, std::placeholders::_1)));
+}
+
+/// Called when the timer expires.
+void poller::on_timer(std::error_code const & error) {
+	if (error == asio::error::operation_aborted || !running) return;
+
+	// Start all due groups in deadline order.
+	clock::time_point now = clock::now();
+	while (!queue.empty() && queue.front().deadline <= now) {
+		std::size_t index = queue.front().group;
+		std::pop_heap(queue.begin(), queue.end());
+		queue.pop_back();
+
+		group_t & group = groups[index];
+		if (group.outstanding == 0) {
+			start_cycle(index, now);
+		} else if (group.policy == overrun_policy::delay) {
+			// Start the cycle when the busy cycle finishes.
+			group.due = true;
+		} else {
+			{
+				std::lock_guard<std::mutex> lock(statistics_mutex);
+				++group.stats.skipped;
+			}
+			schedule(index, now);
+		}
+	}
+
+	arm_timer();
+}
+
+/// Start a cycle of a group.
+void poller::start_cycle(std::size_t index, clock::time_point now) {
+	group_t & group = groups[index];
+
+	{
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		statistics & stats = group.stats;
+
+		stats.last_lateness = now - group.deadline;
+		stats.max_lateness  = std::max(stats.max_lateness, stats.last_lateness);
+		update_average(stats.mean_lateness, stats.last_lateness);
+
+		// The interval between cycle starts gives the achieved rate and the jitter.
+		if (stats.cycles > 0) {
+			clock::duration interval = now - group.cycle_start;
+			if (group.mean_interval == clock::duration::zero()) {
+				group.mean_interval = interval;
+				stats.jitter        = abs(interval - group.period);
+			} else {
+				update_average(group.mean_interval, interval);
+				update_average(stats.jitter, abs(interval - group.period));
+			}
+			if (group.mean_interval > clock::duration::zero()) {
+				stats.achieved_rate = 1.0 / std::chrono::duration<double>(group.mean_interval).count();
+			}
+		}
+	}
+
+	group.cycle_start = now;
+	group.outstanding = group.reads.size() + 1;
+	schedule(index, now);
+
+	for (Read const & read : group.reads) {
+		read([this, index] (std::error_code const & error) {
+			asio::dispatch(strand, std::bind(&poller::on_read_done, this, index, error));
+		});
+	}
+
+	// The extra outstanding count makes sure a cycle without reads or with synchronous failures completes only here.
+	on_read_done(index, std::error_code());
+}
+
+/// Called when a read of a cycle completes.
+void poller::on_read_done(std::size_t index, std::error_code const & error) {
+	group_t & group = groups[index];
+	clock::time_point now = clock::now();
+
+	if (error) {
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		++group.stats.errors;
+	}
+
+	if (--group.outstanding > 0) return;
+
+	statistics stats;
+	{
+		std::lock_guard<std::mutex> lock(statistics_mutex);
+		group.stats.last_cycle_time = now - group.cycle_start;
+		group.stats.max_cycle_time  = std::max(group.stats.max_cycle_time, group.stats.last_cycle_time);
+		++group.stats.cycles;
+		stats = group.stats;
+	}
+
+	if (on_cycle) on_cycle(index, stats);
+
+	// With the delay policy, start the cycle that became due while this one was busy.
+	if (group.due && running) {
+		group.due = false;
+		{
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			++group.stats.delayed;
+		}
+		start_cycle(index, now);
+		arm_timer();
+	}
+}
+
+/// Schedule the next cycle of a group after the given time.
+void poller::schedule(std::size_t index, clock::time_point now) {
+	group_t & group = groups[index];
+	group.deadline += group.period;
+
+	if (group.deadline <= now) {
+		if (group.policy == overrun_policy::skip) {
+			// Skip missed cycles, but stay on the original grid.
+			auto missed = (now - group.deadline) / group.period + 1;
+			group.deadline += missed * group.period;
+			std::lock_guard<std::mutex> lock(statistics_mutex);
+			group.stats.skipped += missed;
+		} else {
+			// Continue the schedule from the actual start of the cycle.
+			group.deadline = now + group.period;
+		}
+	}
+
+	queue.push_back({group.deadline, index});
+	std::push_heap(queue.begin(), queue.end());
+}
+
+}
@@ -0,0 +1,233 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <utility>
+
+#include "proxy.hpp"
+#include "error.hpp"
+#include "impl/forward.hpp"
+
+namespace modbus {
+
+namespace {
+	/// IDs of the cached tables.
+	enum table_id : std::uint8_t {
+		coils             = 0,
+		discrete_inputs   = 1,
+		holding_registers = 2,
+		input_registers   = 3,
+	};
+
+	/// Get the table of a read.
+	std::uint8_t table_of(request::read_coils const &)               { return coils; }
+	std::uint8_t table_of(request::read_discrete_inputs const &)     { return discrete_inputs; }
+	std::uint8_t table_of(request::read_holding_registers const &)   { return holding_registers; }
+	std::uint8_t table_of(request::read_input_registers const &)     { return input_registers; }
+
+	/// Get the written table of a write.
+	std::uint8_t table_of(request::write_single_coil const &)        { return coils; }
+	std::uint8_t table_of(request::write_multiple_coils const &)     { return coils; }
+	std::uint8_t table_of(request::write_single_register const &)    { return holding_registers; }
+	std::uint8_t table_of(request::write_multiple_registers const &) { return holding_registers; }
+	std::uint8_t table_of(request::mask_write_register const &)      { return holding_registers; }
+	std::uint8_t table_of(request::read_write_multiple_registers const &) { return holding_registers; }
+
+	/// Get the maximum count of a read, larger reads are forwarded so the device can reject them.
+	std::uint16_t max_count(std::uint8_t table) {
+		return table == coils || table == discrete_inputs ? 2000 : 125;
+	}
+
+	/// Get the number of written values of a write.
+	std::uint16_t written_count(request::write_single_coil const &)                { return 1; }
+	std::uint16_t written_count(request::write_single_register const &)            { return 1; }
+	std::uint16_t written_count(request::mask_write_register const &)              { return 1; }
+	std::uint16_t written_count(request::write_multiple_coils const & request)     { return request.values.size(); }
+	std::uint16_t written_count(request::write_multiple_registers const & request) { return request.values.size(); }
+	std::uint16_t written_count(request::read_write_multiple_registers const & request) { return request.values.size(); }
+
+	/// Get the address of the first written value of a write.
+	template<typename T>
+	std::uint16_t written_address(T const & request)                                     { return request.address; }
+	std::uint16_t written_address(request::read_write_multiple_registers const & request) { return request.write_address; }
+
+	/// Convert the bits of a response to cache values.
+	std::vector<std::uint16_t> to_values(bit_vector const & bits, std::uint16_t count) {
+		std::vector<std::uint16_t> values(count);
+		for (std::size_t i = 0; i < count && i < bits.size(); ++i) values[i] = bits[i];
+		return values;
+	}
+
+	std::vector<std::uint16_t> to_values(response::read_coils const & response, std::uint16_t count)           { return to_values(response.values, count); }
+	std::vector<std::uint16_t> to_values(response::read_discrete_inputs const & response, std::uint16_t count) { return to_values(response.values, count); }
+	std::vector<std::uint16_t> to_values(response::read_holding_registers const & response, std::uint16_t)     { return response.values; }
+	std::vector<std::uint16_t> to_values(response::read_input_registers const & response, std::uint16_t)       { return response.values; }
+
+	/// Convert cache values to bits.
+	bit_vector to_bits(std::vector<std::uint16_t> const & values) {
+		bit_vector bits(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i) bits[i] = values[i] != 0;
+		return bits;
+	}
+
+	/// Build a response from cache values.
+	void make_response(std::vector<std::uint16_t> && values, response::read_coils & response)             { response.values = to_bits(values); }
+	void make_response(std::vector<std::uint16_t> && values, response::read_discrete_inputs & response)   { response.values = to_bits(values); }
+	void make_response(std::vector<std::uint16_t> && values, response::read_holding_registers & response)  { response.values = std::move(values); }
+	void make_response(std::vector<std::uint16_t> && values, response::read_input_registers & response)    { response.values = std::move(values); }
+}
+
+/// Construct a proxy.
+proxy::proxy(asio::io_context & io_context) : server(io_context), client(io_context) {
+	client.coalesce_reads = true;
+
+	server.on_read_coils               = std::bind(&proxy::read<request::read_coils>,                this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_discrete_inputs     = std::bind(&proxy::read<request::read_discrete_inputs>,      this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_holding_registers   = std::bind(&proxy::read<request::read_holding_registers>,    this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_input_registers     = std::bind(&proxy::read<request::read_input_registers>,      this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_single_coil        = std::bind(&proxy::write<request::write_single_coil>,        this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_single_register    = std::bind(&proxy::write<request::write_single_register>,    this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_multiple_coils     = std::bind(&proxy::write<request::write_multiple_coils>,     this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_multiple_registers = std::bind(&proxy::write<request::write_multiple_registers>, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_mask_write_register      = std::bind(&proxy::write<request::mask_write_register>,      this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_write_multiple_registers = std::bind(&proxy::write<request::read_write_multiple_registers>, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_file_record         = std::bind(&proxy::pass<request::read_file_record>,          this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_write_file_record        = std::bind(&proxy::pass<request::write_file_record>,         this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	server.on_read_fifo_queue          = std::bind(&proxy::pass<request::read_fifo_queue>,           this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+}
+
+/// Stop accepting upstream connections and close all connections.
+void proxy::close() {
+	server.close();
+	client.close();
+}
+
+/// Remove all values from the cache.
+void proxy::clear_cache() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto & table : tables) {
+		for (auto & block : table.second.blocks) block.reset();
+		++table.second.generation;
+	}
+}
+
+/// Answer a read from the cache or forward it.
+template<typename T>
+void proxy::read(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply) {
+	std::uint8_t  table = table_of(request);
+	std::uint16_t key   = header.unit << 8 | table;
+
+	std::vector<std::uint16_t> values;
+	if (request.count > 0 && request.count <= max_count(table) && lookup(key, request.address, request.count, values)) {
+		++hits;
+		typename T::response response;
+		make_response(std::move(values), response);
+		return reply(response);
+	}
+
+	++misses;
+	std::uint64_t generation = this->generation(key);
+	std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+	impl::send(client, header.unit, request, [this, key, generation, sent, request, reply] (tcp_mbap const &, typename T::response const & response, std::error_code const & error) {
+		if (!error) store(key, generation, sent, request.address, to_values(response, request.count));
+		reply(response, impl::gateway_error(error));
+	});
+}
+
+/// Forward a write and invalidate the written range.
+template<typename T>
+void proxy::write(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply) {
+	std::uint16_t key     = header.unit << 8 | table_of(request);
+	std::uint16_t address = written_address(request);
+	std::uint16_t count   = written_count(request);
+
+	// Invalidate again when the write completes, in case a read refilled the range in the mean time.
+	invalidate(key, address, count);
+	impl::send(client, header.unit, request, [this, key, address, count, reply] (tcp_mbap const &, typename T::response const & response, std::error_code const & error) {
+		invalidate(key, address, count);
+		reply(response, impl::gateway_error(error));
+	});
+}
+
+/// Forward a request that does not touch the cached tables.
+template<typename T>
+void proxy::pass(tcp_mbap const & header, T const & request, server::reply<typename T::response> const & reply) {
+	impl::send(client, header.unit, request, [reply] (tcp_mbap const &, typename T::response const & response, std::error_code const & error) {
+		reply(response, impl::gateway_error(error));
+	});
+}
+
+/// Get the cached values of a range if they are all fresh.
+bool proxy::lookup(std::uint16_t key, std::uint16_t address, std::uint16_t count, std::vector<std::uint16_t> & values) {
+	if (max_age.count() <= 0) return false;
+	std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::now() - max_age;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto table = tables.find(key);
+	if (table == tables.end()) return false;
+
+	values.reserve(count);
+	for (std::uint32_t index = address; index < std::uint32_t(address) + count; ++index) {
+		if (index > 0xffff) return false;
+		block const * cached = table->second.blocks[index / block_size].get();
+		if (!cached || cached->updated[index % block_size] < oldest) return false;
+		values.push_back(cached->values[index % block_size]);
+	}
+	return true;
+}
+
+/// Get the current generation of a table.
+std::uint64_t proxy::generation(std::uint16_t key) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return tables[key].generation;
+}
+
+/// Store read values, unless the table was invalidated since the read was sent.
+void proxy::store(std::uint16_t key, std::uint64_t generation, std::chrono::steady_clock::time_point sent, std::uint16_t address, std::vector<std::uint16_t> const & values) {
+	if (max_age.count() <= 0) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	table & cached = tables[key];
+	if (cached.generation != generation) return;
+	for (std::size_t i = 0; i < values.size() && address + i <= 0xffff; ++i) {
+		std::unique_ptr<block> & target = cached.blocks[(address + i) / block_size];
+		if (!target) target.reset(new block());
+		target->values[(address + i) % block_size]  = values[i];
+		target->updated[(address + i) % block_size] = sent;
+	}
+}
+
+/// Remove a range from the cache.
+void proxy::invalidate(std::uint16_t key, std::uint16_t address, std::uint16_t count) {
+	std::lock_guard<std::mutex> lock(mutex);
+	table & cached = tables[key];
+	++cached.generation;
+
+	for (std::uint32_t index = address; index < std::uint32_t(address) + count && index <= 0xffff; ++index) {
+		block * target = cached.blocks[index / block_size].get();
+		if (target) target->updated[index % block_size] = std::chrono::steady_clock::time_point::min();
+	}
+}
+
+}
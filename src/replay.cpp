@@ -0,0 +1,496 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <asio/connect.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/write.hpp>
+
+#include "functions.hpp"
+#include "latency_histogram.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "tcp.hpp"
+#include "impl/deserialize.hpp"
+#include "impl/pcap.hpp"
+
+namespace {
+	using clock = std::chrono::steady_clock;
+	using tcp   = asio::ip::tcp;
+
+	/// An IPv4 address and port.
+	using endpoint = std::pair<std::uint32_t, std::uint16_t>;
+
+	/// A captured Modbus/TCP frame.
+	struct frame {
+		/// Nanoseconds since the epoch of the packet that completed the frame.
+		std::uint64_t timestamp;
+
+		/// Index of the connection the frame was sent on.
+		std::size_t connection;
+
+		/// True if the frame was sent to the server.
+		bool request;
+
+		/// The MBAP header and PDU.
+		std::vector<std::uint8_t> data;
+	};
+
+	/// A captured TCP connection.
+	struct connection {
+		endpoint server;
+		endpoint client;
+
+		/// Received bytes that do not form a complete frame yet, per direction.
+		std::vector<std::uint8_t> to_server;
+		std::vector<std::uint8_t> to_client;
+	};
+
+	/// All frames of a capture file.
+	struct capture {
+		std::vector<frame> frames;
+		std::vector<connection> connections;
+
+		/// Number of bytes skipped because they did not start with a valid MBAP header.
+		std::uint64_t skipped = 0;
+	};
+
+	/// Read a capture file and split the TCP streams into Modbus/TCP frames.
+	/**
+	 * The server of a connection is the endpoint with the given port,
+	 * or the destination of the first packet of the connection if the port is zero.
+	 */
+	std::error_code read_capture(std::string const & path, std::uint16_t server_port, capture & result) {
+		modbus::impl::pcap_reader reader;
+		std::error_code error = reader.open(path);
+		if (error) return error;
+
+		// Connections are keyed by the lowest endpoint and the highest endpoint.
+		std::map<std::pair<endpoint, endpoint>, std::size_t> connections;
+
+		modbus::impl::pcap_frame packet;
+		while (reader.next(packet)) {
+			endpoint source{packet.source_address, packet.source_port};
+			endpoint destination{packet.destination_address, packet.destination_port};
+
+			auto key = std::minmax(source, destination);
+			auto found = connections.find(key);
+			if (found == connections.end()) {
+				connection connection;
+				bool source_is_server = server_port ? source.second == server_port : false;
+				connection.server = source_is_server ? source : destination;
+				connection.client = source_is_server ? destination : source;
+				found = connections.emplace(key, result.connections.size()).first;
+				result.connections.push_back(std::move(connection));
+			}
+
+			connection & connection = result.connections[found->second];
+			bool request = destination == connection.server;
+			std::vector<std::uint8_t> & buffer = request ? connection.to_server : connection.to_client;
+			buffer.insert(buffer.end(), packet.data, packet.data + packet.size);
+
+			// Cut all complete frames from the buffer.
+			std::size_t offset = 0;
+			while (buffer.size() - offset >= 7) {
+				std::uint8_t const * data = buffer.data() + offset;
+				std::uint16_t protocol = data[2] << 8 | data[3];
+				std::uint16_t length   = data[4] << 8 | data[5];
+
+				// Resynchronize on the next byte if this can not be an MBAP header.
+				if (protocol != 0 || length < 2 || length > 254) {
+					++offset;
+					++result.skipped;
+					continue;
+				}
+				if (buffer.size() - offset < std::size_t(6 + length)) break;
+
+				result.frames.push_back(frame{packet.timestamp, found->second, request, std::vector<std::uint8_t>(data, data + 6 + length)});
+				offset += 6 + length;
+			}
+			buffer.erase(buffer.begin(), buffer.begin() + offset);
+		}
+
+		return std::error_code();
+	}
+
+	/// Deserialize a PDU and check that it spans the whole frame.
+	template<typename T>
+	bool decode(std::uint8_t const * data, std::size_t length) {
+		T message;
+		std::error_code error;
+		std::uint8_t const * end = modbus::impl::deserialize(data, length, message, error);
+		return !error && std::size_t(end - data) == length;
+	}
+
+	/// Deserialize a request or response PDU by function code.
+	/**
+	 * \return True if the PDU is valid, false if it is invalid or the function is not supported.
+	 */
+	bool decode_pdu(bool request, std::uint8_t const * data, std::size_t length) {
+		using namespace modbus;
+		switch (data[0]) {
+			case functions::read_coils:               return request ? decode<request::read_coils              >(data, length) : decode<response::read_coils              >(data, length);
+			case functions::read_discrete_inputs:     return request ? decode<request::read_discrete_inputs    >(data, length) : decode<response::read_discrete_inputs    >(data, length);
+			case functions::read_holding_registers:   return request ? decode<request::read_holding_registers  >(data, length) : decode<response::read_holding_registers  >(data, length);
+			case functions::read_input_registers:     return request ? decode<request::read_input_registers    >(data, length) : decode<response::read_input_registers    >(data, length);
+			case functions::write_single_coil:        return request ? decode<request::write_single_coil       >(data, length) : decode<response::write_single_coil       >(data, length);
+			case functions::write_single_register:    return request ? decode<request::write_single_register   >(data, length) : decode<response::write_single_register   >(data, length);
+			case functions::write_multiple_coils:     return request ? decode<request::write_multiple_coils    >(data, length) : decode<response::write_multiple_coils    >(data, length);
+			case functions::write_multiple_registers: return request ? decode<request::write_multiple_registers>(data, length) : decode<response::write_multiple_registers>(data, length);
+			case functions::mask_write_register:      return request ? decode<request::mask_write_register     >(data, length) : decode<response::mask_write_register     >(data, length);
+			case functions::read_write_multiple_registers:
+				return request ? decode<request::read_write_multiple_registers>(data, length) : decode<response::read_write_multiple_registers>(data, length);
+			case functions::read_file_record:         return request ? decode<request::read_file_record        >(data, length) : decode<response::read_file_record        >(data, length);
+			case functions::write_file_record:        return request ? decode<request::write_file_record       >(data, length) : decode<response::write_file_record       >(data, length);
+			case functions::read_fifo_record:         return request ? decode<request::read_fifo_queue         >(data, length) : decode<response::read_fifo_queue         >(data, length);
+			default:
+				// Exception responses are a function code with the high bit set and an exception code.
+				return !request && data[0] >= 0x80 && length == 2;
+		}
+	}
+
+	/// Deserialize a complete frame.
+	bool decode_frame(frame const & frame) {
+		modbus::tcp_mbap header;
+		std::error_code error;
+		std::uint8_t const * pdu = modbus::impl::deserialize(frame.data.data(), frame.data.size(), header, error);
+		if (error) return false;
+		return decode_pdu(frame.request, pdu, frame.data.size() - 7);
+	}
+
+	/// Feed all frames through the deserializers and report the results.
+	void decode_capture(capture const & capture) {
+		std::uint64_t requests = 0, responses = 0, exceptions = 0;
+		std::map<int, std::uint64_t> invalid;
+
+		for (frame const & frame : capture.frames) {
+			(frame.request ? requests : responses) += 1;
+			if (!frame.request && frame.data[7] >= 0x80) ++exceptions;
+			if (!decode_frame(frame)) ++invalid[frame.data[7]];
+		}
+
+		// Decode the whole capture repeatedly to get a stable time per frame.
+		std::uint64_t decoded = 0;
+		clock::time_point start = clock::now();
+		clock::time_point end   = start;
+		while (!capture.frames.empty() && end - start < std::chrono::milliseconds(200)) {
+			for (frame const & frame : capture.frames) decode_frame(frame);
+			decoded += capture.frames.size();
+			end = clock::now();
+		}
+
+		std::cout << "connections:   " << capture.connections.size() << "\n";
+		std::cout << "requests:      " << requests   << "\n";
+		std::cout << "responses:     " << responses  << "\n";
+		std::cout << "exceptions:    " << exceptions << "\n";
+		std::cout << "skipped bytes: " << capture.skipped << "\n";
+		for (auto const & entry : invalid) {
+			std::cout << "invalid:       " << entry.second << " frames with function 0x" << std::hex << std::setw(2) << std::setfill('0') << entry.first << std::dec << std::setfill(' ') << "\n";
+		}
+		if (decoded) {
+			double ns = std::chrono::duration<double, std::nano>(end - start).count() / decoded;
+			std::cout << "decode time:   " << std::fixed << std::setprecision(1) << ns << " ns per frame\n";
+		}
+	}
+
+	/// Shared state of a replay against a server.
+	struct replay_state {
+		asio::io_context io_context;
+
+		/// Replay speed, or zero to send as fast as possible.
+		double speed;
+
+		/// Time without progress after which outstanding requests are given up.
+		std::chrono::milliseconds timeout;
+
+		/// Start of the replay.
+		clock::time_point start;
+
+		/// Timestamp of the first request in the capture.
+		std::uint64_t first_timestamp;
+
+		/// Time of the last sent request or received response.
+		clock::time_point last_activity;
+
+		modbus::latency_histogram latencies;
+		std::uint64_t sent       = 0;
+		std::uint64_t received   = 0;
+		std::uint64_t exceptions = 0;
+		std::uint64_t unmatched  = 0;
+		std::uint64_t errors     = 0;
+
+		/// Get the time at which a captured frame should be sent.
+		clock::time_point schedule(frame const & frame) const {
+			if (speed <= 0) return start;
+			return start + std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(frame.timestamp - first_timestamp) / speed);
+		}
+	};
+
+	/// Replay of the requests of one captured connection.
+	struct replay_session {
+		replay_state & state;
+		tcp::socket socket;
+		asio::steady_timer timer;
+		std::vector<frame const *> requests;
+		std::size_t next = 0;
+		asio::streambuf read_buffer;
+
+		/// Send times of outstanding requests by transaction ID.
+		std::map<std::uint16_t, std::deque<clock::time_point>> outstanding;
+		std::size_t outstanding_count = 0;
+
+		replay_session(replay_state & state) : state(state), socket(state.io_context), timer(state.io_context) {}
+
+		bool done() const {
+			return next == requests.size() && outstanding_count == 0;
+		}
+
+		void close() {
+			std::error_code error;
+			timer.cancel(error);
+			socket.close(error);
+		}
+
+		void fail(std::error_code const & error) {
+			if (error == asio::error::operation_aborted) return;
+			std::cerr << "Connection error: " << error.message() << "\n";
+			++state.errors;
+			close();
+		}
+
+		void start(tcp::resolver::results_type const & endpoints) {
+			asio::async_connect(socket, endpoints, [this] (std::error_code const & error, tcp::endpoint const &) {
+				if (error) return fail(error);
+				std::error_code ignored;
+				socket.set_option(tcp::no_delay(true), ignored);
+				read();
+				send_next();
+			});
+		}
+
+		void send_next() {
+			if (next == requests.size()) return;
+			timer.expires_at(state.schedule(*requests[next]));
+			timer.async_wait([this] (std::error_code const & error) {
+				if (error) return;
+				frame const & frame = *requests[next++];
+				std::uint16_t transaction = frame.data[0] << 8 | frame.data[1];
+				outstanding[transaction].push_back(clock::now());
+				++outstanding_count;
+				++state.sent;
+				state.last_activity = clock::now();
+
+				asio::async_write(socket, asio::buffer(frame.data), [this] (std::error_code const & error, std::size_t) {
+					if (error) return fail(error);
+					send_next();
+				});
+			});
+		}
+
+		void read() {
+			socket.async_read_some(read_buffer.prepare(4096), [this] (std::error_code const & error, std::size_t bytes_transferred) {
+				if (error) return fail(error);
+				read_buffer.commit(bytes_transferred);
+				clock::time_point now = clock::now();
+
+				while (read_buffer.size() >= 7) {
+					std::uint8_t const * data = asio::buffer_cast<std::uint8_t const *>(read_buffer.data());
+					std::size_t size = 6 + (data[4] << 8 | data[5]);
+					if (read_buffer.size() < size) break;
+
+					std::uint16_t transaction = data[0] << 8 | data[1];
+					auto found = outstanding.find(transaction);
+					if (found == outstanding.end()) {
+						++state.unmatched;
+					} else {
+						state.latencies.record(now - found->second.front());
+						found->second.pop_front();
+						if (found->second.empty()) outstanding.erase(found);
+						--outstanding_count;
+						++state.received;
+						if (size > 7 && data[7] >= 0x80) ++state.exceptions;
+					}
+					read_buffer.consume(size);
+				}
+
+				state.last_activity = now;
+				if (done()) return close();
+				read();
+			});
+		}
+	};
+
+	/// Close all sessions once they are done or made no progress for the timeout.
+	void watch(replay_state & state, asio::steady_timer & watchdog, std::vector<std::unique_ptr<replay_session>> & sessions) {
+		watchdog.expires_after(std::chrono::milliseconds(10));
+		watchdog.async_wait([&state, &watchdog, &sessions] (std::error_code const & error) {
+			if (error) return;
+			bool idle = clock::now() - state.last_activity > state.timeout;
+			bool busy = false;
+			for (auto & session : sessions) {
+				if (!session->socket.is_open()) continue;
+				bool waiting = session->next < session->requests.size();
+				if (!waiting && (idle || session->done())) {
+					session->close();
+				} else {
+					busy = true;
+				}
+			}
+			if (busy) watch(state, watchdog, sessions);
+		});
+	}
+
+	/// Replay the requests of a capture against a server and report the results.
+	int replay_capture(capture const & capture, std::string const & target, double speed, std::chrono::milliseconds timeout) {
+		std::size_t colon = target.rfind(':');
+		if (colon == std::string::npos) {
+			std::cerr << "Target must be given as host:port.\n";
+			return 1;
+		}
+
+		replay_state state;
+		state.speed   = speed;
+		state.timeout = timeout;
+
+		std::error_code error;
+		tcp::resolver resolver(state.io_context);
+		tcp::resolver::results_type endpoints = resolver.resolve(target.substr(0, colon), target.substr(colon + 1), error);
+		if (error) {
+			std::cerr << "Failed to resolve " << target << ": " << error.message() << "\n";
+			return 1;
+		}
+
+		// Every captured connection is replayed on its own connection, to keep the order of its requests.
+		std::vector<std::unique_ptr<replay_session>> sessions;
+		for (std::size_t i = 0; i < capture.connections.size(); ++i) sessions.emplace_back(new replay_session(state));
+
+		bool first = true;
+		for (frame const & frame : capture.frames) {
+			if (!frame.request) continue;
+			if (first) state.first_timestamp = frame.timestamp;
+			first = false;
+			sessions[frame.connection]->requests.push_back(&frame);
+		}
+
+		state.start         = clock::now();
+		state.last_activity = state.start;
+		for (auto & session : sessions) {
+			if (!session->requests.empty()) session->start(endpoints);
+		}
+
+		asio::steady_timer watchdog(state.io_context);
+		watch(state, watchdog, sessions);
+		state.io_context.run();
+		double seconds = std::chrono::duration<double>(clock::now() - state.start).count();
+
+		std::cout << "sent:       " << state.sent       << "\n";
+		std::cout << "received:   " << state.received   << "\n";
+		std::cout << "exceptions: " << state.exceptions << "\n";
+		std::cout << "unmatched:  " << state.unmatched  << "\n";
+		std::cout << "missing:    " << state.sent - state.received << "\n";
+		std::cout << "errors:     " << state.errors     << "\n";
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "rate:       " << state.received / seconds << " responses/s\n";
+		std::cout << "latency:    p50 "  << state.latencies.percentile(0.5).count()   / 1e3
+			<< " us, p99 "  << state.latencies.percentile(0.99).count()  / 1e3
+			<< " us, p999 " << state.latencies.percentile(0.999).count() / 1e3
+			<< " us, max "  << state.latencies.maximum().count()         / 1e3 << " us\n";
+		return state.errors ? 1 : 0;
+	}
+
+	void usage(char const * name) {
+		std::cerr << "Usage: " << name << " FILE [--port=PORT] [--target=HOST:PORT] [--speed=FACTOR] [--timeout=MS]\n"
+			<< "Without a target, all frames are decoded and checked.\n"
+			<< "With a target, the requests are sent to that server with the captured timing, scaled by the speed factor.\n"
+			<< "A speed of 0 sends the requests as fast as possible.\n";
+	}
+}
+
+/// Usage: modbus_replay FILE [--port=PORT] [--target=HOST:PORT] [--speed=FACTOR] [--timeout=MS]
+int main(int argc, char * * argv) {
+	std::string path;
+	std::string target;
+	std::uint16_t port = 0;
+	double speed = 1;
+	std::chrono::milliseconds timeout{1000};
+
+	for (int i = 1; i < argc; ++i) {
+		char const * value = std::strchr(argv[i], '=');
+		if (!value) {
+			if (!path.empty()) {
+				usage(argv[0]);
+				return 1;
+			}
+			path = argv[i];
+			continue;
+		}
+		std::string option(argv[i], value - argv[i]);
+		++value;
+		if      (option == "--port")    port    = std::atoi(value);
+		else if (option == "--target")  target  = value;
+		else if (option == "--speed")   speed   = std::atof(value);
+		else if (option == "--timeout") timeout = std::chrono::milliseconds(std::atoi(value));
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (path.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	capture capture;
+	std::error_code error = read_capture(path, port, capture);
+	if (error) {
+		std::cerr << "Failed to read " << path << ": " << error.message() << "\n";
+		return 1;
+	}
+
+	if (target.empty()) {
+		decode_capture(capture);
+		return 0;
+	}
+	return replay_capture(capture, target, speed, timeout);
+}
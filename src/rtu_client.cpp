@@ -0,0 +1,369 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <functional>
+#include <system_error>
+#include <utility>
+
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/write.hpp>
+
+#include "rtu_client.hpp"
+#include "error.hpp"
+#include "impl/rtu.hpp"
+#include "impl/serialize.hpp"
+
+namespace modbus {
+
+std::chrono::milliseconds const rtu_client::use_default_timeout{-1};
+
+/// Construct a client.
+rtu_client::rtu_client(asio::io_context & io_context) : strand(io_context.get_executor()), port(io_context), timeout_timer(io_context), gap_timer(io_context) {}
+
+/// Open a serial port.
+std::error_code rtu_client::open(std::string const & device, serial_settings const & settings) {
+	std::error_code error;
+	port.open(device, error);
+	if (error) return error;
+
+	using base = asio::serial_port_base;
+	if (!error) port.set_option(base::baud_rate(settings.baud_rate), error);
+	if (!error) port.set_option(base::character_size(8), error);
+	if (!error) port.set_option(base::parity(settings.parity), error);
+	if (!error) port.set_option(base::stop_bits(settings.stop_bits), error);
+	if (!error) port.set_option(base::flow_control(base::flow_control::none), error);
+	if (error) {
+		std::error_code ignored;
+		port.close(ignored);
+		return error;
+	}
+
+	impl::rtu_timing timing = impl::make_rtu_timing(
+		settings.baud_rate,
+		settings.parity != base::parity::none,
+		settings.stop_bits == base::stop_bits::two ? 4 : settings.stop_bits == base::stop_bits::onepointfive ? 3 : 2
+	);
+
+	_open = true;
+	asio::dispatch(strand, [this, timing] () {
+		character_time       = timing.character;
+		inter_character_time = timing.inter_character;
+		frame_gap            = timing.frame_gap;
+		bus_idle             = std::chrono::steady_clock::now() + frame_gap;
+		start_read();
+		start_next();
+	});
+	return error;
+}
+
+/// Close the serial port.
+void rtu_client::close() {
+	asio::dispatch(strand, std::bind(&rtu_client::close_, this, asio::error::operation_aborted));
+}
+
+/// Close the serial port and abort all transactions with an error.
+void rtu_client::close_(std::error_code const & error) {
+	std::error_code ignored;
+	timeout_timer.cancel(ignored);
+	gap_timer.cancel(ignored);
+	port.close(ignored);
+	_open       = false;
+	busy        = false;
+	waiting_gap = false;
+	++transaction_id;
+
+	// Take the queue first, since handlers may queue new requests.
+	std::deque<transaction_t> aborted;
+	std::swap(aborted, queue);
+	for (transaction_t & transaction : aborted) {
+		tcp_mbap header;
+		header.transaction = 0;
+		header.length      = 0;
+		header.unit        = transaction.unit;
+		transaction.handler(nullptr, 0, header, error);
+	}
+}
+
+/// Serialize a request and queue it.
+template<typename T>
+void rtu_client::send_message(std::uint8_t unit, T const & request, Handler handler, std::chrono::milliseconds timeout) {
+	transaction_t transaction;
+	transaction.unit     = unit;
+	transaction.function = request.function;
+	transaction.handler  = std::move(handler);
+	transaction.timeout  = timeout;
+
+	// Requests that do not fit in a frame are left empty and rejected in the strand.
+	if (1 + request.length() + 2 > impl::rtu_max_frame_size) {
+		transaction.size = 0;
+	} else {
+		std::uint8_t * out = transaction.frame.data();
+		*out++ = unit;
+		impl::serialize(out, request);
+		transaction.size = impl::append_rtu_crc(transaction.frame.data(), out) - transaction.frame.data();
+	}
+
+	asio::dispatch(strand, std::bind(&rtu_client::queue_transaction, this, std::move(transaction)));
+}
+
+/// Add a transaction to the queue and send it if the bus is idle.
+void rtu_client::queue_transaction(transaction_t & transaction) {
+	tcp_mbap header;
+	header.transaction = 0;
+	header.length      = 0;
+	header.unit        = transaction.unit;
+
+	if (transaction.size == 0) {
+		transaction.handler(nullptr, 0, header, modbus_error(errc::message_too_large));
+		return;
+	}
+
+	if (!port.is_open()) {
+		transaction.handler(nullptr, 0, header, asio::error::not_connected);
+		return;
+	}
+
+	if (transaction.unit == 0 && impl::rtu_broadcast_reply_size(transaction.function, transaction.size - 3) == 0) {
+		transaction.handler(nullptr, 0, header, modbus_error(errc::invalid_value));
+		return;
+	}
+
+	if (transaction.timeout == use_default_timeout) transaction.timeout = default_timeout;
+	queue.push_back(std::move(transaction));
+	start_next();
+}
+
+/// Send the next queued transaction if the bus is idle.
+void rtu_client::start_next() {
+	if (busy || waiting_gap || queue.empty() || !port.is_open()) return;
+
+	// Wait for the silence between frames, unless it already passed.
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now < bus_idle) {
+		waiting_gap = true;
+		gap_timer.expires_at(bus_idle);
+		gap_timer.async_wait(asio::bind_executor(strand, std::bind(&rtu_client::on_gap, this, std::placeholders::_1)));
+		return;
+	}
+
+	busy        = true;
+	write_start = now;
+
+	// Anything received before the request is sent can not be the reply.
+	read_size = 0;
+
+	transaction_t & transaction = queue.front();
+	if (transaction.timeout.count() > 0) {
+		timeout_timer.expires_after(transaction.timeout);
+		timeout_timer.async_wait(asio::bind_executor(strand, std::bind(&rtu_client::on_timeout, this, std::placeholders::_1, transaction_id)));
+	}
+
+	auto handler = asio::bind_executor(strand, std::bind(&rtu_client::on_write, this, std::placeholders::_1, transaction_id));
+	asio::async_write(port, asio::buffer(transaction.frame.data(), transaction.size), handler);
+}
+
+/// Finish the current transaction and invoke its handler.
+void rtu_client::finish_transaction(std::uint8_t const * pdu, std::size_t length, std::error_code const & error) {
+	std::error_code ignored;
+	timeout_timer.cancel(ignored);
+	++transaction_id;
+
+	// Take the transaction out of the queue first, since the handler may queue new requests or close the client.
+	transaction_t transaction = std::move(queue.front());
+	queue.pop_front();
+	read_size = 0;
+
+	tcp_mbap header;
+	header.transaction = 0;
+	header.length      = error ? 0 : length + 1;
+	header.unit        = transaction.unit;
+	transaction.handler(pdu, length, header, error);
+
+	busy = false;
+	start_next();
+}
+
+/// Start a read operation.
+void rtu_client::start_read() {
+	auto handler = asio::bind_executor(strand, std::bind(&rtu_client::on_read, this, std::placeholders::_1, std::placeholders::_2));
+	port.async_read_some(asio::buffer(read_buffer.data() + read_size, read_buffer.size() - read_size), handler);
+}
+
+/// Called when the serial port finished a read operation.
+void rtu_client::on_read(std::error_code const & error, std::size_t bytes_transferred) {
+	if (error == asio::error::operation_aborted) return;
+	if (error) {
+		if (on_io_error) on_io_error(error);
+		close_(error);
+		return;
+	}
+
+	// Every received byte restarts the silence before the next request, even if it is dropped.
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	bool broken = check_inter_character_timeout && read_size > 0 && now - last_read > inter_character_time;
+	last_read = now;
+	bus_idle  = std::max(bus_idle, now + frame_gap);
+
+	// Bytes received while no request is waiting for a reply are dropped.
+	read_size += bytes_transferred;
+	if (busy && broken) {
+		finish_transaction(nullptr, 0, modbus_error(errc::message_size_mismatch));
+	} else if (busy) {
+		process_reply();
+	} else {
+		read_size = 0;
+	}
+
+	if (port.is_open()) start_read();
+}
+
+/// Called when the serial port finished writing a request.
+void rtu_client::on_write(std::error_code const & error, std::uint64_t id) {
+	if (error == asio::error::operation_aborted || id != transaction_id) return;
+	if (error) {
+		if (on_io_error) on_io_error(error);
+		close_(error);
+		return;
+	}
+
+	// The port may return before the request left the wire, so estimate the end of the transmission.
+	transaction_t const & transaction = queue.front();
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point sent = std::max(now, write_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(character_time * transaction.size));
+	bus_idle = std::max(bus_idle, sent + frame_gap);
+
+	// Broadcasts are not answered, so complete them with the reply a server would have sent.
+	if (transaction.unit == 0) {
+		bus_idle = std::max(bus_idle, sent + std::max<std::chrono::steady_clock::duration>(frame_gap, broadcast_delay));
+
+		std::array<std::uint8_t, impl::rtu_max_frame_size> reply;
+		std::size_t length = impl::rtu_broadcast_reply_size(transaction.function, transaction.size - 3);
+		std::copy(transaction.frame.begin() + 1, transaction.frame.begin() + 1 + length, reply.begin());
+		finish_transaction(reply.data(), length, std::error_code());
+	}
+}
+
+/// Called when the silence between frames has passed.
+void rtu_client::on_gap(std::error_code const & error) {
+	if (error || !waiting_gap) return;
+	waiting_gap = false;
+	start_next();
+}
+
+/// Called when the reply timeout expires.
+void rtu_client::on_timeout(std::error_code const & error, std::uint64_t id) {
+	if (error || id != transaction_id || !busy) return;
+	finish_transaction(nullptr, 0, modbus_error(errc::transaction_timeout));
+}
+
+/// Try to frame the reply to the current transaction from the read buffer.
+void rtu_client::process_reply() {
+	transaction_t const & transaction = queue.front();
+
+	std::error_code error;
+	std::size_t size = impl::rtu_response_size(transaction.function, read_buffer.data(), read_size, error);
+	if (error) return finish_transaction(nullptr, 0, error);
+
+	if (size == 0 || read_size < size) {
+		// The buffer can hold any valid frame, so a full buffer means the reply is garbage.
+		if (read_size == read_buffer.size()) finish_transaction(nullptr, 0, modbus_error(errc::message_too_large));
+		return;
+	}
+
+	if (!impl::check_rtu_crc(read_buffer.data(), size)) return finish_transaction(nullptr, 0, modbus_error(errc::crc_mismatch));
+	if (read_buffer[0] != transaction.unit) return finish_transaction(nullptr, 0, modbus_error(errc::invalid_value));
+
+	// Strip the unit ID and CRC, bytes after the frame are dropped.
+	finish_transaction(read_buffer.data() + 1, size - 3, std::error_code());
+}
+
+/// Read a number of coils from a server.
+void rtu_client::read_coils(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_coils> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_coils{address, count}, client::make_handler<response::read_coils>(callback), timeout);
+}
+
+/// Read a number of discrete inputs from a server.
+void rtu_client::read_discrete_inputs(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_discrete_inputs> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_discrete_inputs{address, count}, client::make_handler<response::read_discrete_inputs>(callback), timeout);
+}
+
+/// Read a number of holding registers from a server.
+void rtu_client::read_holding_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_holding_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_holding_registers{address, count}, client::make_handler<response::read_holding_registers>(callback), timeout);
+}
+
+/// Read a number of input registers from a server.
+void rtu_client::read_input_registers(std::uint8_t unit, std::uint16_t address, std::uint16_t count, Callback<response::read_input_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_input_registers{address, count}, client::make_handler<response::read_input_registers>(callback), timeout);
+}
+
+/// Write to a single coil on a server.
+void rtu_client::write_single_coil(std::uint8_t unit, std::uint16_t address, bool value, Callback<response::write_single_coil> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_single_coil{address, value}, client::make_handler<response::write_single_coil>(callback), timeout);
+}
+
+/// Write to a single register on a server.
+void rtu_client::write_single_register(std::uint8_t unit, std::uint16_t address, std::uint16_t value, Callback<response::write_single_register> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_single_register{address, value}, client::make_handler<response::write_single_register>(callback), timeout);
+}
+
+/// Write to a number of coils on a server.
+void rtu_client::write_multiple_coils(std::uint8_t unit, std::uint16_t address, bit_vector values, Callback<response::write_multiple_coils> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_multiple_coils{address, std::move(values)}, client::make_handler<response::write_multiple_coils>(callback), timeout);
+}
+
+/// Write to a number of registers on a server.
+void rtu_client::write_multiple_registers(std::uint8_t unit, std::uint16_t address, std::vector<std::uint16_t> values, Callback<response::write_multiple_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_multiple_registers{address, std::move(values)}, client::make_handler<response::write_multiple_registers>(callback), timeout);
+}
+
+/// Perform a masked write to a register on a server.
+void rtu_client::mask_write_register(std::uint8_t unit, std::uint16_t address, std::uint16_t and_mask, std::uint16_t or_mask, Callback<response::mask_write_register> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::mask_write_register{address, and_mask, or_mask}, client::make_handler<response::mask_write_register>(callback), timeout);
+}
+
+/// Write to and then read from a number of registers on a server in one transaction.
+void rtu_client::read_write_multiple_registers(std::uint8_t unit, std::uint16_t read_address, std::uint16_t read_count, std::uint16_t write_address, std::vector<std::uint16_t> values, Callback<response::read_write_multiple_registers> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_write_multiple_registers{read_address, read_count, write_address, std::move(values)}, client::make_handler<response::read_write_multiple_registers>(callback), timeout);
+}
+
+/// Read a number of file records from a server.
+void rtu_client::read_file_record(std::uint8_t unit, std::vector<file_record_reference> records, Callback<response::read_file_record> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_file_record{std::move(records)}, client::make_handler<response::read_file_record>(callback), timeout);
+}
+
+/// Write a number of file records on a server.
+void rtu_client::write_file_record(std::uint8_t unit, std::vector<file_record> records, Callback<response::write_file_record> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::write_file_record{std::move(records)}, client::make_handler<response::write_file_record>(callback), timeout);
+}
+
+/// Read the contents of a FIFO queue from a server.
+void rtu_client::read_fifo_queue(std::uint8_t unit, std::uint16_t address, Callback<response::read_fifo_queue> const & callback, std::chrono::milliseconds timeout) {
+	send_message(unit, request::read_fifo_queue{address}, client::make_handler<response::read_fifo_queue>(callback), timeout);
+}
+
+}
@@ -0,0 +1,427 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <functional>
+#include <system_error>
+
+#include <asio/bind_executor.hpp>
+#include <asio/dispatch.hpp>
+#include <asio/streambuf.hpp>
+
+#include "server.hpp"
+#include "error.hpp"
+#include "impl/serialize.hpp"
+#include "impl/deserialize.hpp"
+
+namespace modbus {
+
+namespace {
+	/// Get the exception code to send for an error.
+	std::uint8_t exception_code(std::error_code const & error) {
+		if (error.category() == modbus_category() && error.value() > 0 && error.value() < 0x80) return error.value();
+		return errc::server_device_failure;
+	}
+
+	/// Check if the quantity of a request is within the limits of the Modbus specification.
+	/**
+	 * Requests without a quantity are always valid.
+	 */
+	template<typename T>
+	bool valid_quantity(T const &) {
+		return true;
+	}
+
+	bool valid_quantity(request::read_coils const & request)               { return request.count >= 1 && request.count <= 2000; }
+	bool valid_quantity(request::read_discrete_inputs const & request)     { return request.count >= 1 && request.count <= 2000; }
+	bool valid_quantity(request::read_holding_registers const & request)   { return request.count >= 1 && request.count <= 125;  }
+	bool valid_quantity(request::read_input_registers const & request)     { return request.count >= 1 && request.count <= 125;  }
+	bool valid_quantity(request::write_multiple_coils const & request)     { return request.values.size() >= 1 && request.values.size() <= 1968; }
+	bool valid_quantity(request::write_multiple_registers const & request) { return request.values.size() >= 1 && request.values.size() <= 123;  }
+
+	bool valid_quantity(request::read_write_multiple_registers const & request) {
+		return request.read_count >= 1 && request.read_count <= 125 && request.values.size() >= 1 && request.values.size() <= 121;
+	}
+}
+
+/// A connection with a Modbus/TCP client.
+class server::connection : public std::enable_shared_from_this<server::connection> {
+public:
+	/// The server that accepted the connection.
+	server & parent;
+
+	/// Strand to use to prevent concurrent handler execution.
+	asio::strand<asio::io_context::executor_type> strand;
+
+	/// The socket to use.
+	tcp::socket socket;
+
+	/// The ID of the connection.
+	std::uint64_t id = 0;
+
+	/// Buffer for read operations.
+	asio::streambuf read_buffer;
+
+	/// Buffer for write operations.
+	asio::streambuf write_buffer;
+
+	/// The local endpoint of the connection, recorded in the capture file.
+	tcp::endpoint capture_local;
+
+	/// The remote endpoint of the connection, recorded in the capture file.
+	tcp::endpoint capture_remote;
+
+	/// Indicates if a write operation is busy.
+	bool writing = false;
+
+	/// Indicates if requests from the read buffer are being dispatched.
+	/**
+	 * During this time, replies are only buffered.
+	 * The write buffer is flushed once all requests have been dispatched.
+	 */
+	bool dispatching = false;
+
+	/// Construct a connection.
+	connection(server & parent, asio::io_context::executor_type executor) : parent(parent), strand(executor), socket(executor) {}
+
+	/// Start the read loop.
+	void start();
+
+	/// Close the connection.
+	void close();
+
+	/// Called when the socket finished a read operation.
+	void on_read(std::error_code const & error, std::size_t bytes_transferred);
+
+	/// Called when the socket finished a write operation.
+	void on_write(std::error_code const & error, std::size_t bytes_transferred);
+
+	/// Report an IO error and remove the connection from the server.
+	void on_error(std::error_code const & error);
+
+	/// Parse and dispatch a request from the read buffer.
+	/**
+	 * \return True if a request was parsed succesfully, false if there was not enough data.
+	 */
+	bool process_message();
+
+	/// Dispatch a request to a handler.
+	template<typename T>
+	void dispatch(tcp_mbap const & header, std::uint8_t const * data, std::size_t length, Handler<T> const & handler);
+
+	/// Send a response to the client.
+	template<typename T>
+	void send_response(tcp_mbap const & header, T const & response);
+
+	/// Send an exception response to the client.
+	void send_exception(tcp_mbap const & header, std::uint8_t function, std::uint8_t exception);
+
+	/// Flush the write buffer.
+	/**
+	 * Does nothing if a write operation is still busy or if requests are being dispatched.
+	 */
+	void flush_write_buffer();
+};
+
+/// Send the response to the client.
+template<typename T>
+void server::reply<T>::operator() (T const & response, std::error_code const & error) const {
+	std::shared_ptr<server::connection> connection = _connection;
+	tcp_mbap header = _header;
+
+	if (error) {
+		std::uint8_t exception = exception_code(error);
+		asio::dispatch(connection->strand, [connection, header, exception] () {
+			connection->send_exception(header, T::function, exception);
+		});
+	} else {
+		asio::dispatch(connection->strand, [connection, header, response] () {
+			connection->send_response(header, response);
+		});
+	}
+}
+
+/// Get the ID of the connection the request arrived on.
+template<typename T>
+std::uint64_t server::reply<T>::connection_id() const {
+	return _connection->id;
+}
+
+template class server::reply<response::read_coils>;
+template class server::reply<response::read_discrete_inputs>;
+template class server::reply<response::read_holding_registers>;
+template class server::reply<response::read_input_registers>;
+template class server::reply<response::write_single_coil>;
+template class server::reply<response::write_single_register>;
+template class server::reply<response::write_multiple_coils>;
+template class server::reply<response::write_multiple_registers>;
+template class server::reply<response::mask_write_register>;
+template class server::reply<response::read_write_multiple_registers>;
+template class server::reply<response::read_file_record>;
+template class server::reply<response::write_file_record>;
+template class server::reply<response::read_fifo_queue>;
+
+/// Start the read loop.
+void server::connection::start() {
+	std::error_code error;
+	socket.set_option(tcp::no_delay(true), error);
+
+	if (parent.capture) {
+		capture_local  = socket.local_endpoint(error);
+		capture_remote = socket.remote_endpoint(error);
+	}
+
+	auto handler = asio::bind_executor(strand, std::bind(&connection::on_read, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+	socket.async_read_some(read_buffer.prepare(1024), handler);
+}
+
+/// Close the connection.
+void server::connection::close() {
+	auto self = shared_from_this();
+	asio::dispatch(strand, [self] () {
+		std::error_code error;
+		self->socket.shutdown(tcp::socket::shutdown_both, error);
+		self->socket.close(error);
+	});
+}
+
+/// Called when the socket finished a read operation.
+void server::connection::on_read(std::error_code const & error, std::size_t bytes_transferred) {
+	if (error) return on_error(error);
+
+	read_buffer.commit(bytes_transferred);
+
+	// Parse and dispatch all complete requests in the buffer.
+	dispatching = true;
+	while (socket.is_open() && process_message());
+	dispatching = false;
+	flush_write_buffer();
+
+	if (!socket.is_open()) return;
+
+	// Read more data.
+	auto handler = asio::bind_executor(strand, std::bind(&connection::on_read, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+	socket.async_read_some(read_buffer.prepare(1024), handler);
+}
+
+/// Called when the socket finished a write operation.
+void server::connection::on_write(std::error_code const & error, std::size_t bytes_transferred) {
+	writing = false;
+	if (error) return on_error(error);
+
+	write_buffer.consume(bytes_transferred);
+	flush_write_buffer();
+}
+
+/// Report an IO error and remove the connection from the server.
+void server::connection::on_error(std::error_code const & error) {
+	// Regular disconnects and local cancellation are not reported.
+	if (error != asio::error::eof && error != asio::error::operation_aborted && error != asio::error::connection_reset) {
+		if (parent.on_io_error) parent.on_io_error(error);
+	}
+
+	std::error_code ignored;
+	socket.close(ignored);
+	parent.remove(shared_from_this());
+}
+
+/// Parse and dispatch a request from the read buffer.
+bool server::connection::process_message() {
+	/// Modbus/TCP MBAP header is 7 bytes.
+	if (read_buffer.size() < 7) return false;
+
+	std::uint8_t const * frame = asio::buffer_cast<std::uint8_t const *>(read_buffer.data());
+
+	std::error_code error;
+	tcp_mbap header;
+	std::uint8_t const * data = impl::deserialize(frame, read_buffer.size(), header, error);
+
+	// A bad MBAP header means we can not find the start of the next request anymore.
+	// Length includes the unit ID and must fit atleast a function code, but no more than a maximum size PDU.
+	if (!error && header.protocol != 0) error = modbus_error(errc::invalid_value);
+	if (!error && (header.length < 2 || header.length > 254)) error = modbus_error(errc::message_size_mismatch);
+	if (error) {
+		on_error(error);
+		return false;
+	}
+
+	// Ensure entire message is in buffer.
+	if (read_buffer.size() < std::size_t(6 + header.length)) return false;
+
+	if (parent.capture) parent.capture->record(capture_local, capture_remote, capture_file::direction::incoming, frame, 6 + header.length);
+
+	std::size_t length = header.length - 1;
+	switch (*data) {
+		case functions::read_coils:               dispatch(header, data, length, parent.on_read_coils);               break;
+		case functions::read_discrete_inputs:     dispatch(header, data, length, parent.on_read_discrete_inputs);     break;
+		case functions::read_holding_registers:   dispatch(header, data, length, parent.on_read_holding_registers);   break;
+		case functions::read_input_registers:     dispatch(header, data, length, parent.on_read_input_registers);     break;
+		case functions::write_single_coil:        dispatch(header, data, length, parent.on_write_single_coil);        break;
+		case functions::write_single_register:    dispatch(header, data, length, parent.on_write_single_register);    break;
+		case functions::write_multiple_coils:     dispatch(header, data, length, parent.on_write_multiple_coils);     break;
+		case functions::write_multiple_registers: dispatch(header, data, length, parent.on_write_multiple_registers); break;
+		case functions::mask_write_register:      dispatch(header, data, length, parent.on_mask_write_register);      break;
+		case functions::read_write_multiple_registers: dispatch(header, data, length, parent.on_read_write_multiple_registers); break;
+		case functions::read_file_record:         dispatch(header, data, length, parent.on_read_file_record);         break;
+		case functions::write_file_record:        dispatch(header, data, length, parent.on_write_file_record);        break;
+		case functions::read_fifo_record:         dispatch(header, data, length, parent.on_read_fifo_queue);          break;
+		default:                                  send_exception(header, *data, errc::illegal_function);              break;
+	}
+
+	// Remove the handled request from the read buffer.
+	read_buffer.consume(6 + header.length);
+	return true;
+}
+
+/// Dispatch a request to a handler.
+template<typename T>
+void server::connection::dispatch(tcp_mbap const & header, std::uint8_t const * data, std::size_t length, Handler<T> const & handler) {
+	if (!handler) return send_exception(header, T::function, errc::illegal_function);
+
+	T request;
+	std::error_code error;
+	std::uint8_t const * end = impl::deserialize(data, length, request, error);
+
+	// The request must be well-formed and span the entire PDU.
+	if (!error && std::size_t(end - data) != length) error = modbus_error(errc::message_size_mismatch);
+	if (error) return send_exception(header, T::function, errc::illegal_data_value);
+
+	// Quantities outside the limits of the specification would not fit in a response.
+	if (!valid_quantity(request)) return send_exception(header, T::function, errc::illegal_data_value);
+
+	handler(header, request, reply<typename T::response>{shared_from_this(), header});
+}
+
+/// Send a response to the client.
+template<typename T>
+void server::connection::send_response(tcp_mbap const & request_header, T const & response) {
+	if (!socket.is_open()) return;
+
+	tcp_mbap header = request_header;
+	header.length   = response.length() + 1; // Unit ID is also counted in length field.
+
+	// Serialize straight into the write buffer, so the contiguous overloads are used.
+	std::size_t size = 7 + response.length();
+	std::uint8_t * frame = asio::buffer_cast<std::uint8_t *>(write_buffer.prepare(size));
+	std::uint8_t * out   = frame;
+	impl::serialize(out, header);
+	impl::serialize(out, response);
+	write_buffer.commit(size);
+	if (parent.capture) parent.capture->record(capture_local, capture_remote, capture_file::direction::outgoing, frame, size);
+	flush_write_buffer();
+}
+
+/// Send an exception response to the client.
+void server::connection::send_exception(tcp_mbap const & request_header, std::uint8_t function, std::uint8_t exception) {
+	if (!socket.is_open()) return;
+
+	tcp_mbap header = request_header;
+	header.length   = 3; // Unit ID, function code and exception code.
+
+	auto out = std::ostreambuf_iterator<char>(&write_buffer);
+	impl::serialize(out, header);
+	impl::serialize_exception(out, function, exception);
+	if (parent.capture) {
+		// The streambuf keeps its data contiguous, so the exception response is at the end.
+		std::uint8_t const * end = asio::buffer_cast<std::uint8_t const *>(write_buffer.data()) + write_buffer.size();
+		parent.capture->record(capture_local, capture_remote, capture_file::direction::outgoing, end - 9, 9);
+	}
+	flush_write_buffer();
+}
+
+/// Flush the write buffer.
+void server::connection::flush_write_buffer() {
+	if (writing || dispatching || !write_buffer.size()) return;
+	writing = true;
+
+	auto handler = asio::bind_executor(strand, std::bind(&connection::on_write, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+	socket.async_write_some(write_buffer.data(), handler);
+}
+
+/// Construct a server.
+server::server(asio::io_context & io_context) : strand(io_context.get_executor()), acceptor(io_context) {}
+
+/// Start listening for connections on an endpoint.
+std::error_code server::listen(tcp::endpoint const & endpoint) {
+	std::error_code error;
+	acceptor.open(endpoint.protocol(), error);
+	if (error) return error;
+
+	acceptor.set_option(tcp::acceptor::reuse_address(true), error);
+	if (!error) acceptor.bind(endpoint, error);
+	if (!error) acceptor.listen(asio::socket_base::max_listen_connections, error);
+	if (error) {
+		std::error_code ignored;
+		acceptor.close(ignored);
+		return error;
+	}
+
+	asio::dispatch(strand, std::bind(&server::accept, this));
+	return error;
+}
+
+/// Stop accepting connections and close all open connections.
+void server::close() {
+	asio::dispatch(strand, [this] () {
+		std::error_code error;
+		acceptor.close(error);
+		for (auto const & connection : connections) {
+			connection->close();
+			if (on_disconnect) on_disconnect(connection->id);
+		}
+		connections.clear();
+	});
+}
+
+/// Start an asynchronous accept operation.
+void server::accept() {
+	auto connection = std::make_shared<server::connection>(*this, strand.get_inner_executor());
+	connection->id  = next_connection_id++;
+	auto handler    = asio::bind_executor(strand, std::bind(&server::on_accept, this, std::placeholders::_1, connection));
+	acceptor.async_accept(connection->socket, handler);
+}
+
+/// Called when the acceptor accepted a connection.
+void server::on_accept(std::error_code const & error, std::shared_ptr<connection> connection) {
+	if (error == asio::error::operation_aborted || !acceptor.is_open()) return;
+
+	if (error) {
+		if (on_io_error) on_io_error(error);
+	} else {
+		connections.insert(connection);
+		asio::dispatch(connection->strand, std::bind(&server::connection::start, connection));
+	}
+
+	accept();
+}
+
+/// Remove a closed connection from the connection set.
+void server::remove(std::shared_ptr<connection> const & connection) {
+	asio::dispatch(strand, [this, connection] () {
+		// The connection may already have been removed by close().
+		if (connections.erase(connection) && on_disconnect) on_disconnect(connection->id);
+	});
+}
+
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "impl/serialize_base.hpp"
+#include "impl/deserialize_base.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what, std::size_t count, std::size_t offset) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << " (count " << count << ", offset " << offset << ")\n";
+		++failures;
+	}
+
+	/// Pack booleans one bit at a time.
+	void reference_pack(bool const * values, std::size_t count, std::uint8_t * out) {
+		for (std::size_t i = 0; i < (count + 7) / 8; ++i) out[i] = 0;
+		for (std::size_t i = 0; i < count; ++i) if (values[i]) out[i / 8] |= 1 << (i % 8);
+	}
+
+	/// Unpack booleans one bit at a time.
+	void reference_unpack(std::uint8_t const * data, std::size_t count, bool * out) {
+		for (std::size_t i = 0; i < count; ++i) out[i] = data[i / 8] >> (i % 8) & 1;
+	}
+}
+
+/// Compare pack_bits and unpack_bits with a scalar reference.
+/**
+ * Every length up to 300 bits runs through the SIMD, 64 bit and scalar tail paths that are compiled in,
+ * and the input and output are placed at every offset in a word to test unaligned access.
+ */
+void test_kernels(std::mt19937 & random) {
+	std::size_t const max_count  = 300;
+	std::size_t const max_offset = 8;
+
+	for (std::size_t count = 0; count <= max_count; ++count) {
+		for (std::size_t offset = 0; offset < max_offset; ++offset) {
+			// Booleans with random values, and random packed bytes that use the high bits.
+			std::vector<bool> random_bits(count);
+			std::vector<std::uint8_t> random_bytes((count + 7) / 8);
+			for (std::size_t i = 0; i < count; ++i) random_bits[i] = random() & 1;
+			for (auto & byte : random_bytes) byte = random();
+
+			// Pack.
+			std::unique_ptr<bool[]> values(new bool[count + max_offset]);
+			for (std::size_t i = 0; i < count; ++i) values[offset + i] = random_bits[i];
+
+			std::vector<std::uint8_t> packed(max_offset + (count + 7) / 8, 0xaa);
+			std::vector<std::uint8_t> expected_packed((count + 7) / 8);
+			modbus::pack_bits(values.get() + offset, count, packed.data() + offset);
+			reference_pack(values.get() + offset, count, expected_packed.data());
+			check(std::equal(expected_packed.begin(), expected_packed.end(), packed.begin() + offset), "pack_bits", count, offset);
+
+			// Unpack.
+			std::vector<std::uint8_t> data(max_offset + random_bytes.size());
+			std::copy(random_bytes.begin(), random_bytes.end(), data.begin() + offset);
+
+			std::unique_ptr<bool[]> unpacked(new bool[count + max_offset]);
+			std::unique_ptr<bool[]> expected_unpacked(new bool[count]);
+			modbus::unpack_bits(data.data() + offset, count, unpacked.get() + offset);
+			reference_unpack(data.data() + offset, count, expected_unpacked.get());
+			check(std::equal(expected_unpacked.get(), expected_unpacked.get() + count, unpacked.get() + offset), "unpack_bits", count, offset);
+		}
+	}
+}
+
+/// Check that serializing a bit list writes the values, and that deserializing reads them back.
+void test_bit_list(std::mt19937 & random) {
+	for (std::size_t count = 1; count <= 1968; count += 7) {
+		std::vector<bool> values(count);
+		for (std::size_t i = 0; i < count; ++i) values[i] = random() & 1;
+
+		std::vector<std::uint8_t> expected((count + 7) / 8, 0);
+		for (std::size_t i = 0; i < count; ++i) if (values[i]) expected[i / 8] |= 1 << (i % 8);
+
+		// Serialize to a byte buffer and through an output iterator.
+		std::vector<std::uint8_t> buffer(expected.size());
+		std::uint8_t * out = buffer.data();
+		std::size_t written = modbus::impl::serialize_bit_list(out, modbus::bit_vector(values));
+		check(written == expected.size() && out == buffer.data() + buffer.size(), "serialize_bit_list size", count, 0);
+		check(buffer == expected, "serialize_bit_list", count, 0);
+
+		std::vector<std::uint8_t> appended;
+		auto inserter = std::back_inserter(appended);
+		modbus::impl::serialize_bit_list(inserter, modbus::bit_vector(values));
+		check(appended == expected, "serialize_bit_list iterator", count, 0);
+
+		// Deserialize from a byte buffer and from an input iterator.
+		std::error_code error;
+		modbus::bit_vector read;
+		modbus::impl::deserialize_bit_list(buffer.data(), buffer.size(), count, read, error);
+		check(!error && std::vector<bool>(read) == values, "deserialize_bit_list", count, 0);
+
+		modbus::bit_vector read_iterator;
+		modbus::impl::deserialize_bit_list(buffer.cbegin(), buffer.size(), count, read_iterator, error);
+		check(!error && std::vector<bool>(read_iterator) == values, "deserialize_bit_list iterator", count, 0);
+	}
+
+	// A list of only false values must serialize to zero bytes, not to set bits.
+	std::vector<std::uint8_t> buffer(2, 0xff);
+	std::uint8_t * out = buffer.data();
+	modbus::impl::serialize_bit_list(out, modbus::bit_vector(10, false));
+	check(buffer[0] == 0 && buffer[1] == 0, "serialize_bit_list all false", 10, 0);
+}
+
+int main() {
+	std::mt19937 random(0);
+
+	test_kernels(random);
+	test_bit_list(random);
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
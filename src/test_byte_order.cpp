@@ -0,0 +1,93 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "impl/byte_order.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what, std::size_t count, std::size_t offset) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << " (count " << count << ", offset " << offset << ")\n";
+		++failures;
+	}
+
+	/// Make a byte pattern that differs in every byte.
+	std::vector<std::uint8_t> pattern(std::size_t size) {
+		std::vector<std::uint8_t> result(size);
+		for (std::size_t i = 0; i < size; ++i) result[i] = std::uint8_t(i * 37 + 11);
+		return result;
+	}
+}
+
+/// Compare the byte swap kernels with a scalar reference.
+/**
+ * Counts up to 70 words cover the vector body, the 64 bit loop and the scalar tail of every compiled kernel.
+ * Byte buffers are placed at every offset in a word to test unaligned access.
+ */
+int main() {
+	std::size_t const max_count  = 70;
+	std::size_t const max_offset = 8;
+
+	for (std::size_t count = 0; count <= max_count; ++count) {
+		for (std::size_t offset = 0; offset < max_offset; ++offset) {
+			std::vector<std::uint8_t> bytes = pattern(max_offset + 2 * count + 2);
+
+			// Load big endian words from an unaligned buffer.
+			std::vector<std::uint16_t> words(count + 1, 0xaaaa);
+			modbus::impl::load_be16(words.data(), bytes.data() + offset, count);
+			bool loaded = words[count] == 0xaaaa;
+			for (std::size_t i = 0; i < count; ++i) loaded = loaded && words[i] == (bytes[offset + 2 * i] << 8 | bytes[offset + 2 * i + 1]);
+			check(loaded, "load_be16", count, offset);
+
+			// Store the words back to an unaligned buffer.
+			std::vector<std::uint8_t> stored(max_offset + 2 * count + 2, 0xaa);
+			modbus::impl::store_be16(stored.data() + offset, words.data(), count);
+			bool round_trip = stored[offset + 2 * count] == 0xaa && (offset == 0 || stored[offset - 1] == 0xaa);
+			for (std::size_t i = 0; i < 2 * count; ++i) round_trip = round_trip && stored[offset + i] == bytes[offset + i];
+			check(round_trip, "store_be16", count, offset);
+
+			// Swap in place.
+			std::vector<std::uint8_t> swapped = bytes;
+			modbus::impl::byteswap16(swapped.data() + offset, swapped.data() + offset, count);
+			bool in_place = swapped[offset + 2 * count] == bytes[offset + 2 * count] && (offset == 0 || swapped[offset - 1] == bytes[offset - 1]);
+			for (std::size_t i = 0; i < count; ++i) {
+				in_place = in_place && swapped[offset + 2 * i] == bytes[offset + 2 * i + 1] && swapped[offset + 2 * i + 1] == bytes[offset + 2 * i];
+			}
+			check(in_place, "byteswap16 in place", count, offset);
+		}
+	}
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <asio/steady_timer.hpp>
+
+#include "client.hpp"
+#include "server.hpp"
+#include "error.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+}
+
+/// Check that read deduplication never answers a read with a reply that was sent before an earlier write.
+int main() {
+	asio::io_context io_context;
+
+	// The server samples the register when a read arrives, but replies to reads only after a delay.
+	modbus::server server{io_context};
+	std::uint16_t value = 0;
+	server.on_read_holding_registers = [&] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+		modbus::response::read_holding_registers response;
+		response.values.assign(request.count, value);
+
+		auto timer = std::make_shared<asio::steady_timer>(io_context, std::chrono::milliseconds(100));
+		timer->async_wait([timer, reply, response] (std::error_code const &) {
+			reply(response);
+		});
+	};
+	server.on_write_single_register = [&] (modbus::tcp_mbap const &, modbus::request::write_single_register const & request, modbus::server::reply<modbus::response::write_single_register> const & reply) {
+		value = request.value;
+		reply({request.address, request.value});
+	};
+
+	std::error_code error = server.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	if (error) {
+		std::cout << "Failed to listen: " << error.message() << "\n";
+		return 1;
+	}
+
+	modbus::client client{io_context};
+	client.deduplicate_reads  = true;
+	client.collect_statistics = true;
+
+	std::vector<std::uint16_t> values;
+	std::vector<std::error_code> errors;
+	auto record = [&] (modbus::tcp_mbap const &, modbus::response::read_holding_registers const & response, std::error_code const & error) {
+		errors.push_back(error);
+		values.push_back(response.values.empty() ? 0xffff : response.values[0]);
+		if (values.size() == 4) {
+			client.close();
+			server.close();
+		}
+	};
+
+	client.connect("127.0.0.1", std::to_string(server.local_endpoint().port()), [&] (std::error_code const & error) {
+		if (error) {
+			std::cout << "Failed to connect: " << error.message() << "\n";
+			server.close();
+			return;
+		}
+
+		// The second read must not share the reply of the first, since a write was sent in between.
+		client.read_holding_registers(1, 0, 1, record);
+		client.write_single_register(1, 0, 42, [] (modbus::tcp_mbap const &, modbus::response::write_single_register const &, std::error_code const &) {});
+		client.read_holding_registers(1, 0, 1, record);
+
+		// A write to another unit does not affect deduplication for unit 1.
+		client.read_holding_registers(1, 8, 1, record);
+		client.write_single_register(2, 0, 42, [] (modbus::tcp_mbap const &, modbus::response::write_single_register const &, std::error_code const &) {});
+		client.read_holding_registers(1, 8, 1, record);
+	});
+
+	io_context.run_for(std::chrono::seconds(5));
+
+	check(errors.size() == 4, "all reads complete");
+	for (std::error_code const & error : errors) check(!error, "reads succeed");
+	if (values.size() == 4) {
+		check(values[0] == 0,  "read before the write returns the old value");
+		check(values[1] == 42, "read after the write returns the written value");
+	}
+	check(client.statistics_snapshot().deduplicated_reads == 1, "only the read without a write to its unit in between is deduplicated");
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
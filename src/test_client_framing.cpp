@@ -0,0 +1,137 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include "client.hpp"
+#include "error.hpp"
+#include "impl/deserialize_base.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// Send a register read to a server that replies with a malformed MBAP header.
+	/**
+	 * Checks that the client reports the expected framing error, and fails the read instead of decoding the reply.
+	 */
+	void check_bad_header(std::uint16_t protocol, std::uint16_t length, std::error_code const & expected, char const * what) {
+		asio::io_context server_context;
+		asio::ip::tcp::acceptor acceptor(server_context, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+		// Reply to the request with the bad header, followed by a plausible PDU.
+		std::thread server([&acceptor, protocol, length] () {
+			asio::ip::tcp::socket socket(acceptor.get_executor());
+			acceptor.accept(socket);
+
+			std::uint8_t request[12];
+			asio::read(socket, asio::buffer(request));
+
+			std::uint8_t reply[] = {request[0], request[1], std::uint8_t(protocol >> 8), std::uint8_t(protocol), std::uint8_t(length >> 8), std::uint8_t(length), request[6], 0x03, 0x02, 0x12, 0x34};
+			asio::write(socket, asio::buffer(reply));
+
+			// Wait for the client to close the connection.
+			std::error_code error;
+			std::uint8_t byte;
+			asio::read(socket, asio::buffer(&byte, 1), error);
+		});
+
+		asio::io_context io_context;
+		modbus::client client(io_context);
+
+		std::error_code io_error;
+		std::error_code read_error;
+		bool read_done = false;
+		client.on_io_error = [&io_error] (std::error_code const & error) { if (!io_error) io_error = error; };
+
+		client.connect("127.0.0.1", std::to_string(acceptor.local_endpoint().port()), [&] (std::error_code const & error) {
+			if (error) {
+				io_error = error;
+				return;
+			}
+			client.read_holding_registers(1, 0, 1, [&] (modbus::tcp_mbap const &, modbus::response::read_holding_registers const &, std::error_code const & error) {
+				read_error = error;
+				read_done  = true;
+			});
+		});
+
+		io_context.run_for(std::chrono::seconds(5));
+		client.close();
+		io_context.run_for(std::chrono::milliseconds(100));
+		server.join();
+
+		check(io_error == expected, what);
+		check(read_done && read_error, what);
+	}
+
+	/// Check that a register response with an odd byte count is rejected instead of truncated.
+	void check_odd_byte_count() {
+		std::uint8_t const odd[]  = {3, 0x12, 0x34, 0x56};
+		std::uint8_t const even[] = {2, 0x12, 0x34};
+
+		std::error_code error;
+		modbus::word_view view;
+		modbus::impl::deserialize_words_response(odd, sizeof(odd), view, error);
+		check(error == modbus::modbus_error(modbus::errc::invalid_value), "odd byte count for a word view");
+
+		error.clear();
+		std::vector<std::uint16_t> values;
+		modbus::impl::deserialize_words_response(odd, sizeof(odd), values, error);
+		check(error == modbus::modbus_error(modbus::errc::invalid_value), "odd byte count for a word vector");
+
+		error.clear();
+		modbus::impl::deserialize_words_response(even, sizeof(even), view, error);
+		check(!error && view.size() == 1 && view[0] == 0x1234, "even byte count for a word view");
+	}
+}
+
+/// Check that the client rejects malformed replies.
+int main() {
+	check_bad_header(0, 0,   modbus::modbus_error(modbus::errc::message_size_mismatch), "MBAP length 0");
+	check_bad_header(0, 1,   modbus::modbus_error(modbus::errc::message_size_mismatch), "MBAP length 1");
+	check_bad_header(0, 255, modbus::modbus_error(modbus::errc::message_size_mismatch), "MBAP length 255");
+	check_bad_header(1, 5,   modbus::modbus_error(modbus::errc::invalid_value),         "MBAP protocol 1");
+	check_odd_byte_count();
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
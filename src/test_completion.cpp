@@ -0,0 +1,148 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <asio/executor_work_guard.hpp>
+#include <asio/use_future.hpp>
+
+#if defined(ASIO_HAS_CO_AWAIT)
+#include <asio/co_spawn.hpp>
+#include <asio/use_awaitable.hpp>
+#endif
+
+#include "client.hpp"
+#include "error.hpp"
+#include "server.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// The register address for which the server replies with an exception.
+	std::uint16_t const bad_address = 999;
+
+	/// Check that a response holds the values the test server returns for a read.
+	bool expected_values(modbus::response::read_holding_registers const & response, std::uint16_t address, std::uint16_t count) {
+		if (response.values.size() != count) return false;
+		for (std::uint16_t i = 0; i < count; ++i) if (response.values[i] != address + i) return false;
+		return true;
+	}
+}
+
+/// Complete requests with asio::use_future.
+void test_use_future(modbus::client & client) {
+	std::future<modbus::response::read_holding_registers> read = client.read_holding_registers(1, 10, 3, asio::use_future);
+	check(expected_values(read.get(), 10, 3), "use_future: response values");
+
+	std::future<modbus::response::write_single_register> write = client.write_single_register(1, 20, 1234, asio::use_future);
+	modbus::response::write_single_register written = write.get();
+	check(written.address == 20 && written.value == 1234, "use_future: write response");
+
+	std::future<modbus::response::read_holding_registers> failed = client.read_holding_registers(1, bad_address, 1, asio::use_future);
+	try {
+		failed.get();
+		check(false, "use_future: exception response throws");
+	} catch (std::system_error const & error) {
+		check(error.code() == modbus::modbus_error(modbus::errc::illegal_data_address), "use_future: exception response error code");
+	}
+}
+
+#if defined(ASIO_HAS_CO_AWAIT)
+/// Complete requests with asio::use_awaitable from a coroutine.
+void test_use_awaitable(asio::io_context & io_context, modbus::client & client) {
+	auto coroutine = [&client] () -> asio::awaitable<void> {
+		modbus::response::read_holding_registers response = co_await client.read_holding_registers(1, 30, 4, asio::use_awaitable);
+		check(expected_values(response, 30, 4), "use_awaitable: response values");
+
+		try {
+			co_await client.read_holding_registers(1, bad_address, 1, asio::use_awaitable);
+			check(false, "use_awaitable: exception response throws");
+		} catch (std::system_error const & error) {
+			check(error.code() == modbus::modbus_error(modbus::errc::illegal_data_address), "use_awaitable: exception response error code");
+		}
+	};
+
+	asio::co_spawn(io_context, coroutine, asio::use_future).get();
+}
+#endif
+
+/// Check the request functions that take an asio completion token against a loopback server.
+int main() {
+	asio::io_context io_context;
+	auto work = asio::make_work_guard(io_context);
+
+	modbus::server server{io_context};
+	server.on_read_holding_registers = [] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+		if (request.address == bad_address) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		modbus::response::read_holding_registers response;
+		for (std::uint16_t i = 0; i < request.count; ++i) response.values.push_back(request.address + i);
+		reply(response);
+	};
+	server.on_write_single_register = [] (modbus::tcp_mbap const &, modbus::request::write_single_register const & request, modbus::server::reply<modbus::response::write_single_register> const & reply) {
+		reply({request.address, request.value});
+	};
+	server.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+	modbus::client client{io_context};
+	std::thread thread([&io_context] () { io_context.run(); });
+
+	std::promise<std::error_code> connected;
+	client.connect("127.0.0.1", std::to_string(server.local_endpoint().port()), [&connected] (std::error_code const & error) {
+		connected.set_value(error);
+	});
+	std::error_code error = connected.get_future().get();
+	check(!error, "connect to the test server");
+
+	if (!error) {
+		test_use_future(client);
+#if defined(ASIO_HAS_CO_AWAIT)
+		test_use_awaitable(io_context, client);
+#endif
+	}
+
+	client.close();
+	server.close();
+	work.reset();
+	thread.join();
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include "gateway.hpp"
+#include "error.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// Send pipelined read_holding_registers requests for unit 1, with transaction IDs first up to first + count.
+	void send_reads(asio::ip::tcp::socket & socket, std::uint16_t first, std::uint16_t count) {
+		std::vector<std::uint8_t> frames;
+		for (std::uint16_t transaction = first; transaction < first + count; ++transaction) {
+			std::uint8_t frame[12] = {std::uint8_t(transaction >> 8), std::uint8_t(transaction), 0, 0, 0, 6, 1, 0x03, 0, 0, 0, 1};
+			frames.insert(frames.end(), frame, frame + sizeof(frame));
+		}
+		asio::write(socket, asio::buffer(frames));
+	}
+
+	/// Read a reply and return the exception code by transaction ID, or zero for a regular response.
+	std::pair<std::uint16_t, std::uint8_t> read_reply(asio::ip::tcp::socket & socket) {
+		std::uint8_t header[7];
+		asio::read(socket, asio::buffer(header));
+		std::vector<std::uint8_t> pdu((header[4] << 8 | header[5]) - 1);
+		asio::read(socket, asio::buffer(pdu));
+		std::uint8_t exception = pdu.size() == 2 && pdu[0] & 0x80 ? pdu[1] : 0;
+		return {std::uint16_t(header[0] << 8 | header[1]), exception};
+	}
+
+	/// Read and discard everything written to the bus so far, and return the number of bytes.
+	std::size_t drain(int fd) {
+		std::size_t total = 0;
+		std::uint8_t buffer[256];
+		ssize_t count;
+		while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) total += count;
+		return total;
+	}
+}
+
+/// Check the per-connection queues of the gateway on a bus where no device answers.
+int main() {
+	int master;
+	int slave;
+	char name[256];
+	if (openpty(&master, &slave, name, nullptr, nullptr) != 0) {
+		std::cout << "Failed to open a pseudo-terminal pair.\n";
+		return 1;
+	}
+
+	termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+	asio::io_context io_context;
+	modbus::gateway gateway{io_context};
+	gateway.max_queued = 2;
+
+	modbus::rtu_client & bus = gateway.add_bus({1});
+	bus.default_timeout = std::chrono::milliseconds(200);
+
+	modbus::rtu_client::serial_settings serial;
+	serial.baud_rate = 115200;
+	std::error_code error = bus.open(name, serial);
+	if (!error) error = gateway.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	if (error) {
+		std::cout << "Failed to start the gateway: " << error.message() << "\n";
+		return 1;
+	}
+	std::thread thread([&io_context] () { io_context.run(); });
+
+	asio::io_context client_context;
+
+	// Two requests go to the RTU client, two wait in the queue and the last two overflow it.
+	{
+		asio::ip::tcp::socket socket(client_context);
+		socket.connect(gateway.server.local_endpoint());
+		send_reads(socket, 0, 6);
+
+		std::map<std::uint16_t, std::uint8_t> replies;
+		for (int i = 0; i < 6; ++i) replies.insert(read_reply(socket));
+		for (std::uint16_t transaction = 0; transaction < 4; ++transaction) {
+			check(replies[transaction] == modbus::errc::gateway_target_device_failed_to_respond, "requests within the queue limit time out on the bus");
+		}
+		check(replies[4] == modbus::errc::server_device_busy, "fifth request overflows the queue");
+		check(replies[5] == modbus::errc::server_device_busy, "sixth request overflows the queue");
+		check(drain(master) == 4 * 8, "only requests within the queue limit are sent on the bus");
+	}
+
+	// The queued requests of a closed connection are dropped instead of sent on the bus.
+	{
+		asio::ip::tcp::socket socket(client_context);
+		socket.connect(gateway.server.local_endpoint());
+		send_reads(socket, 0, 4);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		socket.close();
+	}
+	{
+		asio::ip::tcp::socket socket(client_context);
+		socket.connect(gateway.server.local_endpoint());
+		send_reads(socket, 0, 1);
+		std::pair<std::uint16_t, std::uint8_t> reply = read_reply(socket);
+		check(reply.second == modbus::errc::gateway_target_device_failed_to_respond, "request after a disconnect times out on the bus");
+		check(drain(master) == 3 * 8, "queued requests of a closed connection are not sent on the bus");
+	}
+
+	gateway.close();
+	io_context.stop();
+	thread.join();
+	::close(slave);
+	::close(master);
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -0,0 +1,194 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <asio/steady_timer.hpp>
+
+#include "client.hpp"
+#include "poller.hpp"
+#include "server.hpp"
+
+namespace {
+	using clock = std::chrono::steady_clock;
+	using std::chrono::milliseconds;
+
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// A read received by the test server.
+	struct received_read {
+		std::uint16_t address;
+		clock::time_point time;
+	};
+
+	/// Loopback server, client and poller on a single IO context.
+	/**
+	 * The server records every register read, and delays the reply to addresses in reply_delay.
+	 */
+	struct fixture {
+		asio::io_context io_context;
+		modbus::server server{io_context};
+		modbus::client client{io_context};
+		modbus::poller poller{io_context, client};
+
+		std::vector<received_read> reads;
+		std::map<std::uint16_t, milliseconds> reply_delay;
+
+		fixture() {
+			server.on_read_holding_registers = [this] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+				reads.push_back({request.address, clock::now()});
+				modbus::response::read_holding_registers response{std::vector<std::uint16_t>(request.count)};
+
+				auto delay = reply_delay.find(request.address);
+				if (delay == reply_delay.end()) return reply(response);
+
+				auto timer = std::make_shared<asio::steady_timer>(io_context, delay->second);
+				timer->async_wait([timer, reply, response] (std::error_code const &) { reply(response); });
+			};
+			server.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+		}
+
+		/// Connect the client, start the poller and run for a while.
+		void run(milliseconds duration) {
+			client.connect("127.0.0.1", std::to_string(server.local_endpoint().port()), [this] (std::error_code const & error) {
+				if (error) std::cout << "Failed to connect: " << error.message() << "\n";
+				else poller.start();
+			});
+			io_context.run_for(duration);
+			poller.stop();
+			client.close();
+			server.close();
+			io_context.run_for(milliseconds(50));
+		}
+
+		/// Count the reads of an address, optionally only those received after a point in time.
+		std::size_t count(std::uint16_t address, clock::time_point after = clock::time_point()) const {
+			std::size_t result = 0;
+			for (received_read const & read : reads) if (read.address == address && read.time > after) ++result;
+			return result;
+		}
+	};
+}
+
+/// Groups that become due at different times are started in deadline order, regardless of the order they were added in.
+void test_deadline_order() {
+	fixture test;
+	std::size_t late   = test.poller.add_group(milliseconds(1000), modbus::poller::overrun_policy::skip, milliseconds(60));
+	std::size_t early  = test.poller.add_group(milliseconds(1000), modbus::poller::overrun_policy::skip, milliseconds(20));
+	std::size_t middle = test.poller.add_group(milliseconds(1000), modbus::poller::overrun_policy::skip, milliseconds(40));
+	test.poller.read_holding_registers(late,   1, 300, 1, nullptr);
+	test.poller.read_holding_registers(early,  1, 100, 1, nullptr);
+	test.poller.read_holding_registers(middle, 1, 200, 1, nullptr);
+	test.run(milliseconds(300));
+
+	check(test.reads.size() == 3, "deadline order: every group ran once");
+	check(test.reads.size() == 3 && test.reads[0].address == 100 && test.reads[1].address == 200 && test.reads[2].address == 300, "deadline order: groups started by deadline");
+}
+
+/// With the skip policy, cycles that are due while the group is busy are skipped and the schedule stays on the grid.
+void test_skip_policy() {
+	fixture test;
+	test.reply_delay[100] = milliseconds(50);
+	std::size_t group = test.poller.add_group(milliseconds(20), modbus::poller::overrun_policy::skip);
+	test.poller.read_holding_registers(group, 1, 100, 1, nullptr);
+	test.run(milliseconds(400));
+
+	modbus::poller::statistics stats = test.poller.group_statistics(group);
+	check(stats.cycles >= 3, "skip policy: cycles completed");
+	check(stats.skipped > 0, "skip policy: cycles skipped");
+	check(stats.delayed == 0, "skip policy: no cycles delayed");
+	check(stats.max_lateness < milliseconds(15), "skip policy: cycles start on the grid");
+}
+
+/// With the delay policy, a cycle that is due while the group is busy starts as soon as the busy cycle finishes.
+void test_delay_policy() {
+	fixture test;
+	test.reply_delay[100] = milliseconds(50);
+	std::size_t group = test.poller.add_group(milliseconds(20), modbus::poller::overrun_policy::delay);
+	test.poller.read_holding_registers(group, 1, 100, 1, nullptr);
+	test.run(milliseconds(400));
+
+	modbus::poller::statistics stats = test.poller.group_statistics(group);
+	check(stats.cycles >= 3, "delay policy: cycles completed");
+	check(stats.skipped == 0, "delay policy: no cycles skipped");
+	check(stats.delayed > 0, "delay policy: cycles delayed");
+	check(stats.max_lateness >= milliseconds(20), "delay policy: cycles start late");
+
+	// Every delayed cycle starts right after the previous reply, so the reads follow each other by the reply delay.
+	bool back_to_back = test.reads.size() >= 3;
+	for (std::size_t i = 1; i + 1 < test.reads.size(); ++i) {
+		if (test.reads[i + 1].time - test.reads[i].time > milliseconds(70)) back_to_back = false;
+	}
+	check(back_to_back, "delay policy: delayed cycles start when the busy cycle finishes");
+}
+
+/// A removed group starts no new cycles, while the other groups keep running.
+void test_remove_group() {
+	fixture test;
+	std::size_t removed = test.poller.add_group(milliseconds(20));
+	std::size_t kept    = test.poller.add_group(milliseconds(20));
+	test.poller.read_holding_registers(removed, 1, 100, 1, nullptr);
+	test.poller.read_holding_registers(kept,    1, 200, 1, nullptr);
+
+	// Remove the group while the poller is running, and allow a read that was already sent to arrive.
+	clock::time_point removed_at;
+	asio::steady_timer timer(test.io_context, milliseconds(150));
+	timer.async_wait([&] (std::error_code const &) {
+		test.poller.remove_group(removed);
+		removed_at = clock::now() + milliseconds(10);
+	});
+	test.run(milliseconds(400));
+
+	check(test.count(100) > 0, "remove group: group ran before it was removed");
+	check(removed_at != clock::time_point() && test.count(100, removed_at) == 0, "remove group: no cycles after removal");
+	check(test.count(200, removed_at) > 0, "remove group: other group kept running");
+}
+
+/// Check the scheduling of the poller against a loopback server.
+int main() {
+	test_deadline_order();
+	test_skip_policy();
+	test_delay_policy();
+	test_remove_group();
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
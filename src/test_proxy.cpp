@@ -0,0 +1,140 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <asio/read.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/write.hpp>
+
+#include "proxy.hpp"
+#include "error.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// Read holding registers of unit 1 through the proxy and return the values.
+	std::vector<std::uint16_t> read_registers(asio::ip::tcp::socket & socket, std::uint16_t address, std::uint16_t count) {
+		std::uint8_t request[12] = {0, 1, 0, 0, 0, 6, 1, 0x03, std::uint8_t(address >> 8), std::uint8_t(address), std::uint8_t(count >> 8), std::uint8_t(count)};
+		asio::write(socket, asio::buffer(request));
+
+		std::uint8_t header[7];
+		asio::read(socket, asio::buffer(header));
+		std::vector<std::uint8_t> pdu((header[4] << 8 | header[5]) - 1);
+		asio::read(socket, asio::buffer(pdu));
+
+		std::vector<std::uint16_t> values;
+		for (std::size_t i = 2; i + 1 < pdu.size(); i += 2) values.push_back(pdu[i] << 8 | pdu[i + 1]);
+		return values;
+	}
+}
+
+/// Check that the proxy caches reads across block boundaries and ages values from the time the read was sent.
+int main() {
+	asio::io_context io_context;
+
+	// The device answers with the register address as value, after a configurable delay.
+	modbus::server device{io_context};
+	std::chrono::milliseconds reply_delay{0};
+	device.on_read_holding_registers = [&] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+		modbus::response::read_holding_registers response;
+		for (std::uint16_t i = 0; i < request.count; ++i) response.values.push_back(request.address + i);
+
+		auto timer = std::make_shared<asio::steady_timer>(io_context, reply_delay);
+		timer->async_wait([timer, reply, response] (std::error_code const &) {
+			reply(response);
+		});
+	};
+
+	modbus::proxy proxy{io_context};
+	proxy.max_age = std::chrono::milliseconds(200);
+
+	std::error_code error = device.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	if (!error) error = proxy.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	if (error) {
+		std::cout << "Failed to listen: " << error.message() << "\n";
+		return 1;
+	}
+
+	std::error_code connect_error = asio::error::not_connected;
+	proxy.connect("127.0.0.1", std::to_string(device.local_endpoint().port()), [&] (std::error_code const & error) {
+		connect_error = error;
+		io_context.stop();
+	});
+	io_context.run_for(std::chrono::seconds(1));
+	if (connect_error) {
+		std::cout << "Failed to connect to the device: " << connect_error.message() << "\n";
+		return 1;
+	}
+
+	io_context.restart();
+	auto work = asio::make_work_guard(io_context);
+	std::thread thread([&io_context] () { io_context.run(); });
+
+	asio::io_context client_context;
+	asio::ip::tcp::socket socket(client_context);
+	socket.connect(proxy.server.local_endpoint());
+
+	// A read that spans two cache blocks is served from the cache, also in part.
+	check(read_registers(socket, 250, 10) == std::vector<std::uint16_t>({250, 251, 252, 253, 254, 255, 256, 257, 258, 259}), "first read returns the device values");
+	check(proxy.cache_misses() == 1, "first read is forwarded");
+	check(read_registers(socket, 250, 10).size() == 10, "repeated read returns all values");
+	check(read_registers(socket, 254, 4) == std::vector<std::uint16_t>({254, 255, 256, 257}), "read inside the cached range returns the cached values");
+	check(proxy.cache_hits() == 2, "reads of cached ranges are answered from the cache");
+	check(read_registers(socket, 255, 10).size() == 10, "read beyond the cached range returns all values");
+	check(proxy.cache_misses() == 2, "read beyond the cached range is forwarded");
+
+	// A reply that took longer than max_age is already too old to be served once it arrives.
+	reply_delay = std::chrono::milliseconds(300);
+	read_registers(socket, 1000, 1);
+	read_registers(socket, 1000, 1);
+	check(proxy.cache_misses() == 4, "values are aged from the time the read was sent");
+
+	socket.close();
+	proxy.close();
+	device.close();
+	work.reset();
+	io_context.stop();
+	thread.join();
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -0,0 +1,181 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "rtu_client.hpp"
+#include "error.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// Compute the CRC-16/Modbus bit by bit, independent of the table driven implementation.
+	std::uint16_t reference_crc(std::uint8_t const * data, std::size_t size) {
+		std::uint16_t crc = 0xffff;
+		for (std::size_t i = 0; i < size; ++i) {
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; ++bit) crc = crc & 1 ? (crc >> 1) ^ 0xa001 : crc >> 1;
+		}
+		return crc;
+	}
+
+	/// Read exactly size bytes from a file descriptor.
+	bool read_exact(int fd, std::uint8_t * data, std::size_t size) {
+		while (size > 0) {
+			ssize_t count = ::read(fd, data, size);
+			if (count <= 0) return false;
+			data += count;
+			size -= count;
+		}
+		return true;
+	}
+
+	/// Simulated RTU device on the master side of the pty.
+	/**
+	 * Answers read_holding_registers requests for unit 1 with the register address as value.
+	 * The reply to the request with index corrupt_reply gets a wrong CRC.
+	 */
+	struct device {
+		int fd;
+		std::size_t requests;
+		std::size_t corrupt_reply;
+
+		/// True for every request that had a valid CRC and the expected contents.
+		std::vector<bool> valid_requests;
+
+		void operator() () {
+			for (std::size_t index = 0; index < requests; ++index) {
+				std::uint8_t request[8];
+				if (!read_exact(fd, request, sizeof(request))) return;
+
+				std::uint16_t crc = reference_crc(request, 6);
+				bool valid = request[6] == (crc & 0xff) && request[7] == crc >> 8;
+				valid = valid && request[0] == 1 && request[1] == 0x03;
+				valid_requests.push_back(valid);
+
+				std::uint16_t address = request[2] << 8 | request[3];
+				std::uint16_t count   = request[4] << 8 | request[5];
+				std::vector<std::uint8_t> reply{1, 0x03, std::uint8_t(count * 2)};
+				for (std::uint16_t i = 0; i < count; ++i) {
+					reply.push_back(std::uint16_t(address + i) >> 8);
+					reply.push_back(std::uint16_t(address + i) & 0xff);
+				}
+				crc = reference_crc(reply.data(), reply.size());
+				if (index == corrupt_reply) crc ^= 0x0100;
+				reply.push_back(crc & 0xff);
+				reply.push_back(crc >> 8);
+
+				if (::write(fd, reply.data(), reply.size()) != ssize_t(reply.size())) return;
+			}
+		}
+	};
+}
+
+/// Run request and reply round trips with the RTU client over a pseudo-terminal pair.
+int main() {
+	int master;
+	int slave;
+	char name[256];
+	if (openpty(&master, &slave, name, nullptr, nullptr) != 0) {
+		std::cout << "Failed to open a pseudo-terminal pair.\n";
+		return 1;
+	}
+
+	termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+
+	asio::io_context io_context;
+	modbus::rtu_client client{io_context};
+	client.default_timeout = std::chrono::milliseconds(2000);
+
+	modbus::rtu_client::serial_settings serial;
+	serial.baud_rate = 115200;
+	std::error_code error = client.open(name, serial);
+	if (error) {
+		std::cout << "Failed to open " << name << ": " << error.message() << "\n";
+		return 1;
+	}
+
+	device simulated{master, 3, 1, {}};
+	std::thread thread(std::ref(simulated));
+
+	// The second reply has a corrupted CRC, and the bus must recover for the third request.
+	std::vector<std::error_code> errors;
+	std::vector<std::vector<std::uint16_t>> values;
+	auto record = [&] (modbus::tcp_mbap const &, modbus::response::read_holding_registers const & response, std::error_code const & error) {
+		errors.push_back(error);
+		values.push_back(response.values);
+	};
+
+	client.read_holding_registers(1, 0x1234, 2, [&] (modbus::tcp_mbap const & header, modbus::response::read_holding_registers const & response, std::error_code const & error) {
+		record(header, response, error);
+		client.read_holding_registers(1, 0x2000, 1, [&] (modbus::tcp_mbap const & header, modbus::response::read_holding_registers const & response, std::error_code const & error) {
+			record(header, response, error);
+			client.read_holding_registers(1, 0x3000, 3, [&] (modbus::tcp_mbap const & header, modbus::response::read_holding_registers const & response, std::error_code const & error) {
+				record(header, response, error);
+				client.close();
+			});
+		});
+	});
+
+	io_context.run_for(std::chrono::seconds(10));
+	// Closing all slave descriptors ends a read of the device that is still waiting for a request.
+	client.close();
+	io_context.run_for(std::chrono::milliseconds(100));
+	::close(slave);
+	thread.join();
+	::close(master);
+
+	check(simulated.valid_requests == std::vector<bool>(3, true), "requests have a valid CRC and contents");
+	check(errors.size() == 3, "all requests completed");
+	if (errors.size() == 3) {
+		check(!errors[0] && values[0] == std::vector<std::uint16_t>{0x1234, 0x1235}, "round trip");
+		check(errors[1] == modbus::modbus_error(modbus::errc::crc_mismatch), "corrupted CRC is rejected");
+		check(!errors[2] && values[2] == std::vector<std::uint16_t>{0x3000, 0x3001, 0x3002}, "round trip after a corrupted CRC");
+	}
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "server.hpp"
+#include "error.hpp"
+
+namespace {
+	std::vector<std::uint16_t> registers(0x10000);
+	modbus::bit_vector coils(0x10000);
+
+	/// Check if a range of addresses fits in the register or coil tables.
+	bool in_range(std::uint16_t address, std::size_t count) {
+		return count > 0 && address + count <= 0x10000;
+	}
+}
+
+int main(int argc, char * * argv) {
+	std::uint16_t port = argc >= 2 ? std::atoi(argv[1]) : 502;
+
+	asio::io_context io_context;
+	modbus::server server{io_context};
+
+	server.on_io_error = [] (std::error_code const & error) {
+		std::cout << "IO error: " << error.message() << "\n";
+	};
+
+	server.on_read_coils = [] (modbus::tcp_mbap const &, modbus::request::read_coils const & request, modbus::server::reply<modbus::response::read_coils> const & reply) {
+		if (!in_range(request.address, request.count)) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		reply({modbus::bit_vector(std::vector<bool>(coils.begin() + request.address, coils.begin() + request.address + request.count))});
+	};
+
+	server.on_read_holding_registers = [] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+		if (!in_range(request.address, request.count)) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		reply({{registers.begin() + request.address, registers.begin() + request.address + request.count}});
+	};
+
+	server.on_read_input_registers = [] (modbus::tcp_mbap const &, modbus::request::read_input_registers const & request, modbus::server::reply<modbus::response::read_input_registers> const & reply) {
+		if (!in_range(request.address, request.count)) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		reply({{registers.begin() + request.address, registers.begin() + request.address + request.count}});
+	};
+
+	server.on_write_single_coil = [] (modbus::tcp_mbap const &, modbus::request::write_single_coil const & request, modbus::server::reply<modbus::response::write_single_coil> const & reply) {
+		coils[request.address] = request.value;
+		reply({request.address, request.value});
+	};
+
+	server.on_write_single_register = [] (modbus::tcp_mbap const &, modbus::request::write_single_register const & request, modbus::server::reply<modbus::response::write_single_register> const & reply) {
+		registers[request.address] = request.value;
+		reply({request.address, request.value});
+	};
+
+	server.on_write_multiple_coils = [] (modbus::tcp_mbap const &, modbus::request::write_multiple_coils const & request, modbus::server::reply<modbus::response::write_multiple_coils> const & reply) {
+		if (!in_range(request.address, request.values.size())) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		for (std::size_t i = 0; i < request.values.size(); ++i) coils[request.address + i] = request.values[i];
+		reply({request.address, std::uint16_t(request.values.size())});
+	};
+
+	server.on_write_multiple_registers = [] (modbus::tcp_mbap const &, modbus::request::write_multiple_registers const & request, modbus::server::reply<modbus::response::write_multiple_registers> const & reply) {
+		if (!in_range(request.address, request.values.size())) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		std::copy(request.values.begin(), request.values.end(), registers.begin() + request.address);
+		reply({request.address, std::uint16_t(request.values.size())});
+	};
+
+	server.on_mask_write_register = [] (modbus::tcp_mbap const &, modbus::request::mask_write_register const & request, modbus::server::reply<modbus::response::mask_write_register> const & reply) {
+		std::uint16_t & value = registers[request.address];
+		value = (value & request.and_mask) | (request.or_mask & ~request.and_mask);
+		reply({request.address, request.and_mask, request.or_mask});
+	};
+
+	server.on_read_write_multiple_registers = [] (modbus::tcp_mbap const &, modbus::request::read_write_multiple_registers const & request, modbus::server::reply<modbus::response::read_write_multiple_registers> const & reply) {
+		if (!in_range(request.write_address, request.values.size())) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		if (!in_range(request.read_address, request.read_count)) return reply(modbus::modbus_error(modbus::errc::illegal_data_address));
+		std::copy(request.values.begin(), request.values.end(), registers.begin() + request.write_address);
+		reply({{registers.begin() + request.read_address, registers.begin() + request.read_address + request.read_count}});
+	};
+
+	std::error_code error = server.listen(port);
+	if (error) {
+		std::cout << "Failed to listen on port " << port << ": " << error.message() << "\n";
+		return 1;
+	}
+
+	std::cout << "Listening on port " << server.local_endpoint().port() << ".\n";
+	io_context.run();
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2017, Fizyr (https://fizyr.com)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holder(s) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <asio/connect.hpp>
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+#include "server.hpp"
+#include "error.hpp"
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, char const * what) {
+		if (condition) return;
+		std::cout << "FAIL: " << what << "\n";
+		++failures;
+	}
+
+	/// Number of requests that reached a handler.
+	int handled = 0;
+
+	/// Send a raw request PDU to the server and read the reply PDU.
+	std::vector<std::uint8_t> transact(asio::ip::tcp::socket & socket, std::vector<std::uint8_t> const & pdu) {
+		std::uint16_t length = pdu.size() + 1;
+		std::vector<std::uint8_t> frame{0x12, 0x34, 0, 0, std::uint8_t(length >> 8), std::uint8_t(length), 1};
+		frame.insert(frame.end(), pdu.begin(), pdu.end());
+		asio::write(socket, asio::buffer(frame));
+
+		std::uint8_t header[7];
+		asio::read(socket, asio::buffer(header));
+		std::vector<std::uint8_t> reply((header[4] << 8 | header[5]) - 1);
+		asio::read(socket, asio::buffer(reply));
+		return reply;
+	}
+
+	/// Check that a request is rejected with illegal_data_value before it reaches a handler.
+	void check_rejected(asio::ip::tcp::socket & socket, std::vector<std::uint8_t> const & pdu, char const * what) {
+		int before = handled;
+		std::vector<std::uint8_t> reply = transact(socket, pdu);
+		check(reply.size() == 2 && reply[0] == (pdu[0] | 0x80) && reply[1] == modbus::errc::illegal_data_value, what);
+		check(handled == before, what);
+	}
+
+	/// Check that a request reaches a handler and gets a regular response.
+	void check_accepted(asio::ip::tcp::socket & socket, std::vector<std::uint8_t> const & pdu, char const * what) {
+		int before = handled;
+		std::vector<std::uint8_t> reply = transact(socket, pdu);
+		check(!reply.empty() && reply[0] == pdu[0], what);
+		check(handled == before + 1, what);
+	}
+
+	/// Make a request PDU with a function code, an address and a 16 bit quantity.
+	std::vector<std::uint8_t> read_request(std::uint8_t function, std::uint16_t count) {
+		return {function, 0, 0, std::uint8_t(count >> 8), std::uint8_t(count)};
+	}
+
+	/// Make a write_multiple_coils request PDU.
+	std::vector<std::uint8_t> write_coils_request(std::uint16_t count) {
+		std::vector<std::uint8_t> pdu{0x0f, 0, 0, std::uint8_t(count >> 8), std::uint8_t(count), std::uint8_t((count + 7) / 8)};
+		pdu.resize(pdu.size() + (count + 7) / 8);
+		return pdu;
+	}
+
+	/// Make a write_multiple_registers request PDU.
+	std::vector<std::uint8_t> write_registers_request(std::uint16_t count) {
+		std::vector<std::uint8_t> pdu{0x10, 0, 0, std::uint8_t(count >> 8), std::uint8_t(count), std::uint8_t(count * 2)};
+		pdu.resize(pdu.size() + count * 2);
+		return pdu;
+	}
+
+	/// Make a read_write_multiple_registers request PDU.
+	std::vector<std::uint8_t> read_write_request(std::uint16_t read_count, std::uint16_t write_count) {
+		std::vector<std::uint8_t> pdu{0x17, 0, 0, std::uint8_t(read_count >> 8), std::uint8_t(read_count), 0, 0, std::uint8_t(write_count >> 8), std::uint8_t(write_count), std::uint8_t(write_count * 2)};
+		pdu.resize(pdu.size() + write_count * 2);
+		return pdu;
+	}
+}
+
+/// Check that the server rejects quantities outside the limits of the Modbus specification.
+int main() {
+	asio::io_context io_context;
+	modbus::server server{io_context};
+
+	server.on_read_coils = [] (modbus::tcp_mbap const &, modbus::request::read_coils const & request, modbus::server::reply<modbus::response::read_coils> const & reply) {
+		++handled;
+		reply({modbus::bit_vector(request.count)});
+	};
+
+	server.on_read_discrete_inputs = [] (modbus::tcp_mbap const &, modbus::request::read_discrete_inputs const & request, modbus::server::reply<modbus::response::read_discrete_inputs> const & reply) {
+		++handled;
+		reply({modbus::bit_vector(request.count)});
+	};
+
+	server.on_read_holding_registers = [] (modbus::tcp_mbap const &, modbus::request::read_holding_registers const & request, modbus::server::reply<modbus::response::read_holding_registers> const & reply) {
+		++handled;
+		reply({std::vector<std::uint16_t>(request.count)});
+	};
+
+	server.on_read_input_registers = [] (modbus::tcp_mbap const &, modbus::request::read_input_registers const & request, modbus::server::reply<modbus::response::read_input_registers> const & reply) {
+		++handled;
+		reply({std::vector<std::uint16_t>(request.count)});
+	};
+
+	server.on_write_multiple_coils = [] (modbus::tcp_mbap const &, modbus::request::write_multiple_coils const & request, modbus::server::reply<modbus::response::write_multiple_coils> const & reply) {
+		++handled;
+		reply({request.address, std::uint16_t(request.values.size())});
+	};
+
+	server.on_write_multiple_registers = [] (modbus::tcp_mbap const &, modbus::request::write_multiple_registers const & request, modbus::server::reply<modbus::response::write_multiple_registers> const & reply) {
+		++handled;
+		reply({request.address, std::uint16_t(request.values.size())});
+	};
+
+	server.on_read_write_multiple_registers = [] (modbus::tcp_mbap const &, modbus::request::read_write_multiple_registers const & request, modbus::server::reply<modbus::response::read_write_multiple_registers> const & reply) {
+		++handled;
+		reply({std::vector<std::uint16_t>(request.read_count)});
+	};
+
+	std::error_code error = server.listen(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+	if (error) {
+		std::cout << "Failed to listen: " << error.message() << "\n";
+		return 1;
+	}
+	std::thread thread([&io_context] () { io_context.run(); });
+
+	asio::io_context client_context;
+	asio::ip::tcp::socket socket(client_context);
+	socket.connect(server.local_endpoint());
+
+	check_rejected(socket, read_request(0x01, 0),    "read_coils with 0 coils");
+	check_rejected(socket, read_request(0x01, 2001), "read_coils with 2001 coils");
+	check_accepted(socket, read_request(0x01, 2000), "read_coils with 2000 coils");
+	check_rejected(socket, read_request(0x02, 0),    "read_discrete_inputs with 0 inputs");
+	check_rejected(socket, read_request(0x02, 2001), "read_discrete_inputs with 2001 inputs");
+	check_accepted(socket, read_request(0x02, 1),    "read_discrete_inputs with 1 input");
+	check_rejected(socket, read_request(0x03, 0),    "read_holding_registers with 0 registers");
+	check_rejected(socket, read_request(0x03, 126),  "read_holding_registers with 126 registers");
+	check_accepted(socket, read_request(0x03, 125),  "read_holding_registers with 125 registers");
+	check_rejected(socket, read_request(0x04, 0),    "read_input_registers with 0 registers");
+	check_rejected(socket, read_request(0x04, 0xffff), "read_input_registers with 65535 registers");
+	check_accepted(socket, read_request(0x04, 1),    "read_input_registers with 1 register");
+
+	check_rejected(socket, write_coils_request(0),        "write_multiple_coils with 0 coils");
+	check_rejected(socket, write_coils_request(1969),     "write_multiple_coils with 1969 coils");
+	check_accepted(socket, write_coils_request(1968),     "write_multiple_coils with 1968 coils");
+	check_rejected(socket, write_registers_request(0),    "write_multiple_registers with 0 registers");
+	check_accepted(socket, write_registers_request(123),  "write_multiple_registers with 123 registers");
+	check_rejected(socket, read_write_request(0, 1),      "read_write_multiple_registers reading 0 registers");
+	check_rejected(socket, read_write_request(126, 1),    "read_write_multiple_registers reading 126 registers");
+	check_rejected(socket, read_write_request(1, 0),      "read_write_multiple_registers writing 0 registers");
+	check_accepted(socket, read_write_request(125, 121),  "read_write_multiple_registers reading 125 and writing 121 registers");
+
+	std::error_code ignored;
+	socket.close(ignored);
+	server.close();
+	io_context.stop();
+	thread.join();
+
+	if (failures) {
+		std::cout << failures << " checks failed.\n";
+		return 1;
+	}
+
+	std::cout << "All checks passed.\n";
+	return 0;
+}